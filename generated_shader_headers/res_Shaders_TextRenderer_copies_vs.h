@@ -0,0 +1,71 @@
+#pragma once
+static const char* res_Shaders_TextRenderer_copies_vs = R"(
+#version 450 core
+#define RT_COPIES
+
+layout(location = 0) in vec2 a_VertexPosition;
+
+uniform mat4 u_Matrix;
+uniform vec4 u_TextColor;
+uniform vec2 u_FontSize;
+uniform int u_CharFrom;
+uniform int u_GlyphCount;
+uniform int u_InstanceBase;
+uniform int u_InstanceCapacity;
+uniform vec2 u_InstanceOrigin;
+
+layout(std430, binding = 0) buffer textBuffer { uint text[]; };
+layout(std430, binding = 1) buffer glyphTransformBuffer { vec4 glyphTransforms[]; };
+
+#ifdef RT_COPIES
+struct TextCopy {
+	mat4 matrix;
+	vec4 color;
+};
+
+layout(std430, binding = 3) buffer copyBuffer { TextCopy copies[]; };
+#endif
+
+out vec2 v_UV;
+flat out vec4 v_TextColor;
+flat out uint v_TextureIndex;
+flat out uint v_StyleIndex;
+flat out uint v_RectKind;
+
+const uint RECT_FLAG = 0x80000000u;
+const uint RECT_KIND_NONE = 0xFFFFFFFFu;
+
+void main()
+{
+#ifdef RT_COPIES
+	// The instances run over every glyph of the batch once per copy.
+	const uint characterIndex = uint(gl_InstanceID) % uint(u_GlyphCount);
+	const uint copyIndex = uint(gl_InstanceID) / uint(u_GlyphCount);
+	const mat4 matrix = copies[copyIndex].matrix;
+	v_TextColor = copies[copyIndex].color;
+#else
+	const uint characterIndex = uint(gl_InstanceID);
+	const mat4 matrix = u_Matrix;
+	v_TextColor = u_TextColor;
+#endif
+
+	// The instance buffers are rings starting at u_InstanceBase.
+	const uint instanceIndex = (uint(u_InstanceBase) + characterIndex) % uint(u_InstanceCapacity);
+	const uint packedCharacter = text[instanceIndex];
+	const uint character = packedCharacter & 0x1FFFFFu;
+	const vec4 glyphTransform = glyphTransforms[instanceIndex];
+	const vec2 offset = glyphTransform.xy - u_InstanceOrigin;
+	const vec2 scale = glyphTransform.zw;
+
+	gl_Position = matrix * vec4(a_VertexPosition * scale + offset, 0.0, 1.0);
+	v_UV = vec2(a_VertexPosition.x, 1.0 - a_VertexPosition.y) * scale / u_FontSize;
+	v_StyleIndex = (packedCharacter >> 21) & 0x3FFu;
+	if ((packedCharacter & RECT_FLAG) != 0u) {
+		v_TextureIndex = 0u;
+		v_RectKind = character;
+	} else {
+		v_TextureIndex = character - u_CharFrom;
+		v_RectKind = RECT_KIND_NONE;
+	}
+}
+)";
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+static const char* res_Shaders_TextSurface_fs = R"(
+#version 430 core
+
+in vec2 v_UV;
+out vec4 o_Color;
+
+uniform sampler2DArray u_Textures;
+
+void main()
+{
+	o_Color = texture(u_Textures, vec3(v_UV, 0.0));
+}
+)";
\ No newline at end of file
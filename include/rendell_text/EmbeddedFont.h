@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace rendell_text {
+// A glyph baked at build time. Pixels are tightly packed width x height coverage values starting
+// at pixelOffset in EmbeddedFont::pixels.
+struct EmbeddedGlyph {
+    char32_t character{};
+    uint16_t width{};
+    uint16_t height{};
+    int16_t bearingX{};
+    int16_t bearingY{};
+    // In 26.6 units, as in RasterizedChar.
+    uint32_t advance{};
+    uint32_t pixelOffset{};
+};
+
+// A font face rasterized at one size by the font_atlas_baker tool, see rendell_text_embed_font in
+// CMakeLists.txt. The generated header defines one of these with static storage; glyphs are sorted
+// by character.
+struct EmbeddedFont {
+    const char *name{};
+    uint32_t fontWidth{};
+    uint32_t fontHeight{};
+    int height{};
+    int ascender{};
+    int descender{};
+    const EmbeddedGlyph *glyphs{};
+    size_t glyphCount{};
+    const uint8_t *pixels{};
+    size_t pixelCount{};
+};
+
+// Makes the font available to layouts, measurers and grids whose font path equals its name and
+// whose font size equals the baked one; they then never open a file or call FreeType. The font
+// must outlive its users. Register before the first layout update, a later registration only
+// affects storages created afterwards.
+void registerEmbeddedFont(const EmbeddedFont &font);
+void unregisterEmbeddedFont(const EmbeddedFont &font);
+const EmbeddedFont *findEmbeddedFont(const std::filesystem::path &fontPath, uint32_t fontWidth,
+                                     uint32_t fontHeight);
+} // namespace rendell_text
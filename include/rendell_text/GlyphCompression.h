@@ -0,0 +1,33 @@
+#pragma once
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace rendell_text {
+// How the BC4 encoding of a glyph range compares to its uncompressed bitmaps. Errors are in
+// coverage units of 0-255 over every pixel of the glyph cells.
+struct GlyphCompressionReport {
+    size_t glyphCount{};
+    size_t uncompressedBytes{};
+    size_t compressedBytes{};
+    double meanAbsoluteError{};
+    double rootMeanSquareError{};
+    uint32_t maxError{};
+};
+
+// Glyph pages of the font go to the GPU as BC4 (RGTC1) blocks, 4 bits per pixel instead of 8,
+// which halves the texture memory of large glyph sets such as CJK fonts. The blocks are encoded on
+// the CPU after rasterization and decoded by the shaders; the host keeps the uncompressed bitmaps.
+// Set it before the first layout update, like registerEmbeddedFont it only affects the font
+// storages created afterwards.
+void setGlyphBlockCompression(const std::filesystem::path &fontPath, bool enabled);
+bool isGlyphBlockCompressionEnabled(const std::filesystem::path &fontPath);
+
+// Rasterizes the characters [from, to) at the size and measures the error of their BC4 encoding,
+// to decide per font whether the loss is acceptable. It never touches the GPU.
+bool measureGlyphBlockCompression(const std::filesystem::path &fontPath,
+                                  const glm::ivec2 &fontSize, char32_t from, char32_t to,
+                                  GlyphCompressionReport &report);
+} // namespace rendell_text
@@ -0,0 +1,109 @@
+#pragma once
+#include "TextStyle.h"
+#include "private/GlyphBuffer.h"
+#include "private/RasteredFontStorage.h"
+#include "private/ShaderBufferPool.h"
+#include "private/TextBuffer.h"
+#include <rendell/oop/raii.h>
+
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <map>
+#include <rendell/rendell.h>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rendell_text {
+struct ImmediateTextStats {
+    // Of the last flush.
+    size_t stringCount{};
+    size_t instanceCount{};
+    size_t drawCount{};
+};
+
+// Draws strings that change every frame, like debug overlays and HUDs, without a TextLayout and
+// a TextRenderer per string. drawText only appends the glyph instances of the string on the CPU;
+// flush uploads the instances of all strings into one transient ring and issues one draw per
+// glyph page, so a frame of hundreds of strings costs a few draws. The glyph pages come from the
+// same caches the layouts use.
+// Within a page the strings are drawn in the order of the calls, the pages in the order they were
+// first used. Lines are fontSize.y apart, as in TextMeasurer; there is no wrapping and no
+// fallback fonts.
+class ImmediateTextRenderer final {
+public:
+    ImmediateTextRenderer();
+    ~ImmediateTextRenderer();
+
+    bool isInitialized() const;
+
+    void setMatrix(const glm::mat4 &matrix);
+    // The font of the strings drawn afterwards.
+    void setFont(const std::filesystem::path &fontPath, const glm::ivec2 &fontSize);
+
+    // The position is the baseline origin of the first line.
+    void drawText(const glm::vec2 &position, std::wstring_view text, const TextStyle &style);
+    // Draws everything appended since the last flush, once per frame. It also runs on its own
+    // when a frame uses more distinct styles than an instance can index.
+    void flush();
+
+    const ImmediateTextStats &getStats() const;
+
+private:
+    struct FontEntry {
+        std::filesystem::path fontPath{};
+        glm::ivec2 fontSize{};
+        RasteredFontStorageSharedPtr rasteredFontStorage{};
+        float ascender{};
+        float descender{};
+    };
+
+    // The instances of the frame that sample one glyph page.
+    struct PageInstances {
+        const RasteredFontStorage *rasteredFontStorage{};
+        uint32_t rangeIndex{};
+        GlyphBufferSharedPtr glyphBuffer{};
+        std::vector<uint32_t> packedCharacters{};
+        std::vector<glm::vec4> transforms{};
+    };
+
+    struct StyleHash {
+        size_t operator()(const TextStyle &style) const;
+    };
+    using StyleIndices = std::unordered_map<TextStyle, uint32_t, StyleHash>;
+
+    bool init();
+    PageInstances *getPageInstances(const FontEntry &fontEntry, char32_t character);
+    uint32_t getStyleIndex(const TextStyle &style);
+    void clearStylePalette();
+    void releaseUnusedPages();
+
+    glm::mat4 _matrix{};
+    std::vector<FontEntry> _fontEntries{};
+    size_t _currentFontIndex{};
+
+    // Pages stay across frames, so steady frames find their pages without rasterizing or
+    // allocating. Pages a frame did not use are dropped at its flush.
+    std::vector<PageInstances> _pages{};
+    std::map<std::pair<const RasteredFontStorage *, uint32_t>, size_t> _pageIndices{};
+    const RasteredFontStorage *_lastPageStorage{};
+    uint32_t _lastPageRangeIndex{};
+    size_t _lastPageIndex{};
+
+    // Style 0 is never used, every string has a palette entry.
+    std::vector<TextStyle> _stylePalette{};
+    std::vector<glm::vec4> _stylePaletteData{};
+    StyleIndices _styleIndices{};
+    // Nodes of the styles of earlier frames, reused so steady frames insert without allocating.
+    std::vector<StyleIndices::node_type> _spareStyleNodes{};
+    size_t _lastStyleIndex{};
+    size_t _stringCount{};
+
+    TextBufferUniquePtr _textBuffer{};
+    PooledShaderBuffer _stylePaletteBuffer{};
+    std::vector<size_t> _pageStarts{};
+    ImmediateTextStats _stats{};
+};
+
+RENDELL_USE_RAII_FACTORY(ImmediateTextRenderer)
+} // namespace rendell_text
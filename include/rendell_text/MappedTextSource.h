@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <rendell/rendell.h>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace rendell_text {
+// A read-only UTF-8 file mapped into memory for viewing files far larger than a TextLayout
+// should hold. Opening takes constant time: the line index is built by a background thread and
+// only keeps the offset of every LINE_INDEX_STRIDE-th line. Lay out the visible window only by
+// passing getLines to TextLayout::setText.
+class MappedTextSource final {
+public:
+    static constexpr size_t LINE_INDEX_STRIDE = 4096;
+
+    MappedTextSource();
+    ~MappedTextSource();
+
+    bool open(const std::filesystem::path &filePath);
+    void close();
+
+    bool isOpen() const;
+    const std::filesystem::path &getFilePath() const;
+    // In bytes.
+    size_t getSize() const;
+
+    bool isIndexComplete() const;
+    // Lines found by the background index so far, the final count once it is complete. A text
+    // ending with '\n' has an empty last line, as in TextLayout.
+    size_t getLineCount() const;
+    // Byte offset of the start of the line, getSize() past the end of the file. Lines the index
+    // has not reached yet are searched for from its last entry.
+    size_t getLineOffset(size_t lineIndex) const;
+    // View into the mapping covering the lines with the '\n's between them, valid until close.
+    std::u8string_view getLines(size_t firstLine, size_t lineCount) const;
+
+private:
+    void buildLineIndex();
+    // Offset after the lineCount-th '\n' from offset on, std::string_view::npos if there are
+    // fewer.
+    size_t skipLines(size_t offset, size_t lineCount) const;
+
+    std::filesystem::path _filePath{};
+    const char8_t *_data{nullptr};
+    size_t _size{};
+
+    mutable std::mutex _lineIndexMutex{};
+    std::vector<size_t> _lineIndex{};
+    std::atomic<size_t> _lineCount{};
+    std::atomic<bool> _indexComplete{};
+    std::atomic<bool> _stopIndexing{};
+    std::thread _indexThread{};
+};
+
+RENDELL_USE_RAII_FACTORY(MappedTextSource)
+} // namespace rendell_text
@@ -0,0 +1,104 @@
+#pragma once
+#include "TextStyle.h"
+#include "private/GlyphBuffer.h"
+#include "private/RasteredFontStorage.h"
+
+#include <glm/glm.hpp>
+#include <map>
+#include <rendell/rendell.h>
+#include <string_view>
+#include <vector>
+
+namespace rendell_text {
+// A fixed-size character grid for monospace fonts (terminals, log views).
+// Each cell is a packed 32-bit value: the codepoint in the low bits and an attribute index in the
+// high bits. Glyph positions are derived from the cell index in the shader, so only changed rows
+// are uploaded and scrolling just moves the ring-buffer origin.
+// An attribute selects the text and background color of its cell from the attribute palette, the
+// way a style index does in a TextLayout. Attributes without a style, 0 among them, draw in the
+// renderer colors.
+class TextGrid final {
+public:
+    static constexpr uint32_t CODEPOINT_BITS = 21;
+    static constexpr uint32_t CODEPOINT_MASK = (1u << CODEPOINT_BITS) - 1;
+    static constexpr uint32_t MAX_ATTRIBUTE = (1u << (32 - CODEPOINT_BITS)) - 1;
+
+    TextGrid();
+    ~TextGrid();
+
+    bool isInitialized() const;
+
+    void update();
+
+    void setFontPath(const std::filesystem::path &fontPath);
+    void setFontSize(const glm::ivec2 &fontSize);
+    void setGridSize(uint32_t columns, uint32_t rows);
+
+    void setCell(uint32_t column, uint32_t row, char32_t character, uint32_t attribute = 0);
+    // Writes the text starting at the cell and clips it at the end of the row.
+    void setText(uint32_t column, uint32_t row, std::wstring_view text, uint32_t attribute = 0);
+    void clearRow(uint32_t row);
+    void clear();
+    // Moves the content up by rowCount rows; the rows that appear at the bottom are blank.
+    void scroll(uint32_t rowCount);
+    // Only the colors of the style are used, grids draw no underline or strikethrough.
+    void setAttributeStyle(uint32_t attribute, const TextStyle &style);
+    void clearAttributeStyles();
+
+    const std::filesystem::path &getFontPath() const;
+    glm::ivec2 getFontSize() const;
+    uint32_t getColumns() const;
+    uint32_t getRows() const;
+    uint32_t getFirstRow() const;
+    glm::vec2 getCellSize() const;
+    char32_t getCharacter(uint32_t column, uint32_t row) const;
+    uint32_t getAttribute(uint32_t column, uint32_t row) const;
+    // Attribute 0 followed by every attribute up to the highest one with a style.
+    const std::vector<TextStyle> &getAttributePalette() const;
+    bool hasAttributeStyle(uint32_t attribute) const;
+    // Whether a cell background pass has anything to draw.
+    bool hasAttributeBackgrounds() const;
+    // Cell backgrounds span from the descender of the font up to the cell height.
+    float getCellDescender() const;
+
+    const std::vector<GlyphBufferSharedPtr> &getGlyphBuffersForRendering() const;
+    void useCellBuffer(uint32_t cellBufferBinding) const;
+    void useAttributePalette(uint32_t attributePaletteBinding) const;
+
+private:
+    bool init();
+
+    size_t getCellIndex(uint32_t column, uint32_t row) const;
+    void writeCell(size_t cellIndex, uint32_t value);
+    void markRowDirty(uint32_t storageRow);
+    void updateCellSize();
+    void updateGlyphBuffers();
+    void uploadDirtyRows();
+    void uploadAttributePalette();
+
+    RasteredFontStorageSharedPtr getRasteredFontStorage() const;
+
+    glm::ivec2 _fontSize = glm::ivec2(64, 64);
+    std::filesystem::path _fontPath{};
+    uint32_t _columns{};
+    uint32_t _rows{};
+    uint32_t _firstRow{};
+    glm::vec2 _cellSize{};
+    float _cellDescender{};
+
+    std::vector<uint32_t> _cells{};
+    std::vector<bool> _dirtyRows{};
+    std::map<uint32_t, size_t> _rangeUsage{};
+    std::vector<TextStyle> _attributePalette = std::vector<TextStyle>(1);
+    // Per palette entry, whether setAttributeStyle gave it a style.
+    std::vector<bool> _attributeStyled = std::vector<bool>(1);
+
+    RasteredFontStorageSharedPtr _rasteredFontStorage{nullptr};
+    std::vector<GlyphBufferSharedPtr> _glyphBuffersForRendering{};
+    rendell::oop::ShaderBufferSharedPtr _cellBuffer{};
+    rendell::oop::ShaderBufferSharedPtr _attributePaletteBuffer{};
+    size_t _updateActionFlags{};
+};
+
+RENDELL_USE_RAII_FACTORY(TextGrid)
+} // namespace rendell_text
@@ -0,0 +1,37 @@
+#pragma once
+#include "TextGrid.h"
+#include <rendell/oop/raii.h>
+
+#include <glm/glm.hpp>
+#include <rendell/rendell.h>
+
+namespace rendell_text {
+class TextGridRenderer final {
+public:
+    TextGridRenderer();
+    ~TextGridRenderer();
+
+    bool isInitialized() const;
+    const TextGridSharedPtr &getTextGrid() const;
+
+    void setTextGrid(const TextGridSharedPtr &textGrid);
+    void setMatrix(const glm::mat4 &matrix);
+    void setColor(const glm::vec4 &color);
+    void setBackgroundColor(const glm::vec4 backgroundColor);
+
+    const glm::vec4 &getColor() const;
+
+    void draw();
+
+private:
+    bool init();
+    void setUniforms();
+
+    TextGridSharedPtr _textGrid{};
+    glm::mat4 _matrix{};
+    glm::vec4 _color{};
+    glm::vec4 _backgroundColor{};
+};
+
+RENDELL_USE_RAII_FACTORY(TextGridRenderer)
+} // namespace rendell_text
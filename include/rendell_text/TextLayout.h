@@ -1,61 +1,244 @@
 #pragma once
+#include "TextStyle.h"
 #include "private/RasteredFontStorage.h"
 #include "private/TextBatch.h"
 
+#include <deque>
 #include <glm/glm.hpp>
 #include <map>
 #include <rendell/rendell.h>
-#include <unordered_set>
+#include <span>
+#include <string_view>
+#include <vector>
 
 namespace rendell_text {
+struct LayoutKey;
+struct LayoutParagraph;
+struct LayoutSnapshotKey;
+struct LayoutState;
+
+struct TextRect {
+    glm::vec2 position{};
+    glm::vec2 size{};
+};
+
+enum class WrapMode : uint8_t {
+    // Lines break at '\n' only.
+    None,
+    // Lines break after the last space that fits, long words fall back to Character.
+    Word,
+    // Lines break before the first character that does not fit.
+    Character,
+};
+
 class TextLayout final {
 public:
     TextLayout();
     ~TextLayout();
 
     bool isInitialized() const;
-    const std::unordered_set<TextBatchSharedPtr> &getTextBatchesForRendering() const;
-    std::wstring getSubText(size_t indexFrom) const;
+    const std::vector<TextBatchSharedPtr> &getTextBatchesForRendering() const;
+    std::wstring_view getSubText(size_t indexFrom) const;
 
     void update();
 
     void setFontPath(const std::filesystem::path &fontPath);
-    void setText(const std::wstring &value);
+    // Only the range that differs from the current text is laid out again. Styles and font runs
+    // keep their positions.
+    void setText(const wchar_t *value);
+    void setText(std::wstring_view value);
     void setText(std::wstring &&value);
+    void setText(std::u8string_view value);
+    void setText(std::u32string_view value);
     void setFontSize(const glm::ivec2 &fontSize);
+    // Fonts tried in order for characters the main font has no glyph for.
+    void setFallbackFontPaths(const std::vector<std::filesystem::path> &fontPaths);
 
     const std::filesystem::path &getFontPath() const;
+    const std::vector<std::filesystem::path> &getFallbackFontPaths() const;
+    // Characters no font of the chain has a glyph for, counted by the last layout pass.
+    size_t getMissingGlyphCount() const;
     glm::ivec2 getFontSize() const;
     const std::wstring &getText() const;
     size_t getTextLength() const;
     uint32_t getFontHeight() const;
     uint32_t getAscender() const;
     uint32_t getDescender() const;
+    // Advances are relative to the start of the visual line, wrapped lines start over at 0.
     const std::vector<uint32_t> &getTextAdvance() const;
 
+    // Wrapping applies when the mode is not None and the width is positive. Line breaks are
+    // cached per paragraph: a width change only breaks the paragraphs again without shaping
+    // them, and an edit shapes only the paragraphs it touches.
+    void setWrapWidth(float wrapWidth);
+    void setWrapMode(WrapMode wrapMode);
+    float getWrapWidth() const;
+    WrapMode getWrapMode() const;
+
+    // Lazy reflow for large documents: only the paragraphs with lines in the range get their
+    // instances rebuilt and drawn, so a resize drag costs the breaking of the text plus the
+    // instances on screen. Queries still cover the whole text. The range is in lines of the
+    // current layout, set it again after the lines change. A layout with visible lines is never
+    // shared and cannot be saved as a snapshot.
+    void setVisibleLines(size_t firstLine, size_t lineCount);
+    void clearVisibleLines();
+
+    // Console mode: once the text holds more than maxLineCount lines or maxLength units,
+    // appendText drops the oldest lines (0 means no limit). Appends only lay out and upload the
+    // new text, and dropped lines leave the GPU by advancing the instance rings.
+    void setScrollbackLimit(size_t maxLineCount, size_t maxLength = 0);
+    size_t getMaxLineCount() const;
+    size_t getMaxLength() const;
+    // Layout-space point the instance data is relative to, the renderer subtracts it.
+    glm::vec2 getInstanceOrigin() const;
+    // Changes whenever a layout pass or a style change may have changed what is drawn. Values
+    // are unique across all layouts, so caches keyed by it never mix two layouts up.
+    uint64_t getRevision() const;
+
+    // A snapshot is the finished layout of a static text, GPU instance data included, for
+    // showing it on the next run without laying it out. Only layouts without styles and font
+    // runs are saved. Loading checks the snapshot against the text, the font contents, the font
+    // size and the wrap settings; on a mismatch it returns false and the text is laid out as
+    // usual. Glyph pages are still rasterized, use embedded fonts to skip that too.
+    std::vector<uint8_t> saveSnapshot() const;
+    bool loadSnapshot(std::span<const uint8_t> snapshot);
+
+    // Line and hit-testing queries run the CPU layout if needed but never upload to the GPU.
+    // Lines are visual lines, wrapped ones included. Coordinates are in layout space: the first
+    // baseline is at y = 0 and every next line is placed by the height of the tallest font run
+    // of its paragraph.
+    size_t getLineCount() const;
+    size_t getLineIndex(size_t characterIndex) const;
+    std::pair<size_t, size_t> getLineRange(size_t lineIndex) const;
+    size_t getCharacterIndex(const glm::vec2 &point) const;
+    TextRect getCharacterRect(size_t characterIndex) const;
+    TextRect getCaretRect(size_t characterIndex) const;
+
     void eraseText(size_t startIndex);
     void eraseText(size_t startIndex, size_t count);
-    void insertText(const std::wstring &text, size_t startIndex = 0);
-    void appendText(const std::wstring &text);
+    void insertText(std::wstring_view text, size_t startIndex = 0);
+    void insertText(std::u8string_view text, size_t startIndex = 0);
+    void insertText(std::u32string_view text, size_t startIndex = 0);
+    void appendText(std::wstring_view text);
+    void appendText(std::u8string_view text);
+    void appendText(std::u32string_view text);
+
+    // Styled spans override the renderer colors. They are kept across edits: insertText and
+    // eraseText shift them, text inserted at a span boundary stays unstyled. Up to
+    // MAX_INSTANCE_STYLE_INDEX distinct styles can be in use at once, the palette drops the
+    // styles no span uses any more when it fills up.
+    void setTextStyle(size_t startIndex, size_t count, const TextStyle &style);
+    void clearTextStyle(size_t startIndex, size_t count);
+    void clearTextStyles();
+    void useStylePalette(uint32_t stylePaletteBinding) const;
+    // Indexed by the style bits of the instances, index 0 stands for the renderer colors.
+    const std::vector<TextStyle> &getStylePalette() const;
+
+    // Font runs lay a range out with another face and size; the fallback chain still applies.
+    // Runs share the baseline of their line and the line grows to fit the tallest run.
+    void setTextFont(size_t startIndex, size_t count, const std::filesystem::path &fontPath,
+                     const glm::ivec2 &fontSize);
+    void clearTextFont(size_t startIndex, size_t count);
+    void clearTextFonts();
 
 private:
+    // A range of the text mapped to a style (index into _stylePalette) or a font run (index into
+    // _fontRuns, 0 being the layout font).
+    struct TextSpan {
+        size_t from{};
+        size_t to{};
+        uint32_t index{};
+    };
+
+    struct FontRun {
+        std::filesystem::path fontPath{};
+        glm::ivec2 fontSize{};
+    };
+
     bool init();
+    // Swaps in _decodedText, invalidating only the range that differs from the current text.
+    void replaceText();
+    // The range is in the current text, everything outside of it is unchanged since the last
+    // layout pass.
+    void invalidateLayout(size_t fromIndex, size_t toIndex);
+    void onTextAppended(size_t oldLength);
+    void trimScrollback();
+
+    uint32_t getStyleIndex(const TextStyle &style);
+    // Drops the styles no span references any more and renumbers the spans.
+    void compactStylePalette();
+    static void assignSpan(std::vector<TextSpan> &spans, size_t from, size_t to, uint32_t index);
+    void shiftTextSpans(size_t index, size_t insertedCount, size_t erasedCount);
 
+    bool isLayoutShareable() const;
+    // Fills the key in place, reusing the storage it already has.
+    void makeLayoutKey(LayoutKey &layoutKey) const;
+    bool makeSnapshotKey(LayoutSnapshotKey &snapshotKey) const;
+    void prepareLayoutStateForWriting() const;
     void updateShaderBuffers() const;
+    bool evictParagraphs(size_t length) const;
+    bool shapeParagraphs(size_t paragraphIndex, size_t keptBackCount) const;
+    bool shapeParagraph(size_t paragraphStart, size_t paragraphEnd,
+                        LayoutParagraph &paragraph) const;
+    void measureParagraph(size_t paragraphStart, size_t paragraphEnd,
+                          LayoutParagraph &paragraph) const;
+    void breakParagraph(size_t paragraphStart, LayoutParagraph &paragraph) const;
+    void placeParagraphs(size_t paragraphIndex) const;
+    // Refills every batch for 0, appends the instances of the paragraphs from the index on
+    // otherwise. Only the paragraphs with visible lines are filled.
+    void fillTextBatches(size_t paragraphIndex) const;
 
+    void clearBufferCache() const;
+    void bumpRevision() const;
     void updateBuffersIfNeeded() const;
+    void uploadBuffersIfNeeded() const;
 
-    RasteredFontStorageSharedPtr getRasteredFontStorage() const;
-    TextBatchSharedPtr createTextBatch(wchar_t character) const;
+    RasteredFontStorageSharedPtr getRasteredFontStorage(const std::filesystem::path &fontPath,
+                                                        const glm::ivec2 &fontSize) const;
+    const std::vector<RasteredFontStorageSharedPtr> &getFontChain(uint32_t fontRunIndex) const;
+    glm::ivec2 getFontRunSize(uint32_t fontRunIndex) const;
+    const RasteredFontStorageSharedPtr &resolveFontStorage(char32_t character,
+                                                           uint32_t fontRunIndex,
+                                                           size_t &missingGlyphCount) const;
+    uint32_t createTextBatch(uint32_t rangeIndex,
+                             const RasteredFontStorageSharedPtr &rasteredFontStorage) const;
 
     glm::ivec2 _fontSize = glm::ivec2(64, 64);
     std::filesystem::path _fontPath{};
+    std::vector<std::filesystem::path> _fallbackFontPaths{};
     std::wstring _text{};
+    std::wstring _decodedText{};
+    std::vector<TextSpan> _textSpans{};
+    // Index 0 stands for the renderer colors and is never referenced by a span.
+    std::vector<TextStyle> _stylePalette{TextStyle{}};
+    std::vector<TextSpan> _fontSpans{};
+    // Index 0 stands for the layout font and is never referenced by a span.
+    std::vector<FontRun> _fontRuns{FontRun{}};
+    float _wrapWidth{};
+    WrapMode _wrapMode{WrapMode::None};
+    bool _visibleLinesSet{};
+    size_t _visibleFirstLine{};
+    size_t _visibleLineCount{};
+    size_t _maxLineCount{};
+    size_t _maxLength{};
+    // Positions of the '\n's counted from the start of everything ever appended, so dropping
+    // lines does not shift them.
+    std::deque<size_t> _lineEnds{};
+    bool _lineEndsValid{};
+    size_t _evictedLength{};
 
     mutable RasteredFontStorageSharedPtr _rasteredFontStorage{nullptr};
-    mutable std::map<uint32_t, TextBatchSharedPtr> _cachedTextBatches{};
-    mutable std::unordered_set<TextBatchSharedPtr> _textBatchesForRendering{};
-    mutable std::vector<uint32_t> _textAdvance{};
+    // Per font run: the run's own font followed by the fallback fonts at the run's size.
+    mutable std::vector<std::vector<RasteredFontStorageSharedPtr>> _fontChains{};
+    // Plain text layouts with equal text and fonts share one state through the layout cache.
+    mutable std::shared_ptr<LayoutState> _layoutState{};
+    mutable rendell::oop::ShaderBufferSharedPtr _stylePaletteBuffer{};
+    mutable size_t _relayoutFrom{};
+    // Length of the text tail that is unchanged since the last layout pass.
+    mutable size_t _unchangedSuffix{};
+    // Units dropped from the front since the last layout pass.
+    mutable size_t _pendingEviction{};
+    mutable uint64_t _revision{};
     mutable size_t _updateActionFlags{};
 };
 
@@ -0,0 +1,67 @@
+#pragma once
+#include "private/RasteredFontStorage.h"
+
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <rendell/rendell.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rendell_text {
+struct TextMeasurement {
+    float width{};
+    float height{};
+    // Start and width of every line, explicit and wrapped ones alike.
+    std::vector<size_t> lineStarts{};
+    std::vector<float> lineWidths{};
+};
+
+// Answers size queries with glyph advances only: nothing is rasterized and nothing reaches the
+// GPU, so UI layout passes can measure any number of strings up front. Lines are fontSize.y
+// apart, as in a TextLayout without font runs.
+class TextMeasurer final {
+public:
+    TextMeasurer();
+    ~TextMeasurer();
+
+    bool isInitialized() const;
+
+    void setFontPath(const std::filesystem::path &fontPath);
+    void setFontSize(const glm::ivec2 &fontSize);
+    void setFallbackFontPaths(const std::vector<std::filesystem::path> &fontPaths);
+
+    const std::filesystem::path &getFontPath() const;
+    glm::ivec2 getFontSize() const;
+    const std::vector<std::filesystem::path> &getFallbackFontPaths() const;
+
+    float getAdvance(char32_t character) const;
+    // Width of the widest line.
+    float measureWidth(std::wstring_view text) const;
+    // Lines break at '\n' and, when maxWidth is positive, exactly where a TextLayout with word
+    // wrap at that width breaks them: before the word that would overflow it, with the spaces
+    // after a word hanging past the edge. A word longer than maxWidth is split between
+    // characters.
+    TextMeasurement measure(std::wstring_view text, float maxWidth = 0.0f) const;
+    // Number of units from the start of a single-line text that fit into maxWidth.
+    size_t fitText(std::wstring_view text, float maxWidth) const;
+    // The text cut to fit maxWidth together with the ellipsis, or the text itself if it fits.
+    std::wstring truncateText(std::wstring_view text, float maxWidth,
+                              std::wstring_view ellipsis = L"\u2026") const;
+
+private:
+    bool init();
+    void updateFontStoragesIfNeeded() const;
+    float measureLineWidth(std::wstring_view text) const;
+
+    glm::ivec2 _fontSize = glm::ivec2(64, 64);
+    std::filesystem::path _fontPath{};
+    std::vector<std::filesystem::path> _fallbackFontPaths{};
+
+    // The main font followed by the fallback fonts.
+    mutable std::vector<RasteredFontStorageSharedPtr> _rasteredFontStorages{};
+    mutable bool _fontStoragesDirty{true};
+};
+
+RENDELL_USE_RAII_FACTORY(TextMeasurer)
+} // namespace rendell_text
@@ -1,15 +1,25 @@
 #pragma once
 #include "TextLayout.h"
 #include "private/RasteredFontStorage.h"
+#include "private/ShaderBufferPool.h"
 #include "private/TextBatch.h"
+#include "private/TextSurfaceCache.h"
 #include <rendell/oop/raii.h>
 
 #include <glm/glm.hpp>
 #include <map>
 #include <rendell/rendell.h>
+#include <span>
 #include <unordered_set>
 
 namespace rendell_text {
+// One placement of the layout for TextRenderer::drawCopies, laid out as the copyBuffer in
+// TextRenderer.vs.
+struct TextCopy {
+    glm::mat4 matrix{1.0f};
+    glm::vec4 color{1.0f};
+};
+
 class TextRenderer final {
 public:
     TextRenderer();
@@ -25,16 +35,32 @@ public:
 
     const glm::vec4 &getColor() const;
 
+    // Cached mode composites the layout into one texture and draws it as a single quad for as
+    // long as the layout and the colors stay the same, which suits large blocks of text that
+    // rarely change. The surfaces share the budget of TextSurfaceCache::getShared(); a layout
+    // whose surface does not fit is drawn glyph by glyph, and so is every drawCopies call.
+    void setCached(bool cached);
+    bool isCached() const;
+
     void draw();
+    // Draws the layout once per copy, each with its own matrix and text color, using one
+    // instanced draw per batch. The renderer matrix and color are not used.
+    void drawCopies(std::span<const TextCopy> copies);
 
 private:
     bool init();
     void setUniforms();
+    void drawBatches(uint32_t copyCount);
+    bool drawSurface();
 
     TextLayoutSharedPtr _textLayout{};
     glm::mat4 _matrix{};
     glm::vec4 _color{};
     glm::vec4 _backgroundColor{};
+    PooledShaderBuffer _copyBuffer{};
+    std::shared_ptr<TextSurfaceCache> _surfaceCache{};
+    // Set when the surface for the key did not fit, so it is not composited every frame.
+    TextSurfaceKey _rejectedSurfaceKey{};
 };
 
 RENDELL_USE_RAII_FACTORY(TextRenderer)
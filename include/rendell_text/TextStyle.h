@@ -0,0 +1,14 @@
+#pragma once
+#include <glm/glm.hpp>
+
+namespace rendell_text {
+struct TextStyle {
+    glm::vec4 color{};
+    // Highlights the whole character cell, e.g. for selections.
+    glm::vec4 backgroundColor{};
+    bool underline{};
+    bool strikethrough{};
+
+    bool operator==(const TextStyle &) const = default;
+};
+} // namespace rendell_text
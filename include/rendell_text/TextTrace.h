@@ -0,0 +1,47 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace rendell_text {
+// Bucket i counts the calls that took [2^(i-1), 2^i) nanoseconds, the last one everything longer.
+inline constexpr size_t TEXT_TRACE_HISTOGRAM_SIZE = 48;
+
+struct TextTraceCallStats {
+    const char *name{};
+    uint64_t count{};
+    uint64_t totalNanoseconds{};
+    uint64_t maxNanoseconds{};
+    std::array<uint64_t, TEXT_TRACE_HISTOGRAM_SIZE> histogram{};
+};
+
+struct TextTraceReport {
+    // One entry per traced call, the ones that never happened have a count of 0.
+    std::vector<TextTraceCallStats> calls{};
+};
+
+// Records every TextLayout and TextRenderer call the application makes, with its arguments and
+// latency, into a compact binary trace. Calls the library makes on its own, like the layout
+// update of a draw, are part of the call that made them. Recording needs a build with
+// RENDELL_TEXT_ENABLE_TRACE, otherwise the calls are not instrumented and startTextTrace fails.
+bool startTextTrace(const std::filesystem::path &tracePath);
+void stopTextTrace();
+bool isTextTraceRecording();
+
+// The latencies as they were recorded.
+bool summarizeTextTrace(std::span<const uint8_t> trace, TextTraceReport &report);
+enum class TextTraceReplayMode : uint8_t {
+    // Every call runs as recorded, draws go to the current rendell context.
+    Full,
+    // No rendell context is needed: update and the renderer calls are skipped, the layout
+    // calls are measured alone.
+    Headless,
+};
+
+// Runs the calls of the trace again on new layouts and renderers and measures them, e.g. to
+// compare two builds on a captured workload. The font paths of the trace have to exist.
+bool replayTextTrace(std::span<const uint8_t> trace, TextTraceReport &report,
+                     TextTraceReplayMode mode = TextTraceReplayMode::Full);
+} // namespace rendell_text
@@ -1,19 +1,34 @@
 #pragma once
 #include <glm/glm.hpp>
-#include <map>
-#include <rendell/oop/rendell_oop.h>
-#include <rendell/rendell.h>
+
+#include <cstdint>
+#include <vector>
 
 namespace rendell_text {
 struct RasterizedChar {
-    wchar_t character{};
+    char32_t character{};
     glm::ivec2 glyphSize{};
     glm::ivec2 glyphBearing{};
     uint32_t glyphAdvance{};
 };
 
+// Single-channel coverage bitmaps of a glyph range, kept in host memory.
+// Every glyph occupies its own glyphWidth x glyphHeight cell, stored one after another.
+struct GlyphBitmapPage {
+    uint32_t glyphWidth{};
+    uint32_t glyphHeight{};
+    uint32_t glyphCount{};
+    std::vector<uint8_t> pixels{};
+
+    size_t getGlyphByteSize() const { return static_cast<size_t>(glyphWidth) * glyphHeight; }
+
+    const uint8_t *getGlyphPixels(size_t index) const {
+        return pixels.data() + index * getGlyphByteSize();
+    }
+};
+
 struct FontRasterizationResult {
-    rendell::oop::Texture2DArraySharedPtr texture2DArray{};
+    GlyphBitmapPage bitmapPage{};
     std::vector<RasterizedChar> rasterizedChars{};
 };
 
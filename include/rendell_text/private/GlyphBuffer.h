@@ -9,19 +9,38 @@
 namespace rendell_text {
 class GlyphBuffer {
 public:
-    GlyphBuffer(wchar_t from, wchar_t to, FontRasterizationResult &&fontRasterizationResult);
+    // Block compressed pages go to the GPU as BC4 blocks, see setGlyphBlockCompression. The
+    // bitmap page stays uncompressed.
+    GlyphBuffer(char32_t from, char32_t to, FontRasterizationResult &&fontRasterizationResult,
+                bool blockCompressed = false);
 
+    // Uploads the whole bitmap page into a new texture, e.g. after the context was lost. Otherwise
+    // the page goes to the GPU on its first use, so layouts that are only measured or hit-tested
+    // never touch it.
+    void upload();
     void use(rendell::UniformSampler2DId uniformSampler2DId, uint32_t textureBlock) const;
+    // Binds a per-glyph (size, bearing) table for shaders that place glyphs themselves.
+    void useMetrics(uint32_t metricsBufferBinding) const;
 
-    const RasterizedChar &getRasterizedChar(wchar_t character) const;
+    const GlyphBitmapPage &getBitmapPage() const;
+    bool isBlockCompressed() const;
+    // Bytes of the texture the page was uploaded to.
+    size_t getGpuByteSize() const;
+
+    const RasterizedChar &getRasterizedChar(char32_t character) const;
     const std::vector<RasterizedChar> &getRasterizedChars() const;
-    const std::pair<wchar_t, wchar_t> &getRange() const;
+    const std::pair<char32_t, char32_t> &getRange() const;
 
 private:
+    void uploadTextures() const;
+    void uploadBlockCompressed() const;
+
     FontRasterizationResult _fontRasterizationResult{};
 
-    std::pair<wchar_t, wchar_t> _range{};
-    rendell::oop::Texture2DArraySharedPtr _textures{};
+    std::pair<char32_t, char32_t> _range{};
+    bool _blockCompressed{};
+    mutable rendell::oop::Texture2DArraySharedPtr _textures{};
+    mutable rendell::oop::ShaderBufferSharedPtr _metricsBuffer{};
 };
 
 RENDELL_USE_RAII_FACTORY(GlyphBuffer)
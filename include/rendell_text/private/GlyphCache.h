@@ -0,0 +1,100 @@
+#pragma once
+#include "GlyphBuffer.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace rendell_text {
+class RasteredFontStorage;
+
+struct GlyphCacheStats {
+    // Lookups answered by each tier. A GPU miss goes on to the compressed tier, a compressed miss
+    // to the font raster.
+    size_t gpuHitCount{};
+    size_t gpuMissCount{};
+    size_t compressedHitCount{};
+    size_t compressedMissCount{};
+    size_t gpuPageCount{};
+    size_t gpuBytes{};
+    size_t compressedPageCount{};
+    size_t compressedBytes{};
+};
+
+// A glyph page evicted from the GPU, run-length encoded: coverage bitmaps are mostly zeros.
+struct CompressedGlyphPage {
+    std::pair<char32_t, char32_t> range{};
+    uint32_t glyphWidth{};
+    uint32_t glyphHeight{};
+    uint32_t glyphCount{};
+    std::vector<RasterizedChar> rasterizedChars{};
+    std::vector<uint8_t> pixels{};
+    // Whether the page goes back to the GPU as BC4 blocks.
+    bool blockCompressed{};
+
+    size_t getByteSize() const;
+};
+
+// Two-tier cache of the glyph pages of every font storage. Pages on the GPU are kept up to a
+// byte budget; the least recently used ones nobody draws with are compressed into host memory,
+// which has a budget of its own. A compressed page comes back to the GPU by decompressing it,
+// without rasterizing the glyphs again.
+class GlyphCache final {
+public:
+    static constexpr size_t DEFAULT_MAX_GPU_BYTES = 64 << 20;
+    static constexpr size_t DEFAULT_MAX_COMPRESSED_BYTES = 16 << 20;
+
+    GlyphCache() = default;
+    ~GlyphCache() = default;
+
+    // The cache shared by all font storages.
+    static std::shared_ptr<GlyphCache> getShared();
+
+    // Texture bytes of the pages on the GPU. Pages in use are never evicted, so the budget may be
+    // exceeded while they are.
+    void setMaxGpuBytes(size_t maxGpuBytes);
+    void setMaxCompressedBytes(size_t maxCompressedBytes);
+    // Moves every page nobody draws with to the compressed tier, e.g. on a low memory warning.
+    void trim();
+
+    GlyphCacheStats getStats() const;
+
+    GlyphBufferSharedPtr find(const RasteredFontStorage *owner, uint32_t rangeIndex);
+    void insert(const RasteredFontStorage *owner, uint32_t rangeIndex,
+                GlyphBufferSharedPtr glyphBuffer);
+    // Drops the pages of the storage from both tiers.
+    void erase(const RasteredFontStorage *owner);
+
+private:
+    using Key = std::pair<const RasteredFontStorage *, uint32_t>;
+
+    struct GpuPage {
+        Key key{};
+        GlyphBufferSharedPtr glyphBuffer{};
+        size_t byteSize{};
+    };
+
+    struct CompressedPage {
+        Key key{};
+        CompressedGlyphPage page{};
+    };
+
+    static CompressedGlyphPage compressPage(const GlyphBuffer &glyphBuffer);
+    static GlyphBufferSharedPtr decompressPage(const CompressedGlyphPage &page);
+
+    void insertCompressed(const Key &key, CompressedGlyphPage &&page);
+    void trimGpuTier(size_t maxGpuBytes);
+    void trimCompressedTier();
+
+    // Most recently used first.
+    std::list<GpuPage> _gpuPages{};
+    std::map<Key, std::list<GpuPage>::iterator> _gpuPageIndices{};
+    std::list<CompressedPage> _compressedPages{};
+    std::map<Key, std::list<CompressedPage>::iterator> _compressedPageIndices{};
+
+    size_t _maxGpuBytes{DEFAULT_MAX_GPU_BYTES};
+    size_t _maxCompressedBytes{DEFAULT_MAX_COMPRESSED_BYTES};
+    GlyphCacheStats _stats{};
+};
+} // namespace rendell_text
@@ -0,0 +1,28 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rendell_text {
+// Set of codepoints a font has glyphs for, answering membership queries in O(1).
+// The Unicode range is split into 256-codepoint pages; only pages with glyphs own a bitmap.
+class GlyphCoverage {
+public:
+    GlyphCoverage() = default;
+    ~GlyphCoverage() = default;
+
+    void clear();
+    void add(char32_t codepoint);
+
+    bool contains(char32_t codepoint) const;
+    size_t getCount() const;
+
+private:
+    using Page = std::array<uint64_t, 4>;
+
+    std::vector<uint16_t> _pageIndices{};
+    std::vector<Page> _pages{};
+    size_t _count{};
+};
+} // namespace rendell_text
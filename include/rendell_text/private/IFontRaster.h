@@ -20,11 +20,17 @@ public:
     virtual int getFontHeight() const = 0;
     virtual int getAscender() const = 0;
     virtual int getDescender() const = 0;
+    virtual bool hasGlyph(char32_t character) const = 0;
+    // The advance in 26.6 units, as in RasterizedChar, read without rendering the glyph.
+    virtual uint32_t getGlyphAdvance(char32_t character) const = 0;
+    // Hash of the font data, equal for the same face in every run. Keys persisted layouts.
+    virtual uint64_t getContentHash() const = 0;
 
     virtual bool loadFont(const std::filesystem::path &fontPath, uint32_t width,
                           uint32_t height) = 0;
 
-    virtual bool rasterize(wchar_t from, wchar_t to, FontRasterizationResult &result) = 0;
+    // Characters without a glyph in the font come back empty, with zero size and advance.
+    virtual bool rasterize(char32_t from, char32_t to, FontRasterizationResult &result) = 0;
 };
 
 RENDELL_USE_RAII(IFontRaster)
@@ -1,32 +1,42 @@
 #pragma once
 #include <rendell_text/private/GlyphBuffer.h>
+#include <rendell_text/private/GlyphCache.h>
 #include <rendell_text/private/IFontRaster.h>
 
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 
 namespace rendell_text {
 class RasteredFontStorage {
 public:
-    RasteredFontStorage(IFontRasterSharedPtr fontRaster, wchar_t charRangeSize);
-    ~RasteredFontStorage() = default;
+    RasteredFontStorage(IFontRasterSharedPtr fontRaster, uint32_t charRangeSize,
+                        bool blockCompressed = false);
+    ~RasteredFontStorage();
 
     void clearCache();
-    GlyphBufferSharedPtr rasterizeGlyphRange(wchar_t rangeIndex);
+    GlyphBufferSharedPtr rasterizeGlyphRange(uint32_t rangeIndex);
 
-    wchar_t getRangeIndex(wchar_t character) const;
+    // Cached advance in 26.6 units. It never rasterizes, so measuring stays off the GPU.
+    uint32_t getGlyphAdvance(char32_t character);
+
+    uint32_t getRangeIndex(char32_t character) const;
     uint32_t getFontWidth() const;
     uint32_t getFontHeight() const;
+    bool isBlockCompressed() const;
     const IFontRasterSharedPtr getFontRaster() const;
 
 private:
-    GlyphBufferSharedPtr createGlyphBuffer(wchar_t rangeIndex);
+    GlyphBufferSharedPtr createGlyphBuffer(uint32_t rangeIndex);
 
     IFontRasterSharedPtr _fontRaster;
     uint32_t _fontWidth = 64, _fontHeight = 64;
-    const wchar_t _charRangeSize;
-    std::map<wchar_t, std::shared_ptr<GlyphBuffer>> _cachedGlyphBuffers{};
+    const uint32_t _charRangeSize;
+    const bool _blockCompressed;
+    // Pages are kept by the shared cache, evicted ones come back without rasterizing again.
+    std::shared_ptr<GlyphCache> _glyphCache{};
+    std::unordered_map<char32_t, uint32_t> _cachedGlyphAdvances{};
 };
 
 RENDELL_USE_RAII_FACTORY(RasteredFontStorage)
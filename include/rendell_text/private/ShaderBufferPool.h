@@ -0,0 +1,81 @@
+#pragma once
+#include <rendell/oop/rendell_oop.h>
+#include <rendell/rendell.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace rendell_text {
+class ShaderBufferPool;
+
+struct ShaderBufferPoolStats {
+    // Buffers created through the driver and buffers handed out again from the free lists.
+    size_t createdBufferCount{};
+    size_t reusedBufferCount{};
+    size_t usedBufferCount{};
+    size_t usedBytes{};
+    size_t freeBufferCount{};
+    size_t freeBytes{};
+};
+
+// A shader buffer borrowed from a ShaderBufferPool, handed back to it on destruction.
+class PooledShaderBuffer final {
+public:
+    PooledShaderBuffer() = default;
+    PooledShaderBuffer(std::shared_ptr<ShaderBufferPool> pool,
+                       rendell::oop::ShaderBufferSharedPtr shaderBuffer, size_t size);
+    PooledShaderBuffer(PooledShaderBuffer &&other) noexcept;
+    PooledShaderBuffer &operator=(PooledShaderBuffer &&other) noexcept;
+    PooledShaderBuffer(const PooledShaderBuffer &) = delete;
+    PooledShaderBuffer &operator=(const PooledShaderBuffer &) = delete;
+    ~PooledShaderBuffer();
+
+    void reset();
+
+    rendell::oop::ShaderBuffer *operator->() const;
+    explicit operator bool() const;
+    size_t getSize() const;
+
+private:
+    std::shared_ptr<ShaderBufferPool> _pool{};
+    rendell::oop::ShaderBufferSharedPtr _shaderBuffer{};
+    size_t _size{};
+};
+
+// Shader buffers bucketed by power-of-two size classes and shared by every layout, so layouts
+// that come and go reuse the same driver allocations.
+class ShaderBufferPool final : public std::enable_shared_from_this<ShaderBufferPool> {
+public:
+    static constexpr size_t MIN_SIZE_CLASS = 1 << 10;
+    static constexpr size_t DEFAULT_MAX_FREE_BYTES = 32 << 20;
+
+    ShaderBufferPool() = default;
+    ~ShaderBufferPool() = default;
+
+    // The pool shared by all layouts.
+    static std::shared_ptr<ShaderBufferPool> getShared();
+    static size_t getSizeClass(size_t size);
+
+    // Returns a buffer of getSizeClass(size) bytes that starts with the dataSize bytes of data.
+    // The rest of a new buffer is zero, a recycled one keeps its previous contents there.
+    PooledShaderBuffer acquire(size_t size, const rendell::byte_t *data = nullptr,
+                               size_t dataSize = 0);
+
+    // Free buffers above this budget are destroyed instead of being kept for reuse.
+    void setMaxFreeBytes(size_t maxFreeBytes);
+    void trim();
+
+    ShaderBufferPoolStats getStats() const;
+
+private:
+    friend class PooledShaderBuffer;
+
+    void release(rendell::oop::ShaderBufferSharedPtr shaderBuffer, size_t size);
+    void trimToBudget();
+
+    std::map<size_t, std::vector<rendell::oop::ShaderBufferSharedPtr>> _freeBuffers{};
+    size_t _maxFreeBytes{DEFAULT_MAX_FREE_BYTES};
+    ShaderBufferPoolStats _stats{};
+};
+} // namespace rendell_text
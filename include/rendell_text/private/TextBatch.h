@@ -10,22 +10,26 @@
 namespace rendell_text {
 struct TextBatch {
 public:
-    TextBatch(GlyphBufferSharedPtr glyphBuffer, size_t textBufferSize);
+    TextBatch(GlyphBufferSharedPtr glyphBuffer, size_t textBufferCapacity);
     ~TextBatch() = default;
 
     void beginUpdating();
-    void appendCharacter(wchar_t character, glm::vec2 offset);
+    void appendCharacter(char32_t character, glm::vec2 offset, uint32_t styleIndex = 0);
+    void appendRect(const glm::vec4 &rect, RectKind rectKind, uint32_t styleIndex);
+    void appendInstance(uint32_t packedCharacter, const glm::vec4 &transform);
+    void appendInstances(const uint32_t *packedCharacters, const glm::vec4 *transforms,
+                         size_t count);
+    void eraseFirstInstances(size_t count);
+    void eraseLastInstances(size_t count);
     void endUpdating();
 
     const GlyphBuffer *getGlyphBuffer() const;
-    const std::vector<TextBufferUniquePtr> &getTextBuffers() const;
+    // All instances of the batch live in one buffer and go out as a single draw.
+    const TextBuffer &getTextBuffer() const;
 
 private:
-    size_t _counter{};
-    size_t _textBufferSize{};
-
     GlyphBufferSharedPtr _glyphBuffer{};
-    std::vector<TextBufferUniquePtr> _textBuffers{};
+    TextBufferUniquePtr _textBuffer{};
 };
 
 RENDELL_USE_RAII_FACTORY(TextBatch)
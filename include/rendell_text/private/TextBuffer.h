@@ -1,5 +1,6 @@
 #pragma once
 #include "FontRasterizationResult.h"
+#include "ShaderBufferPool.h"
 
 #include <rendell/oop/rendell_oop.h>
 #include <rendell/rendell.h>
@@ -9,32 +10,88 @@
 #include <vector>
 
 namespace rendell_text {
+// Bit layout of the per-instance text value, shared with TextRenderer.vs.
+// Glyph instances store the codepoint in the low bits, rect instances store their RectKind.
+inline constexpr uint32_t INSTANCE_CODEPOINT_MASK = (1u << 21) - 1;
+inline constexpr uint32_t INSTANCE_STYLE_SHIFT = 21;
+inline constexpr uint32_t MAX_INSTANCE_STYLE_INDEX = (1u << 10) - 1;
+inline constexpr uint32_t INSTANCE_RECT_FLAG = 1u << 31;
+
+enum class RectKind : uint32_t {
+    Background = 0,
+    Foreground = 1,
+};
+
+inline uint32_t packGlyphInstance(char32_t character, uint32_t styleIndex) {
+    return (styleIndex << INSTANCE_STYLE_SHIFT) |
+           (static_cast<uint32_t>(character) & INSTANCE_CODEPOINT_MASK);
+}
+
+inline uint32_t packRectInstance(RectKind rectKind, uint32_t styleIndex) {
+    return INSTANCE_RECT_FLAG | (styleIndex << INSTANCE_STYLE_SHIFT) |
+           static_cast<uint32_t>(rectKind);
+}
+
+// CPU-side instance data mirrored into a pair of shader buffers. The capacity grows
+// geometrically and only shrinks once the content drops well below it, so text that keeps
+// changing length does not reallocate on every update.
+// The instances form a ring: dropping the oldest ones only advances its base, and endUpdating
+// uploads just the range of instances that changed since the last upload.
 class TextBuffer {
 public:
-    TextBuffer(size_t length);
+    TextBuffer(size_t capacity);
     ~TextBuffer() = default;
 
+    // Starts over from an empty buffer.
     void beginUpdating();
-    void appendCharacter(const RasterizedChar &rasterizedChar, glm::vec2 offset);
+    void appendCharacter(const RasterizedChar &rasterizedChar, glm::vec2 offset,
+                         uint32_t styleIndex = 0);
+    // Appends a solid quad filled with the background or text color of the style.
+    void appendRect(const glm::vec4 &rect, RectKind rectKind, uint32_t styleIndex);
+    void appendInstance(uint32_t packedCharacter, const glm::vec4 &transform);
+    void appendInstances(const uint32_t *packedCharacters, const glm::vec4 *transforms,
+                         size_t count);
     void insertCharacter(const RasterizedChar &rasterizedChar, glm::vec2 offset, size_t index);
+    void eraseFirstInstances(size_t count);
+    void eraseLastInstances(size_t count);
     void endUpdating();
-    void updateBufferSubData(size_t from, size_t to);
 
-    bool isFull() const;
     void use(uint32_t textBufferBinding, uint32_t transformBufferBinding) const;
 
-    size_t getLength() const;
+    size_t getCapacity() const;
     size_t getCurrentLength() const;
+    // Instance i is stored at (base + i) % capacity.
+    size_t getBase() const;
+    // Copies the current instances in order, the arrays must hold getCurrentLength() of them.
+    void copyInstances(uint32_t *packedCharacters, glm::vec4 *transforms) const;
 
 private:
-    size_t _length{};
+    static size_t getRingCapacity(size_t count);
+    size_t getRingIndex(size_t index) const;
+    void markChanged(size_t from, size_t to);
+    void resize(size_t capacity);
+    void reallocate();
+    void upload(size_t from, size_t to);
+
+    size_t _minCapacity{};
+    size_t _capacity{};
+    size_t _base{};
     size_t _counter{};
+    // Instances in [_uploadFrom, _uploadTo) changed since the last upload, the slots outside of
+    // it match the GPU.
+    size_t _uploadFrom{};
+    size_t _uploadTo{};
+    // Ring slots below it are known to hold the same data on the GPU. A recycled buffer keeps
+    // the contents of its previous owner, so only uploaded slots count.
+    size_t _mirroredSize{};
+    bool _reallocatePending{true};
 
     std::vector<uint32_t> _textBufferData{};
     std::vector<glm::vec4> _transformBufferData{};
 
-    rendell::oop::ShaderBufferSharedPtr _textBuffer{};
-    rendell::oop::ShaderBufferSharedPtr _transformBuffer{};
+    std::shared_ptr<ShaderBufferPool> _shaderBufferPool{};
+    PooledShaderBuffer _textBuffer{};
+    PooledShaderBuffer _transformBuffer{};
 };
 
 RENDELL_USE_RAII_FACTORY(TextBuffer)
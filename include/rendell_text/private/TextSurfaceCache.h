@@ -0,0 +1,81 @@
+#pragma once
+#include <rendell/oop/rendell_oop.h>
+#include <rendell/rendell.h>
+
+#include <glm/glm.hpp>
+#include <list>
+#include <map>
+#include <memory>
+
+namespace rendell_text {
+class TextRenderer;
+
+// What a surface was composited from. The matrix is not part of it: the surface has the
+// resolution of the glyph pages, so it scales and moves like the glyphs would.
+struct TextSurfaceKey {
+    uint64_t layoutRevision{};
+    glm::vec4 color{};
+    glm::vec4 backgroundColor{};
+
+    bool operator==(const TextSurfaceKey &) const = default;
+};
+
+// A layout composited into one RGBA texture, drawn as a single quad covering rect.
+struct TextSurface {
+    TextSurfaceKey key{};
+    // Layout-space origin in xy and size in zw, one texel per layout unit.
+    glm::vec4 rect{};
+    rendell::oop::Texture2DArraySharedPtr texture{};
+    size_t byteSize{};
+};
+
+struct TextSurfaceCacheStats {
+    // A miss is a draw that had to composite its surface again.
+    size_t hitCount{};
+    size_t missCount{};
+    size_t surfaceCount{};
+    size_t bytes{};
+};
+
+// Surfaces of the renderers in cached mode, one per renderer, kept up to a byte budget. The least
+// recently drawn ones are dropped first and composited again on their next draw.
+class TextSurfaceCache final {
+public:
+    static constexpr size_t DEFAULT_MAX_BYTES = 32 << 20;
+
+    TextSurfaceCache() = default;
+    ~TextSurfaceCache() = default;
+
+    // The cache shared by all renderers.
+    static std::shared_ptr<TextSurfaceCache> getShared();
+
+    // Surfaces larger than the budget are never cached, their renderers draw the glyphs.
+    void setMaxBytes(size_t maxBytes);
+    size_t getMaxBytes() const;
+    void trim();
+
+    TextSurfaceCacheStats getStats() const;
+
+    // Returns the surface of the renderer if it was composited for the key, a stale one is
+    // dropped.
+    const TextSurface *find(const TextRenderer *owner, const TextSurfaceKey &key);
+    // Returns nullptr when the surface does not fit the budget.
+    const TextSurface *insert(const TextRenderer *owner, TextSurface &&surface);
+    void erase(const TextRenderer *owner);
+
+private:
+    struct Entry {
+        const TextRenderer *owner{};
+        TextSurface surface{};
+    };
+
+    void trimToBudget(size_t maxBytes);
+
+    // Most recently drawn first.
+    std::list<Entry> _entries{};
+    std::map<const TextRenderer *, std::list<Entry>::iterator> _entryIndices{};
+
+    size_t _maxBytes{DEFAULT_MAX_BYTES};
+    TextSurfaceCacheStats _stats{};
+};
+} // namespace rendell_text
@@ -1,4 +1,12 @@
 #pragma once
 
+#include "EmbeddedFont.h"
+#include "GlyphCompression.h"
+#include "ImmediateTextRenderer.h"
+#include "MappedTextSource.h"
+#include "TextGrid.h"
+#include "TextGridRenderer.h"
 #include "TextLayout.h"
+#include "TextMeasurer.h"
 #include "TextRenderer.h"
+#include "TextTrace.h"
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace rendell_text {
+inline constexpr size_t BC4_BLOCK_SIZE = 8;
+
+// Bytes of the BC4 (RGTC1) blocks of a width x height single-channel image. Edge blocks are
+// padded to 4 x 4 by repeating the last row and column.
+size_t bc4_encoded_size(uint32_t width, uint32_t height);
+
+// Blocks are stored row by row, each as the two endpoints followed by 16 3-bit indices. Every
+// block is fitted in both modes, 8 interpolated values or 6 plus exact 0 and 255, and keeps the
+// one with the lower squared error. The index search runs on all 16 pixels at once when SSE2 is
+// available.
+void encode_bc4(const uint8_t *pixels, uint32_t width, uint32_t height, uint8_t *dst);
+// Decodes with the same rounding the encoder measured its error with.
+void decode_bc4(const uint8_t *blocks, uint32_t width, uint32_t height, uint8_t *dst);
+} // namespace rendell_text
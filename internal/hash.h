@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace rendell_text {
+inline constexpr uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+
+// 64-bit FNV-1a. Unlike std::hash it gives the same value in every run and build, so it can key
+// data that is written to disk. Pass the previous result as the seed to hash several blocks.
+inline uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = HASH_SEED) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t result = seed;
+    for (size_t i = 0; i < size; i++) {
+        result = (result ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return result;
+}
+} // namespace rendell_text
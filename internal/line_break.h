@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+namespace rendell_text {
+// Breaks a paragraph of length units into lines no wider than maxWidth, given the pen position
+// after every unit. A space may hang over the edge, and a surrogate pair is never split. With
+// breakAtWords a line ends after its last space, and a word that does not fit on a line of its
+// own is broken at the character. The start of every line after the first is appended to
+// lineStarts. TextLayout and TextMeasurer both break through it, so measured sizes match the
+// laid out ones.
+void break_lines(const wchar_t *text, const float *penPositions, size_t length, float maxWidth,
+                 bool breakAtWords, std::vector<size_t> &lineStarts);
+} // namespace rendell_text
@@ -0,0 +1,16 @@
+#pragma once
+#include <memory>
+
+namespace rendell_text {
+// The instance of T shared by everybody who asks for it. It lives as long as somebody holds it
+// and the next call after the last holder let go creates a new one.
+template <typename T> std::shared_ptr<T> getSharedInstance() {
+    static std::weak_ptr<T> s_sharedInstance;
+    std::shared_ptr<T> result = s_sharedInstance.lock();
+    if (!result) {
+        result = std::make_shared<T>();
+        s_sharedInstance = result;
+    }
+    return result;
+}
+} // namespace rendell_text
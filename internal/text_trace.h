@@ -0,0 +1,182 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <rendell_text/TextTrace.h>
+#include <span>
+
+namespace rendell_text {
+inline constexpr uint32_t TEXT_TRACE_MAGIC = 0x52545452; // "RTTR"
+inline constexpr uint32_t TEXT_TRACE_VERSION = 1;
+
+// The traced calls. Values are stored in traces: new calls go to the end, before Count.
+enum class TextTraceCall : uint8_t {
+    LayoutDestroy,
+    LayoutUpdate,
+    LayoutSetFontPath,
+    LayoutSetText,
+    LayoutSetFontSize,
+    LayoutSetFallbackFontPaths,
+    LayoutSetWrapWidth,
+    LayoutSetWrapMode,
+    LayoutSetScrollbackLimit,
+    LayoutGetLineCount,
+    LayoutGetLineIndex,
+    LayoutGetLineRange,
+    LayoutGetCharacterIndex,
+    LayoutGetCharacterRect,
+    LayoutGetCaretRect,
+    LayoutEraseText,
+    LayoutInsertText,
+    LayoutAppendText,
+    LayoutSetTextStyle,
+    LayoutClearTextStyle,
+    LayoutClearTextStyles,
+    LayoutSetTextFont,
+    LayoutClearTextFont,
+    LayoutClearTextFonts,
+    RendererDestroy,
+    RendererSetTextLayout,
+    RendererSetMatrix,
+    RendererSetColor,
+    RendererSetBackgroundColor,
+    RendererSetCached,
+    RendererDraw,
+    RendererDrawCopies,
+    LayoutSetVisibleLines,
+    LayoutClearVisibleLines,
+    Count,
+};
+
+inline constexpr const char *TEXT_TRACE_CALL_NAMES[] = {
+    "TextLayout::~TextLayout",
+    "TextLayout::update",
+    "TextLayout::setFontPath",
+    "TextLayout::setText",
+    "TextLayout::setFontSize",
+    "TextLayout::setFallbackFontPaths",
+    "TextLayout::setWrapWidth",
+    "TextLayout::setWrapMode",
+    "TextLayout::setScrollbackLimit",
+    "TextLayout::getLineCount",
+    "TextLayout::getLineIndex",
+    "TextLayout::getLineRange",
+    "TextLayout::getCharacterIndex",
+    "TextLayout::getCharacterRect",
+    "TextLayout::getCaretRect",
+    "TextLayout::eraseText",
+    "TextLayout::insertText",
+    "TextLayout::appendText",
+    "TextLayout::setTextStyle",
+    "TextLayout::clearTextStyle",
+    "TextLayout::clearTextStyles",
+    "TextLayout::setTextFont",
+    "TextLayout::clearTextFont",
+    "TextLayout::clearTextFonts",
+    "TextRenderer::~TextRenderer",
+    "TextRenderer::setTextLayout",
+    "TextRenderer::setMatrix",
+    "TextRenderer::setColor",
+    "TextRenderer::setBackgroundColor",
+    "TextRenderer::setCached",
+    "TextRenderer::draw",
+    "TextRenderer::drawCopies",
+    "TextLayout::setVisibleLines",
+    "TextLayout::clearVisibleLines",
+};
+static_assert(std::size(TEXT_TRACE_CALL_NAMES) == static_cast<size_t>(TextTraceCall::Count));
+
+inline bool is_text_trace_layout_call(TextTraceCall call) {
+    // Layout calls added after the renderer ones follow them.
+    return call < TextTraceCall::RendererDestroy || call >= TextTraceCall::LayoutSetVisibleLines;
+}
+
+// A trace is the magic and the version followed by the records. Integers are LEB128 varints, so
+// the format does not depend on the byte order, floats are stored in the native format. A record
+// carries the size of its arguments, readers skip the ones they do not need.
+struct TextTraceRecord {
+    TextTraceCall call{};
+    // Layouts and renderers are numbered from 1 in the order they were first called, 0 stands
+    // for none.
+    uint64_t objectId{};
+    // Since the start of the previous call.
+    uint64_t startDelta{};
+    uint64_t duration{};
+    std::span<const uint8_t> arguments{};
+};
+
+inline bool read_text_trace_varint(std::span<const uint8_t> data, size_t &offset,
+                                   uint64_t &value) {
+    value = 0;
+    for (uint32_t shift = 0; shift < 64 && offset < data.size(); shift += 7) {
+        const uint8_t byte = data[offset++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Leaves the offset at the first record.
+inline bool read_text_trace_header(std::span<const uint8_t> trace, size_t &offset) {
+    uint64_t magic{};
+    uint64_t version{};
+    offset = 0;
+    return read_text_trace_varint(trace, offset, magic) && magic == TEXT_TRACE_MAGIC &&
+           read_text_trace_varint(trace, offset, version) && version == TEXT_TRACE_VERSION;
+}
+
+inline bool read_text_trace_record(std::span<const uint8_t> trace, size_t &offset,
+                                   TextTraceRecord &record) {
+    uint64_t call{};
+    uint64_t argumentsSize{};
+    if (!read_text_trace_varint(trace, offset, call) ||
+        call >= static_cast<uint64_t>(TextTraceCall::Count) ||
+        !read_text_trace_varint(trace, offset, record.objectId) ||
+        !read_text_trace_varint(trace, offset, record.startDelta) ||
+        !read_text_trace_varint(trace, offset, record.duration) ||
+        !read_text_trace_varint(trace, offset, argumentsSize) ||
+        argumentsSize > trace.size() - offset) {
+        return false;
+    }
+    record.call = static_cast<TextTraceCall>(call);
+    record.arguments = trace.subspan(offset, static_cast<size_t>(argumentsSize));
+    offset += static_cast<size_t>(argumentsSize);
+    return true;
+}
+
+inline void add_text_trace_sample(TextTraceReport &report, TextTraceCall call,
+                                  uint64_t duration) {
+    if (report.calls.empty()) {
+        report.calls.resize(static_cast<size_t>(TextTraceCall::Count));
+        for (size_t i = 0; i < report.calls.size(); i++) {
+            report.calls[i].name = TEXT_TRACE_CALL_NAMES[i];
+        }
+    }
+    TextTraceCallStats &stats = report.calls[static_cast<size_t>(call)];
+    stats.count++;
+    stats.totalNanoseconds += duration;
+    stats.maxNanoseconds = std::max(stats.maxNanoseconds, duration);
+    const size_t bucket = static_cast<size_t>(std::bit_width(duration));
+    stats.histogram[std::min(bucket, stats.histogram.size() - 1)]++;
+}
+
+// Collects the latencies as they were recorded, nothing is called.
+inline bool summarize_text_trace(std::span<const uint8_t> trace, TextTraceReport &report) {
+    size_t offset{};
+    if (!read_text_trace_header(trace, offset)) {
+        return false;
+    }
+    TextTraceRecord record;
+    while (offset < trace.size()) {
+        if (!read_text_trace_record(trace, offset, record)) {
+            return false;
+        }
+        add_text_trace_sample(report, record.call, record.duration);
+    }
+    return true;
+}
+} // namespace rendell_text
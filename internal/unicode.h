@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace rendell_text {
+inline constexpr char32_t REPLACEMENT_CHARACTER = 0xFFFD;
+inline constexpr char32_t MAX_CODEPOINT = 0x10FFFF;
+
+// Returns the number of wchar_t units the codepoint occupies (2 for surrogate pairs on UTF-16
+// platforms).
+size_t wide_length(char32_t codepoint);
+
+// Writes the codepoint as UTF-16 or UTF-32 depending on sizeof(wchar_t) and returns the number
+// of written units.
+size_t encode_wide(char32_t codepoint, wchar_t *dst);
+
+// Returns true for the second unit of a surrogate pair, which never starts a character.
+bool is_trailing_unit(wchar_t unit);
+
+// Length of the longest common prefix and suffix in units, compared 16 bytes per step when
+// SSE2 is available. A surrogate pair may be split by the result.
+size_t common_prefix_length(std::wstring_view a, std::wstring_view b);
+size_t common_suffix_length(std::wstring_view a, std::wstring_view b);
+
+// Decodes the codepoint starting at index and advances index past it. Unpaired surrogates are
+// reported as REPLACEMENT_CHARACTER.
+char32_t next_codepoint(std::wstring_view text, size_t &index);
+
+// The decoders write straight into the destination string without an intermediate buffer.
+// Malformed input is replaced by REPLACEMENT_CHARACTER.
+void append_utf8(std::wstring &dst, std::u8string_view src);
+void append_utf32(std::wstring &dst, std::u32string_view src);
+void insert_utf8(std::wstring &dst, size_t index, std::u8string_view src);
+void insert_utf32(std::wstring &dst, size_t index, std::u32string_view src);
+} // namespace rendell_text
@@ -0,0 +1,91 @@
+#version 450 core
+
+layout(location = 0) in vec2 a_VertexPosition;
+
+uniform mat4 u_Matrix;
+uniform vec4 u_TextColor;
+uniform vec2 u_FontSize;
+uniform vec2 u_CellSize;
+uniform int u_CharFrom;
+uniform int u_CharCount;
+uniform int u_Columns;
+uniform int u_Rows;
+uniform int u_FirstRow;
+uniform int u_AttributeCount;
+uniform int u_BackgroundPass;
+uniform vec2 u_CellBackgroundOffset;
+
+layout(std430, binding = 0) buffer cellBuffer { uint cells[]; };
+layout(std430, binding = 1) buffer glyphMetricsBuffer { vec4 glyphMetrics[]; };
+layout(std430, binding = 2) buffer stylePaletteBuffer { vec4 stylePalette[]; };
+
+out vec2 v_UV;
+flat out vec4 v_TextColor;
+flat out uint v_TextureIndex;
+flat out uint v_StyleIndex;
+flat out uint v_RectKind;
+
+const uint RECT_KIND_BACKGROUND = 0u;
+const uint RECT_KIND_NONE = 0xFFFFFFFFu;
+
+// Cells another pass draws are collapsed outside the clip volume.
+void skipCell()
+{
+	gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+	v_UV = vec2(0.0);
+	v_TextColor = vec4(0.0);
+	v_TextureIndex = 0u;
+	v_StyleIndex = 0u;
+	v_RectKind = RECT_KIND_NONE;
+}
+
+void main()
+{
+	const uint cell = cells[gl_InstanceID];
+	const uint attribute = cell >> 21;
+	// Attributes past the palette and the ones without a style, marked by a negative text
+	// alpha, take the renderer colors like attribute 0.
+	const bool styled =
+		attribute < uint(u_AttributeCount) && stylePalette[attribute * 2u].a >= 0.0;
+	const uint styleIndex = styled ? attribute : 0u;
+
+	const int storageRow = gl_InstanceID / u_Columns;
+	const int column = gl_InstanceID - storageRow * u_Columns;
+	const int row = (storageRow - u_FirstRow + u_Rows) % u_Rows;
+	const vec2 cellOrigin = vec2(column, row) * u_CellSize;
+
+	// The background pass fills whole cells, so backgrounds of adjacent cells join up.
+	if (u_BackgroundPass != 0) {
+		if (styleIndex == 0u) {
+			skipCell();
+			return;
+		}
+		gl_Position = u_Matrix *
+			vec4(a_VertexPosition * u_CellSize + cellOrigin + u_CellBackgroundOffset, 0.0, 1.0);
+		v_UV = vec2(0.0);
+		v_TextColor = u_TextColor;
+		v_TextureIndex = 0u;
+		v_StyleIndex = styleIndex;
+		v_RectKind = RECT_KIND_BACKGROUND;
+		return;
+	}
+
+	// Cells of other glyph ranges are drawn by another pass.
+	const int glyphIndex = int(cell & 0x1FFFFFu) - u_CharFrom;
+	if (glyphIndex < 0 || glyphIndex >= u_CharCount) {
+		skipCell();
+		return;
+	}
+
+	const vec4 metrics = glyphMetrics[glyphIndex];
+	const vec2 scale = metrics.xy;
+	const vec2 bearing = metrics.zw;
+	const vec2 offset = cellOrigin + vec2(bearing.x, bearing.y - scale.y);
+
+	gl_Position = u_Matrix * vec4(a_VertexPosition * scale + offset, 0.0, 1.0);
+	v_UV = vec2(a_VertexPosition.x, 1.0 - a_VertexPosition.y) * scale / u_FontSize;
+	v_TextColor = u_TextColor;
+	v_TextureIndex = uint(glyphIndex);
+	v_StyleIndex = styleIndex;
+	v_RectKind = RECT_KIND_NONE;
+}
\ No newline at end of file
@@ -2,18 +2,99 @@
 
 in vec2 v_UV;
 flat in uint v_TextureIndex;
+flat in vec4 v_TextColor;
 out vec4 o_Color;
 
 uniform sampler2DArray u_Textures;
-uniform vec4 u_TextColor;
 uniform vec4 u_BackgroundColor;
 
+#ifdef RT_STYLES
+flat in uint v_StyleIndex;
+flat in uint v_RectKind;
+
+// Pairs of (text color, background color), style 0 means the renderer or copy colors.
+layout(std430, binding = 2) buffer stylePaletteBuffer { vec4 stylePalette[]; };
+
+const uint RECT_KIND_BACKGROUND = 0u;
+const uint RECT_KIND_FOREGROUND = 1u;
+#endif
+
+#ifdef RT_BC4
+uniform vec2 u_FontSize;
+
+// A 4x4 block is two RGBA texels: the endpoints and the first two index bytes, then the other
+// four index bytes. The 48 index bits split into two halves of eight 3-bit indices.
+float fetchBlockCompressed(ivec2 pixel, int layer)
+{
+	const ivec2 block = pixel / 4;
+	const vec4 headTexel = texelFetch(u_Textures, ivec3(block.x * 2, block.y, layer), 0);
+	const vec4 tailTexel = texelFetch(u_Textures, ivec3(block.x * 2 + 1, block.y, layer), 0);
+	const uvec4 head = uvec4(round(headTexel * 255.0));
+	const uvec4 tail = uvec4(round(tailTexel * 255.0));
+	const int i = (pixel.y % 4) * 4 + pixel.x % 4;
+	const uint bits = i < 8 ? head.z | (head.w << 8u) | (tail.x << 16u)
+	                        : tail.y | (tail.z << 8u) | (tail.w << 16u);
+	const uint index = (bits >> (3u * uint(i % 8))) & 7u;
+
+	const float endpoint0 = float(head.x) / 255.0;
+	const float endpoint1 = float(head.y) / 255.0;
+	if (index < 2u) {
+		return index == 0u ? endpoint0 : endpoint1;
+	}
+	if (head.x > head.y) {
+		return mix(endpoint1, endpoint0, float(8u - index) / 7.0);
+	}
+	if (index >= 6u) {
+		return index == 6u ? 0.0 : 1.0;
+	}
+	return mix(endpoint0, endpoint1, float(index - 1u) / 5.0);
+}
+
+// The texels hold blocks, not coverage, so the bilinear filter of the sampler is done by hand.
+float sampleGlyph(vec2 uv, uint layer)
+{
+	const ivec2 size = ivec2(u_FontSize);
+	const vec2 position = uv * u_FontSize - 0.5;
+	const ivec2 low = clamp(ivec2(floor(position)), ivec2(0), size - 1);
+	const ivec2 high = clamp(ivec2(floor(position)) + 1, ivec2(0), size - 1);
+	const vec2 weight = fract(position);
+	const float top = mix(fetchBlockCompressed(low, int(layer)),
+	                      fetchBlockCompressed(ivec2(high.x, low.y), int(layer)), weight.x);
+	const float bottom = mix(fetchBlockCompressed(ivec2(low.x, high.y), int(layer)),
+	                         fetchBlockCompressed(high, int(layer)), weight.x);
+	return mix(top, bottom, weight.y);
+}
+#else
+float sampleGlyph(vec2 uv, uint layer)
+{
+	return texture(u_Textures, vec3(uv, layer)).r;
+}
+#endif
+
 void main()
 {
-	const float sampled = texture(u_Textures, vec3(v_UV, v_TextureIndex)).r;
+	vec4 textColor = v_TextColor;
+	vec4 backgroundColor = u_BackgroundColor;
+#ifdef RT_STYLES
+	if (v_StyleIndex != 0u) {
+		textColor = stylePalette[v_StyleIndex * 2u];
+		backgroundColor = stylePalette[v_StyleIndex * 2u + 1u];
+	}
+
+	if (v_RectKind == RECT_KIND_BACKGROUND) {
+		o_Color = backgroundColor;
+		return;
+	}
+	if (v_RectKind == RECT_KIND_FOREGROUND) {
+		o_Color = textColor;
+		return;
+	}
+#endif
+
+	const float sampled = sampleGlyph(v_UV, v_TextureIndex);
 	const float sampledInverse = 1.0 - sampled;
 
-	const vec3 baseColor = u_TextColor.rgb * sampled + u_BackgroundColor.rgb * sampledInverse;
-	const float alpha = u_TextColor.a + u_BackgroundColor.a * sampledInverse;
+	const vec3 baseColor = textColor.rgb * sampled + backgroundColor.rgb * sampledInverse;
+	const float alpha = textColor.a + backgroundColor.a * sampledInverse;
 	o_Color = vec4(baseColor, alpha);
 }
\ No newline at end of file
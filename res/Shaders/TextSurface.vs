@@ -0,0 +1,16 @@
+#version 450 core
+
+layout(location = 0) in vec2 a_VertexPosition;
+
+uniform mat4 u_Matrix;
+// Layout-space origin in xy and size in zw.
+uniform vec4 u_SurfaceRect;
+
+out vec2 v_UV;
+
+void main()
+{
+	gl_Position = u_Matrix * vec4(a_VertexPosition * u_SurfaceRect.zw + u_SurfaceRect.xy, 0.0, 1.0);
+	// Row 0 of the surface is its top, as in the glyph pages.
+	v_UV = vec2(a_VertexPosition.x, 1.0 - a_VertexPosition.y);
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include <algorithm>
+#include <mutex>
+#include <rendell_text/EmbeddedFont.h>
+#include <vector>
+
+namespace rendell_text {
+static std::mutex s_embeddedFontsMutex;
+
+static std::vector<const EmbeddedFont *> &getEmbeddedFonts() {
+    static std::vector<const EmbeddedFont *> s_embeddedFonts;
+    return s_embeddedFonts;
+}
+
+static bool matchesPreset(const EmbeddedFont &font, const std::filesystem::path &fontPath,
+                          uint32_t fontWidth, uint32_t fontHeight) {
+    return font.fontWidth == fontWidth && font.fontHeight == fontHeight &&
+           fontPath == std::filesystem::path(font.name);
+}
+
+void registerEmbeddedFont(const EmbeddedFont &font) {
+    std::lock_guard lock(s_embeddedFontsMutex);
+    std::vector<const EmbeddedFont *> &fonts = getEmbeddedFonts();
+    // A face baked again at the same size replaces the previous one.
+    std::erase_if(fonts, [&](const EmbeddedFont *registered) {
+        return matchesPreset(*registered, font.name, font.fontWidth, font.fontHeight);
+    });
+    fonts.push_back(&font);
+}
+
+void unregisterEmbeddedFont(const EmbeddedFont &font) {
+    std::lock_guard lock(s_embeddedFontsMutex);
+    std::erase(getEmbeddedFonts(), &font);
+}
+
+const EmbeddedFont *findEmbeddedFont(const std::filesystem::path &fontPath, uint32_t fontWidth,
+                                     uint32_t fontHeight) {
+    std::lock_guard lock(s_embeddedFontsMutex);
+    const std::vector<const EmbeddedFont *> &fonts = getEmbeddedFonts();
+    const auto it = std::find_if(fonts.begin(), fonts.end(), [&](const EmbeddedFont *font) {
+        return matchesPreset(*font, fontPath, fontWidth, fontHeight);
+    });
+    return it != fonts.end() ? *it : nullptr;
+}
+} // namespace rendell_text
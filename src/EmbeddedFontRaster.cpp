@@ -0,0 +1,125 @@
+#include "EmbeddedFontRaster.h"
+
+#include <algorithm>
+#include <cstring>
+#include <hash.h>
+
+namespace rendell_text {
+static bool isBefore(const EmbeddedGlyph &glyph, char32_t character) {
+    return glyph.character < character;
+}
+
+static void copyGlyphBitmap(const EmbeddedFont &font, const EmbeddedGlyph &glyph,
+                            GlyphBitmapPage &page, size_t index) {
+    const uint8_t *src = font.pixels + glyph.pixelOffset;
+    uint8_t *cell = page.pixels.data() + index * page.getGlyphByteSize();
+    const uint32_t width = std::min<uint32_t>(glyph.width, page.glyphWidth);
+    const uint32_t rows = std::min<uint32_t>(glyph.height, page.glyphHeight);
+    for (uint32_t row = 0; row < rows; row++) {
+        std::memcpy(cell + static_cast<size_t>(row) * page.glyphWidth,
+                    src + static_cast<size_t>(row) * glyph.width, width);
+    }
+}
+
+EmbeddedFontRaster::EmbeddedFontRaster(const std::filesystem::path &fontPath, uint32_t width,
+                                       uint32_t height) {
+    if (!fontPath.empty()) {
+        loadFont(fontPath, width, height);
+    }
+}
+
+bool EmbeddedFontRaster::isInitialized() const {
+    return _font != nullptr;
+}
+
+const std::filesystem::path &EmbeddedFontRaster::getFontPath() const {
+    return _fontPath;
+}
+
+int EmbeddedFontRaster::getFontHeight() const {
+    return _font->height;
+}
+
+int EmbeddedFontRaster::getAscender() const {
+    return _font->ascender;
+}
+
+int EmbeddedFontRaster::getDescender() const {
+    return _font->descender;
+}
+
+bool EmbeddedFontRaster::hasGlyph(char32_t character) const {
+    return findGlyph(character) != nullptr;
+}
+
+uint32_t EmbeddedFontRaster::getGlyphAdvance(char32_t character) const {
+    const EmbeddedGlyph *glyph = findGlyph(character);
+    return glyph ? glyph->advance : 0;
+}
+
+uint64_t EmbeddedFontRaster::getContentHash() const {
+    if (!_font) {
+        return 0;
+    }
+    // Only the baked glyphs are served, so the baked data identifies the face, not its source.
+    const int metrics[]{_font->height, _font->ascender, _font->descender};
+    uint64_t result = hash_bytes(metrics, sizeof(metrics));
+    result = hash_bytes(_font->glyphs, _font->glyphCount * sizeof(EmbeddedGlyph), result);
+    return hash_bytes(_font->pixels, _font->pixelCount, result);
+}
+
+bool EmbeddedFontRaster::loadFont(const std::filesystem::path &fontPath, uint32_t width,
+                                  uint32_t height) {
+    _fontPath = fontPath;
+    _font = findEmbeddedFont(fontPath, width, height);
+    if (!_font) {
+        RT_ERROR("Font {} is not embedded at {}x{}", fontPath.string(), width, height);
+        return false;
+    }
+    return true;
+}
+
+bool EmbeddedFontRaster::rasterize(char32_t from, char32_t to, FontRasterizationResult &result) {
+#ifdef _DEBUG
+    assert(from < to);
+#endif
+
+    if (!_font) {
+        RT_ERROR("Embedded font is missing");
+        return false;
+    }
+
+    const uint32_t charCount = static_cast<uint32_t>(to - from);
+    GlyphBitmapPage bitmapPage{_font->fontWidth, _font->fontHeight, charCount};
+    bitmapPage.pixels.resize(bitmapPage.getGlyphByteSize() * charCount);
+    std::vector<RasterizedChar> rasterizedChars{};
+    rasterizedChars.reserve(charCount);
+
+    // Glyphs are sorted, so the range is a single walk from the first glyph at or after from.
+    const EmbeddedGlyph *const end = _font->glyphs + _font->glyphCount;
+    const EmbeddedGlyph *glyph = std::lower_bound(_font->glyphs, end, from, isBefore);
+    for (char32_t currentChar = from; currentChar < to; currentChar++) {
+        if (glyph == end || glyph->character != currentChar) {
+            rasterizedChars.push_back({currentChar});
+            continue;
+        }
+
+        copyGlyphBitmap(*_font, *glyph, bitmapPage, static_cast<size_t>(currentChar - from));
+        rasterizedChars.push_back({currentChar, glm::ivec2(glyph->width, glyph->height),
+                                   glm::ivec2(glyph->bearingX, glyph->bearingY), glyph->advance});
+        glyph++;
+    }
+
+    result = {std::move(bitmapPage), std::move(rasterizedChars)};
+    return true;
+}
+
+const EmbeddedGlyph *EmbeddedFontRaster::findGlyph(char32_t character) const {
+    if (!_font) {
+        return nullptr;
+    }
+    const EmbeddedGlyph *const end = _font->glyphs + _font->glyphCount;
+    const EmbeddedGlyph *glyph = std::lower_bound(_font->glyphs, end, character, isBefore);
+    return glyph != end && glyph->character == character ? glyph : nullptr;
+}
+} // namespace rendell_text
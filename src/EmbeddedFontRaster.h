@@ -0,0 +1,37 @@
+#pragma once
+#include <logging.h>
+#include <rendell/oop/raii.h>
+#include <rendell_text/EmbeddedFont.h>
+#include <rendell_text/private/IFontRaster.h>
+
+namespace rendell_text {
+// Serves glyphs baked into the binary by font_atlas_baker. Rasterization copies the stored
+// bitmaps into the page cells, no file is opened and FreeType is never initialized.
+class EmbeddedFontRaster : public IFontRaster {
+public:
+    EmbeddedFontRaster() = default;
+    EmbeddedFontRaster(const std::filesystem::path &fontPath, uint32_t width, uint32_t height);
+    ~EmbeddedFontRaster() = default;
+
+    bool isInitialized() const override;
+    const std::filesystem::path &getFontPath() const override;
+    int getFontHeight() const override;
+    int getAscender() const override;
+    int getDescender() const override;
+    bool hasGlyph(char32_t character) const override;
+    uint32_t getGlyphAdvance(char32_t character) const override;
+    uint64_t getContentHash() const override;
+
+    bool loadFont(const std::filesystem::path &fontPath, uint32_t width, uint32_t height) override;
+
+    bool rasterize(char32_t from, char32_t to, FontRasterizationResult &result) override;
+
+private:
+    const EmbeddedGlyph *findGlyph(char32_t character) const;
+
+    const EmbeddedFont *_font{nullptr};
+    std::filesystem::path _fontPath{};
+};
+
+RENDELL_USE_RAII_FACTORY(EmbeddedFontRaster)
+} // namespace rendell_text
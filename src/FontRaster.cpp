@@ -1,10 +1,25 @@
 #include "FontRaster.h"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <hash.h>
+
 namespace rendell_text {
 static uint32_t s_instanceCount = 0;
 static bool s_freeTypeInitialized = false;
 static FT_Library s_freetype;
 
+static void copyGlyphBitmap(const FT_Bitmap &bitmap, GlyphBitmapPage &page, size_t index) {
+    const uint32_t width = std::min(static_cast<uint32_t>(bitmap.width), page.glyphWidth);
+    const uint32_t rows = std::min(static_cast<uint32_t>(bitmap.rows), page.glyphHeight);
+    uint8_t *cell = page.pixels.data() + index * page.getGlyphByteSize();
+    for (uint32_t row = 0; row < rows; row++) {
+        std::memcpy(cell + static_cast<size_t>(row) * page.glyphWidth,
+                    bitmap.buffer + static_cast<ptrdiff_t>(row) * bitmap.pitch, width);
+    }
+}
+
 FontRaster::FontRaster(const std::filesystem::path &fontPath, uint32_t width, uint32_t height) {
     s_instanceCount++;
 
@@ -51,6 +66,44 @@ int FontRaster::getDescender() const {
     return descender;
 }
 
+bool FontRaster::hasGlyph(char32_t character) const {
+    return _glyphCoverage.contains(character);
+}
+
+uint32_t FontRaster::getGlyphAdvance(char32_t character) const {
+    if (!_face || !_glyphCoverage.contains(character)) {
+        return 0;
+    }
+
+    // FT_Get_Advance answers from the metrics tables, falling back to loading the outline for
+    // hinted glyphs; the bitmap is never rendered either way.
+    FT_Fixed advance{};
+    const FT_UInt glyphIndex = FT_Get_Char_Index(_face, character);
+    if (FT_Get_Advance(_face, glyphIndex, FT_LOAD_DEFAULT, &advance)) {
+        RT_ERROR("Failed to get advance of Glyph U+{:04X}", static_cast<uint32_t>(character));
+        return 0;
+    }
+    // 16.16 to 26.6.
+    return static_cast<uint32_t>(advance >> 10);
+}
+
+uint64_t FontRaster::getContentHash() const {
+    if (!_contentHash) {
+        std::ifstream file(_fontPath, std::ios::binary);
+        if (!file) {
+            RT_ERROR("Failed to read font file {}", _fontPath.string());
+            return 0;
+        }
+        uint64_t result = HASH_SEED;
+        char chunk[64 * 1024];
+        while (file.read(chunk, sizeof(chunk)) || file.gcount() > 0) {
+            result = hash_bytes(chunk, static_cast<size_t>(file.gcount()), result);
+        }
+        _contentHash = result;
+    }
+    return *_contentHash;
+}
+
 bool FontRaster::loadFont(const std::filesystem::path &fontPath, uint32_t width, uint32_t height) {
     releaseFace();
 
@@ -63,11 +116,12 @@ bool FontRaster::loadFont(const std::filesystem::path &fontPath, uint32_t width,
         return false;
     }
     FT_Set_Pixel_Sizes(_face, _width, _height);
+    buildGlyphCoverage();
 
     return true;
 }
 
-bool FontRaster::rasterize(wchar_t from, wchar_t to, FontRasterizationResult &result) {
+bool FontRaster::rasterize(char32_t from, char32_t to, FontRasterizationResult &result) {
 #ifdef _DEBUG
     assert(s_freeTypeInitialized);
     assert(from < to);
@@ -79,26 +133,29 @@ bool FontRaster::rasterize(wchar_t from, wchar_t to, FontRasterizationResult &re
     }
 
     const uint32_t charCount = static_cast<uint32_t>(to - from);
-    auto texture2DArray =
-        rendell::oop::makeTexture2DArray(_width, _height, charCount, rendell::TextureFormat::R);
+    GlyphBitmapPage bitmapPage{_width, _height, charCount};
+    bitmapPage.pixels.resize(bitmapPage.getGlyphByteSize() * charCount);
     std::vector<RasterizedChar> rasterizedChars{};
     rasterizedChars.reserve(charCount);
 
-    for (wchar_t currentChar = from; currentChar < to; currentChar++) {
+    for (char32_t currentChar = from; currentChar < to; currentChar++) {
+        // Most of a range is usually absent from the font, those glyphs are never rendered.
+        if (!_glyphCoverage.contains(currentChar)) {
+            rasterizedChars.push_back({currentChar});
+            continue;
+        }
+
         FT_Glyph glyph;
         if (!rasterizeChar(currentChar, glyph)) {
-            RT_ERROR("Failed to rasterize Glyph {}", static_cast<char>(currentChar));
+            RT_ERROR("Failed to rasterize Glyph U+{:04X}", static_cast<uint32_t>(currentChar));
             glyph = rasterizeGlyphStub();
         }
 
         const FT_BitmapGlyph bitmapGlyph = reinterpret_cast<FT_BitmapGlyph>(glyph);
 
         if (bitmapGlyph->bitmap.width > 0 && bitmapGlyph->bitmap.rows > 0) {
-            texture2DArray->setSubData(
-                static_cast<uint32_t>(currentChar - from),
-                static_cast<uint32_t>(bitmapGlyph->bitmap.width),
-                static_cast<uint32_t>(bitmapGlyph->bitmap.rows),
-                reinterpret_cast<const rendell::byte_t *>(bitmapGlyph->bitmap.buffer));
+            copyGlyphBitmap(bitmapGlyph->bitmap, bitmapPage,
+                            static_cast<size_t>(currentChar - from));
         }
 
         RasterizedChar rasterizedChar{
@@ -110,7 +167,7 @@ bool FontRaster::rasterize(wchar_t from, wchar_t to, FontRasterizationResult &re
         FT_Done_Glyph(glyph);
     }
 
-    result = {texture2DArray, std::move(rasterizedChars)};
+    result = {std::move(bitmapPage), std::move(rasterizedChars)};
     return true;
 }
 
@@ -135,16 +192,28 @@ void FontRaster::releaseFace() {
         FT_Done_Face(_face);
         _face = nullptr;
     }
+    _glyphCoverage.clear();
+    _contentHash.reset();
+}
+
+void FontRaster::buildGlyphCoverage() {
+    _glyphCoverage.clear();
+    FT_UInt glyphIndex = 0;
+    FT_ULong charCode = FT_Get_First_Char(_face, &glyphIndex);
+    while (glyphIndex != 0) {
+        _glyphCoverage.add(static_cast<char32_t>(charCode));
+        charCode = FT_Get_Next_Char(_face, charCode, &glyphIndex);
+    }
 }
 
-bool FontRaster::rasterizeChar(wchar_t character, FT_Glyph &result) {
+bool FontRaster::rasterizeChar(char32_t character, FT_Glyph &result) {
     if (FT_Load_Char(_face, character, FT_LOAD_RENDER)) {
-        RT_ERROR("Failed to load Glyph {}", static_cast<char>(character));
+        RT_ERROR("Failed to load Glyph U+{:04X}", static_cast<uint32_t>(character));
         return false;
     }
 
     if (FT_Get_Glyph(_face->glyph, &result)) {
-        RT_ERROR("Failed to get Glyph {}", static_cast<char>(character));
+        RT_ERROR("Failed to get Glyph U+{:04X}", static_cast<uint32_t>(character));
         return false;
     }
 
@@ -1,7 +1,9 @@
 #pragma once
 #include "freetype.h"
 #include <logging.h>
+#include <optional>
 #include <rendell/oop/raii.h>
+#include <rendell_text/private/GlyphCoverage.h>
 #include <rendell_text/private/IFontRaster.h>
 
 namespace rendell_text {
@@ -16,21 +18,28 @@ public:
     int getFontHeight() const override;
     int getAscender() const override;
     int getDescender() const override;
+    bool hasGlyph(char32_t character) const override;
+    uint32_t getGlyphAdvance(char32_t character) const override;
+    uint64_t getContentHash() const override;
 
     bool loadFont(const std::filesystem::path &fontPath, uint32_t width, uint32_t height) override;
 
-    bool rasterize(wchar_t from, wchar_t to, FontRasterizationResult &result) override;
+    bool rasterize(char32_t from, char32_t to, FontRasterizationResult &result) override;
 
 private:
     bool init();
     void releaseFace();
-    bool rasterizeChar(wchar_t character, FT_Glyph &result);
+    void buildGlyphCoverage();
+    bool rasterizeChar(char32_t character, FT_Glyph &result);
     FT_Glyph rasterizeGlyphStub();
 
     FT_Face _face{nullptr};
+    GlyphCoverage _glyphCoverage{};
     std::filesystem::path _fontPath{};
     uint32_t _width{24};
     uint32_t _height{24};
+    // Computed on the first request, the file is read once more for it.
+    mutable std::optional<uint64_t> _contentHash{};
 };
 
 RENDELL_USE_RAII_FACTORY(FontRaster)
@@ -1,27 +1,108 @@
+#include <bc4.h>
 #include <rendell_text/private/GlyphBuffer.h>
 
 namespace rendell_text {
-GlyphBuffer::GlyphBuffer(wchar_t from, wchar_t to,
-                         FontRasterizationResult &&fontRasterizationResult) {
+GlyphBuffer::GlyphBuffer(char32_t from, char32_t to,
+                         FontRasterizationResult &&fontRasterizationResult, bool blockCompressed)
+    : _blockCompressed(blockCompressed) {
 #ifdef _DEBUG
-    assert(from >= 0);
     assert(from < to);
 #endif
     _range = {from, to};
 
     _fontRasterizationResult = std::move(fontRasterizationResult);
-    _textures = _fontRasterizationResult.texture2DArray;
+}
+
+void GlyphBuffer::upload() {
+    _metricsBuffer.reset();
+    uploadTextures();
+}
+
+void GlyphBuffer::uploadTextures() const {
+    if (_blockCompressed) {
+        uploadBlockCompressed();
+        return;
+    }
+
+    const GlyphBitmapPage &page = _fontRasterizationResult.bitmapPage;
+    const std::vector<RasterizedChar> &rasterizedChars = _fontRasterizationResult.rasterizedChars;
+    _textures = rendell::oop::makeTexture2DArray(page.glyphWidth, page.glyphHeight,
+                                                 page.glyphCount, rendell::TextureFormat::R);
+
+    // The page is already rasterized, so the layers go out back to back without interleaved
+    // FreeType work. Empty glyphs are never sampled and are skipped.
+    for (uint32_t i = 0; i < page.glyphCount; i++) {
+        const glm::ivec2 glyphSize = rasterizedChars[i].glyphSize;
+        if (glyphSize.x > 0 && glyphSize.y > 0) {
+            const uint8_t *glyphPixels = page.getGlyphPixels(i);
+            _textures->setSubData(i, page.glyphWidth, page.glyphHeight,
+                                  reinterpret_cast<const rendell::byte_t *>(glyphPixels));
+        }
+    }
+}
+
+void GlyphBuffer::uploadBlockCompressed() const {
+    // rendell has no compressed texture formats, so a block is stored as two RGBA texels and the
+    // shaders decode it: the endpoints and two index bytes, then the other four index bytes.
+    const GlyphBitmapPage &page = _fontRasterizationResult.bitmapPage;
+    const uint32_t blockColumns = (page.glyphWidth + 3) / 4;
+    const uint32_t blockRows = (page.glyphHeight + 3) / 4;
+    _textures = rendell::oop::makeTexture2DArray(blockColumns * 2, blockRows, page.glyphCount,
+                                                 rendell::TextureFormat::RGBA);
+
+    const std::vector<RasterizedChar> &rasterizedChars = _fontRasterizationResult.rasterizedChars;
+    std::vector<uint8_t> blocks(bc4_encoded_size(page.glyphWidth, page.glyphHeight));
+    for (uint32_t i = 0; i < page.glyphCount; i++) {
+        const glm::ivec2 glyphSize = rasterizedChars[i].glyphSize;
+        if (glyphSize.x > 0 && glyphSize.y > 0) {
+            encode_bc4(page.getGlyphPixels(i), page.glyphWidth, page.glyphHeight, blocks.data());
+            _textures->setSubData(i, blockColumns * 2, blockRows,
+                                  reinterpret_cast<const rendell::byte_t *>(blocks.data()));
+        }
+    }
 }
 
 void GlyphBuffer::use(rendell::UniformSampler2DId uniformSampler2DId, uint32_t textureBlock) const {
+    if (!_textures) {
+        uploadTextures();
+    }
     _textures->use(uniformSampler2DId, textureBlock);
 }
 
-const RasterizedChar &GlyphBuffer::getRasterizedChar(wchar_t character) const {
+void GlyphBuffer::useMetrics(uint32_t metricsBufferBinding) const {
+    if (!_metricsBuffer) {
+        std::vector<glm::vec4> metrics;
+        metrics.reserve(_fontRasterizationResult.rasterizedChars.size());
+        for (const RasterizedChar &rasterizedChar : _fontRasterizationResult.rasterizedChars) {
+            metrics.emplace_back(rasterizedChar.glyphSize, rasterizedChar.glyphBearing);
+        }
+        _metricsBuffer = rendell::oop::makeShaderBuffer(
+            reinterpret_cast<const rendell::byte_t *>(metrics.data()),
+            metrics.size() * sizeof(glm::vec4));
+    }
+    _metricsBuffer->use(metricsBufferBinding);
+}
+
+const GlyphBitmapPage &GlyphBuffer::getBitmapPage() const {
+    return _fontRasterizationResult.bitmapPage;
+}
+
+bool GlyphBuffer::isBlockCompressed() const {
+    return _blockCompressed;
+}
+
+size_t GlyphBuffer::getGpuByteSize() const {
+    const GlyphBitmapPage &page = _fontRasterizationResult.bitmapPage;
+    const size_t layerByteSize = _blockCompressed
+                                     ? bc4_encoded_size(page.glyphWidth, page.glyphHeight)
+                                     : page.getGlyphByteSize();
+    return layerByteSize * page.glyphCount;
+}
+
+const RasterizedChar &GlyphBuffer::getRasterizedChar(char32_t character) const {
     const size_t index = static_cast<size_t>(character - _range.first);
 #ifdef _DEBUG
-    assert(index >= 0);
-    assert(index < _range.second);
+    assert(index < _range.second - _range.first);
 #endif
     return _fontRasterizationResult.rasterizedChars[index];
 }
@@ -30,7 +111,7 @@ const std::vector<RasterizedChar> &GlyphBuffer::getRasterizedChars() const {
     return _fontRasterizationResult.rasterizedChars;
 }
 
-const std::pair<wchar_t, wchar_t> &GlyphBuffer::getRange() const {
+const std::pair<char32_t, char32_t> &GlyphBuffer::getRange() const {
     return _range;
 }
 } // namespace rendell_text
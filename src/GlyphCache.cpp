@@ -0,0 +1,185 @@
+#include <cassert>
+#include <rendell_text/private/GlyphCache.h>
+#include <shared_instance.h>
+
+namespace rendell_text {
+// Runs of up to 128 zeros take one byte with the high bit set. Other bytes go as literal runs
+// of up to 128, led by their length minus one.
+static constexpr size_t MAX_RUN_LENGTH = 128;
+static constexpr uint8_t ZERO_RUN_FLAG = 0x80;
+
+static void encodeRunLength(const std::vector<uint8_t> &src, std::vector<uint8_t> &dst) {
+    size_t i = 0;
+    while (i < src.size()) {
+        size_t length = 0;
+        while (i + length < src.size() && src[i + length] == 0 && length < MAX_RUN_LENGTH) {
+            length++;
+        }
+        if (length > 0) {
+            dst.push_back(static_cast<uint8_t>(ZERO_RUN_FLAG | (length - 1)));
+            i += length;
+            continue;
+        }
+
+        while (i + length < src.size() && src[i + length] != 0 && length < MAX_RUN_LENGTH) {
+            length++;
+        }
+        dst.push_back(static_cast<uint8_t>(length - 1));
+        dst.insert(dst.end(), src.begin() + i, src.begin() + i + length);
+        i += length;
+    }
+}
+
+static void decodeRunLength(const std::vector<uint8_t> &src, std::vector<uint8_t> &dst) {
+    size_t i = 0;
+    while (i < src.size()) {
+        const uint8_t token = src[i++];
+        const size_t length = (token & ~ZERO_RUN_FLAG) + 1;
+        if (token & ZERO_RUN_FLAG) {
+            dst.insert(dst.end(), length, 0);
+        } else {
+            dst.insert(dst.end(), src.begin() + i, src.begin() + i + length);
+            i += length;
+        }
+    }
+}
+
+size_t CompressedGlyphPage::getByteSize() const {
+    return pixels.size() + rasterizedChars.size() * sizeof(RasterizedChar);
+}
+
+std::shared_ptr<GlyphCache> GlyphCache::getShared() {
+    return getSharedInstance<GlyphCache>();
+}
+
+void GlyphCache::setMaxGpuBytes(size_t maxGpuBytes) {
+    _maxGpuBytes = maxGpuBytes;
+    trimGpuTier(_maxGpuBytes);
+}
+
+void GlyphCache::setMaxCompressedBytes(size_t maxCompressedBytes) {
+    _maxCompressedBytes = maxCompressedBytes;
+    trimCompressedTier();
+}
+
+void GlyphCache::trim() {
+    trimGpuTier(0);
+}
+
+GlyphCacheStats GlyphCache::getStats() const {
+    return _stats;
+}
+
+GlyphBufferSharedPtr GlyphCache::find(const RasteredFontStorage *owner, uint32_t rangeIndex) {
+    const Key key{owner, rangeIndex};
+    if (auto it = _gpuPageIndices.find(key); it != _gpuPageIndices.end()) {
+        _gpuPages.splice(_gpuPages.begin(), _gpuPages, it->second);
+        _stats.gpuHitCount++;
+        return it->second->glyphBuffer;
+    }
+    _stats.gpuMissCount++;
+
+    const auto it = _compressedPageIndices.find(key);
+    if (it == _compressedPageIndices.end()) {
+        _stats.compressedMissCount++;
+        return nullptr;
+    }
+    _stats.compressedHitCount++;
+
+    // The page moves back to the GPU tier, it is compressed again on its next eviction.
+    GlyphBufferSharedPtr glyphBuffer = decompressPage(it->second->page);
+    _stats.compressedPageCount--;
+    _stats.compressedBytes -= it->second->page.getByteSize();
+    _compressedPages.erase(it->second);
+    _compressedPageIndices.erase(it);
+    insert(owner, rangeIndex, glyphBuffer);
+    return glyphBuffer;
+}
+
+void GlyphCache::insert(const RasteredFontStorage *owner, uint32_t rangeIndex,
+                        GlyphBufferSharedPtr glyphBuffer) {
+    const Key key{owner, rangeIndex};
+    assert(!_gpuPageIndices.contains(key));
+    const size_t byteSize = glyphBuffer->getGpuByteSize();
+    _gpuPages.push_front({key, std::move(glyphBuffer), byteSize});
+    _gpuPageIndices[key] = _gpuPages.begin();
+    _stats.gpuPageCount++;
+    _stats.gpuBytes += byteSize;
+    trimGpuTier(_maxGpuBytes);
+}
+
+void GlyphCache::erase(const RasteredFontStorage *owner) {
+    for (auto it = _gpuPageIndices.lower_bound({owner, 0});
+         it != _gpuPageIndices.end() && it->first.first == owner;) {
+        _stats.gpuPageCount--;
+        _stats.gpuBytes -= it->second->byteSize;
+        _gpuPages.erase(it->second);
+        it = _gpuPageIndices.erase(it);
+    }
+    for (auto it = _compressedPageIndices.lower_bound({owner, 0});
+         it != _compressedPageIndices.end() && it->first.first == owner;) {
+        _stats.compressedPageCount--;
+        _stats.compressedBytes -= it->second->page.getByteSize();
+        _compressedPages.erase(it->second);
+        it = _compressedPageIndices.erase(it);
+    }
+}
+
+CompressedGlyphPage GlyphCache::compressPage(const GlyphBuffer &glyphBuffer) {
+    const GlyphBitmapPage &bitmapPage = glyphBuffer.getBitmapPage();
+    CompressedGlyphPage result{glyphBuffer.getRange(), bitmapPage.glyphWidth,
+                               bitmapPage.glyphHeight, bitmapPage.glyphCount,
+                               glyphBuffer.getRasterizedChars()};
+    result.blockCompressed = glyphBuffer.isBlockCompressed();
+    encodeRunLength(bitmapPage.pixels, result.pixels);
+    result.pixels.shrink_to_fit();
+    return result;
+}
+
+GlyphBufferSharedPtr GlyphCache::decompressPage(const CompressedGlyphPage &page) {
+    FontRasterizationResult fontRasterizationResult{
+        {page.glyphWidth, page.glyphHeight, page.glyphCount}, page.rasterizedChars};
+    GlyphBitmapPage &bitmapPage = fontRasterizationResult.bitmapPage;
+    bitmapPage.pixels.reserve(bitmapPage.getGlyphByteSize() * bitmapPage.glyphCount);
+    decodeRunLength(page.pixels, bitmapPage.pixels);
+    return makeGlyphBuffer(page.range.first, page.range.second,
+                           std::move(fontRasterizationResult), page.blockCompressed);
+}
+
+void GlyphCache::insertCompressed(const Key &key, CompressedGlyphPage &&page) {
+    _stats.compressedPageCount++;
+    _stats.compressedBytes += page.getByteSize();
+    _compressedPages.push_front({key, std::move(page)});
+    _compressedPageIndices[key] = _compressedPages.begin();
+    trimCompressedTier();
+}
+
+void GlyphCache::trimGpuTier(size_t maxGpuBytes) {
+    // Least recently used pages go first, pages a batch still draws with stay.
+    auto it = _gpuPages.end();
+    while (it != _gpuPages.begin() && _stats.gpuBytes > maxGpuBytes) {
+        it--;
+        if (it->glyphBuffer.use_count() > 1) {
+            continue;
+        }
+
+        if (_maxCompressedBytes > 0) {
+            insertCompressed(it->key, compressPage(*it->glyphBuffer));
+        }
+        _stats.gpuPageCount--;
+        _stats.gpuBytes -= it->byteSize;
+        _gpuPageIndices.erase(it->key);
+        it = _gpuPages.erase(it);
+    }
+}
+
+void GlyphCache::trimCompressedTier() {
+    while (!_compressedPages.empty() && _stats.compressedBytes > _maxCompressedBytes) {
+        const CompressedPage &compressedPage = _compressedPages.back();
+        _stats.compressedPageCount--;
+        _stats.compressedBytes -= compressedPage.page.getByteSize();
+        _compressedPageIndices.erase(compressedPage.key);
+        _compressedPages.pop_back();
+    }
+}
+} // namespace rendell_text
@@ -0,0 +1,88 @@
+#include "RasteredFontStorageManager.h"
+#include <algorithm>
+#include <bc4.h>
+#include <cmath>
+#include <cstdlib>
+#include <logging.h>
+#include <mutex>
+#include <rendell_text/GlyphCompression.h>
+#include <vector>
+
+namespace rendell_text {
+static std::mutex s_blockCompressedFontsMutex;
+
+static std::vector<std::filesystem::path> &getBlockCompressedFonts() {
+    static std::vector<std::filesystem::path> s_blockCompressedFonts;
+    return s_blockCompressedFonts;
+}
+
+void setGlyphBlockCompression(const std::filesystem::path &fontPath, bool enabled) {
+    std::lock_guard lock(s_blockCompressedFontsMutex);
+    std::vector<std::filesystem::path> &fonts = getBlockCompressedFonts();
+    std::erase(fonts, fontPath);
+    if (enabled) {
+        fonts.push_back(fontPath);
+    }
+}
+
+bool isGlyphBlockCompressionEnabled(const std::filesystem::path &fontPath) {
+    std::lock_guard lock(s_blockCompressedFontsMutex);
+    const std::vector<std::filesystem::path> &fonts = getBlockCompressedFonts();
+    return std::find(fonts.begin(), fonts.end(), fontPath) != fonts.end();
+}
+
+bool measureGlyphBlockCompression(const std::filesystem::path &fontPath,
+                                  const glm::ivec2 &fontSize, char32_t from, char32_t to,
+                                  GlyphCompressionReport &report) {
+    report = {};
+    if (from >= to || fontSize.x <= 0 || fontSize.y <= 0) {
+        return false;
+    }
+
+    // The storage picks the raster the layouts would use, embedded fonts included.
+    const RasteredFontStoragePreset preset{fontPath, static_cast<uint32_t>(fontSize.x),
+                                           static_cast<uint32_t>(fontSize.y), CHAR_RANGE_SIZE};
+    const std::shared_ptr<RasteredFontStorageManager> rasteredFontStorageManager =
+        RasteredFontStorageManager::getShared();
+    RasteredFontStorageSharedPtr rasteredFontStorage =
+        rasteredFontStorageManager->getRasteredFontStorage(preset);
+    FontRasterizationResult fontRasterizationResult;
+    const bool rasterized =
+        rasteredFontStorage->getFontRaster()->rasterize(from, to, fontRasterizationResult);
+    rasteredFontStorage.reset();
+    rasteredFontStorageManager->clearUnusedCache();
+    if (!rasterized) {
+        RT_ERROR("Rasterization failure: {{{}, {}}}", static_cast<size_t>(from),
+                 static_cast<size_t>(to));
+        return false;
+    }
+
+    const GlyphBitmapPage &page = fontRasterizationResult.bitmapPage;
+    std::vector<uint8_t> blocks(bc4_encoded_size(page.glyphWidth, page.glyphHeight));
+    std::vector<uint8_t> decodedPixels(page.getGlyphByteSize());
+    uint64_t absoluteErrorSum = 0;
+    uint64_t squaredErrorSum = 0;
+    for (uint32_t i = 0; i < page.glyphCount; i++) {
+        const uint8_t *glyphPixels = page.getGlyphPixels(i);
+        encode_bc4(glyphPixels, page.glyphWidth, page.glyphHeight, blocks.data());
+        decode_bc4(blocks.data(), page.glyphWidth, page.glyphHeight, decodedPixels.data());
+        for (size_t j = 0; j < decodedPixels.size(); j++) {
+            const uint32_t error =
+                static_cast<uint32_t>(std::abs(glyphPixels[j] - decodedPixels[j]));
+            absoluteErrorSum += error;
+            squaredErrorSum += error * error;
+            report.maxError = std::max(report.maxError, error);
+        }
+    }
+
+    const double pixelCount = static_cast<double>(page.getGlyphByteSize() * page.glyphCount);
+    report.glyphCount = page.glyphCount;
+    report.uncompressedBytes = page.getGlyphByteSize() * page.glyphCount;
+    report.compressedBytes = blocks.size() * page.glyphCount;
+    if (pixelCount > 0) {
+        report.meanAbsoluteError = static_cast<double>(absoluteErrorSum) / pixelCount;
+        report.rootMeanSquareError = std::sqrt(static_cast<double>(squaredErrorSum) / pixelCount);
+    }
+    return true;
+}
+} // namespace rendell_text
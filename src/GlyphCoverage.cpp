@@ -0,0 +1,56 @@
+#include <rendell_text/private/GlyphCoverage.h>
+
+#define PAGE_SIZE 256
+#define PAGE_COUNT (0x110000 / PAGE_SIZE)
+
+namespace rendell_text {
+void GlyphCoverage::clear() {
+    _pageIndices.clear();
+    _pages.clear();
+    _count = 0;
+}
+
+void GlyphCoverage::add(char32_t codepoint) {
+    const uint32_t pageIndex = codepoint / PAGE_SIZE;
+    if (pageIndex >= PAGE_COUNT) {
+        return;
+    }
+    if (_pageIndices.empty()) {
+        _pageIndices.resize(PAGE_COUNT, 0);
+    }
+
+    // Page slots are 1-based so that 0 marks an empty page.
+    uint16_t &slot = _pageIndices[pageIndex];
+    if (slot == 0) {
+        _pages.push_back({});
+        slot = static_cast<uint16_t>(_pages.size());
+    }
+
+    const uint32_t bit = codepoint % PAGE_SIZE;
+    uint64_t &word = _pages[slot - 1][bit / 64];
+    const uint64_t mask = uint64_t(1) << (bit % 64);
+    if (!(word & mask)) {
+        word |= mask;
+        _count++;
+    }
+}
+
+bool GlyphCoverage::contains(char32_t codepoint) const {
+    const uint32_t pageIndex = codepoint / PAGE_SIZE;
+    if (pageIndex >= _pageIndices.size()) {
+        return false;
+    }
+
+    const uint16_t slot = _pageIndices[pageIndex];
+    if (slot == 0) {
+        return false;
+    }
+
+    const uint32_t bit = codepoint % PAGE_SIZE;
+    return (_pages[slot - 1][bit / 64] >> (bit % 64)) & 1;
+}
+
+size_t GlyphCoverage::getCount() const {
+    return _count;
+}
+} // namespace rendell_text
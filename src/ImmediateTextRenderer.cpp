@@ -0,0 +1,385 @@
+#include <rendell_text/ImmediateTextRenderer.h>
+
+#include "RasteredFontStorageManager.h"
+#include "RendererUtils.h"
+#include "res_Shaders_TextRenderer_styled_bc4_fs.h"
+#include "res_Shaders_TextRenderer_styled_fs.h"
+#include "res_Shaders_TextRenderer_vs.h"
+#include <hash.h>
+#include <logging.h>
+#include <unicode.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#define TEXTURE_ARRAY_BLOCK 0
+#define TEXT_BUFFER_BINDING 0
+#define GLYPH_TRANSFORM_BUFFER_BINDING 1
+#define STYLE_PALETTE_BUFFER_BINDING 2
+// Enough for a busy overlay frame, the ring grows beyond it when needed.
+#define TEXT_BUFFER_CAPACITY 4096
+
+namespace rendell_text {
+static rendell::oop::VertexAssemblySharedPtr s_vertexAssembly;
+static rendell::oop::ShaderProgramSharedPtr s_shaderProgram;
+static rendell::oop::ShaderProgramSharedPtr s_blockCompressedShaderProgram;
+static std::shared_ptr<RasteredFontStorageManager> s_rasteredFontStorageManager;
+static std::unique_ptr<rendell::oop::Mat4Uniform> s_matrixUniform{nullptr};
+static std::unique_ptr<rendell::oop::Float2Uniform> s_fontSizeUniform{nullptr};
+static std::unique_ptr<rendell::oop::Float4Uniform> s_textColorUniform{nullptr};
+static std::unique_ptr<rendell::oop::Float4Uniform> s_backgroundColorUniform{nullptr};
+static std::unique_ptr<rendell::oop::Int1Uniform> s_charFromUniform{nullptr};
+static std::unique_ptr<rendell::oop::Int1Uniform> s_glyphCountUniform{nullptr};
+static std::unique_ptr<rendell::oop::Int1Uniform> s_instanceBaseUniform{nullptr};
+static std::unique_ptr<rendell::oop::Int1Uniform> s_instanceCapacityUniform{nullptr};
+static std::unique_ptr<rendell::oop::Float2Uniform> s_instanceOriginUniform{nullptr};
+static std::unique_ptr<rendell::oop::Sampler2DUniform> s_texturesUniform{nullptr};
+static uint32_t s_instanceCount{};
+static bool s_initialized = false;
+
+// Every string carries its own style, so only the styled programs are used.
+static const rendell::oop::ShaderProgramSharedPtr &getShaderProgram(bool blockCompressed) {
+    rendell::oop::ShaderProgramSharedPtr &shaderProgram =
+        blockCompressed ? s_blockCompressedShaderProgram : s_shaderProgram;
+    if (!shaderProgram) {
+        shaderProgram = createShaderProgram(res_Shaders_TextRenderer_vs,
+                                            blockCompressed
+                                                ? res_Shaders_TextRenderer_styled_bc4_fs
+                                                : res_Shaders_TextRenderer_styled_fs);
+        assert(shaderProgram);
+    }
+    return shaderProgram;
+}
+
+static bool initStaticRendererStuff() {
+    s_rasteredFontStorageManager = RasteredFontStorageManager::getShared();
+
+    s_vertexAssembly = createVertexAssembly();
+    assert(s_vertexAssembly);
+
+    s_matrixUniform = std::make_unique<rendell::oop::Mat4Uniform>("u_Matrix");
+    s_fontSizeUniform = std::make_unique<rendell::oop::Float2Uniform>("u_FontSize");
+    s_textColorUniform = std::make_unique<rendell::oop::Float4Uniform>("u_TextColor");
+    s_backgroundColorUniform = std::make_unique<rendell::oop::Float4Uniform>("u_BackgroundColor");
+    s_charFromUniform = std::make_unique<rendell::oop::Int1Uniform>("u_CharFrom");
+    s_glyphCountUniform = std::make_unique<rendell::oop::Int1Uniform>("u_GlyphCount");
+    s_instanceBaseUniform = std::make_unique<rendell::oop::Int1Uniform>("u_InstanceBase");
+    s_instanceCapacityUniform = std::make_unique<rendell::oop::Int1Uniform>("u_InstanceCapacity");
+    s_instanceOriginUniform = std::make_unique<rendell::oop::Float2Uniform>("u_InstanceOrigin");
+    s_texturesUniform = std::make_unique<rendell::oop::Sampler2DUniform>("u_Textures");
+
+    return true;
+}
+
+static void releaseStaticRendererStuff() {
+    s_vertexAssembly.reset();
+    s_shaderProgram.reset();
+    s_blockCompressedShaderProgram.reset();
+    s_rasteredFontStorageManager.reset();
+    s_matrixUniform.reset();
+    s_fontSizeUniform.reset();
+    s_textColorUniform.reset();
+    s_backgroundColorUniform.reset();
+    s_charFromUniform.reset();
+    s_glyphCountUniform.reset();
+    s_instanceBaseUniform.reset();
+    s_instanceCapacityUniform.reset();
+    s_instanceOriginUniform.reset();
+    s_texturesUniform.reset();
+
+    s_initialized = false;
+}
+
+ImmediateTextRenderer::ImmediateTextRenderer() {
+    s_instanceCount++;
+    init();
+    _stylePalette.resize(1);
+    _textBuffer = std::make_unique<TextBuffer>(TEXT_BUFFER_CAPACITY);
+}
+
+ImmediateTextRenderer::~ImmediateTextRenderer() {
+    _pages.clear();
+    _fontEntries.clear();
+    s_rasteredFontStorageManager->clearUnusedCache();
+
+    s_instanceCount--;
+    if (s_instanceCount == 0) {
+        releaseStaticRendererStuff();
+    }
+}
+
+bool ImmediateTextRenderer::isInitialized() const {
+    return s_initialized;
+}
+
+void ImmediateTextRenderer::setMatrix(const glm::mat4 &matrix) {
+    _matrix = matrix;
+}
+
+void ImmediateTextRenderer::setFont(const std::filesystem::path &fontPath,
+                                    const glm::ivec2 &fontSize) {
+    if (_currentFontIndex < _fontEntries.size() &&
+        _fontEntries[_currentFontIndex].fontSize == fontSize &&
+        _fontEntries[_currentFontIndex].fontPath == fontPath) {
+        return;
+    }
+
+    auto it = std::find_if(_fontEntries.begin(), _fontEntries.end(), [&](const FontEntry &entry) {
+        return entry.fontSize == fontSize && entry.fontPath == fontPath;
+    });
+    if (it == _fontEntries.end()) {
+        const RasteredFontStoragePreset preset{fontPath, static_cast<uint32_t>(fontSize.x),
+                                               static_cast<uint32_t>(fontSize.y),
+                                               CHAR_RANGE_SIZE};
+        FontEntry fontEntry{fontPath, fontSize,
+                            s_rasteredFontStorageManager->getRasteredFontStorage(preset)};
+        const IFontRasterSharedPtr fontRaster = fontEntry.rasteredFontStorage->getFontRaster();
+        if (fontRaster->isInitialized()) {
+            fontEntry.ascender = static_cast<float>(fontRaster->getAscender());
+            fontEntry.descender = static_cast<float>(fontRaster->getDescender());
+        }
+        it = _fontEntries.insert(_fontEntries.end(), std::move(fontEntry));
+    }
+    _currentFontIndex = static_cast<size_t>(it - _fontEntries.begin());
+}
+
+void ImmediateTextRenderer::drawText(const glm::vec2 &position, std::wstring_view text,
+                                     const TextStyle &style) {
+    if (_currentFontIndex >= _fontEntries.size()) {
+        RT_WARNING("No font is set for immediate text");
+        return;
+    }
+    if (text.empty()) {
+        return;
+    }
+
+    const uint32_t styleIndex = getStyleIndex(style);
+    const FontEntry &fontEntry = _fontEntries[_currentFontIndex];
+    const float decorationThickness = std::max(1.0f, std::round(fontEntry.fontSize.y / 16.0f));
+    _stringCount++;
+
+    // The same instances TextLayout shapes for a styled character.
+    glm::vec2 pen = position;
+    size_t i = 0;
+    while (i < text.length()) {
+        const char32_t character = next_codepoint(text, i);
+        if (character == '\n') {
+            pen = glm::vec2(position.x, pen.y + static_cast<float>(fontEntry.fontSize.y));
+            continue;
+        }
+
+        PageInstances *page = getPageInstances(fontEntry, character);
+        if (!page) {
+            continue;
+        }
+        const RasterizedChar &rasterizedChar = page->glyphBuffer->getRasterizedChar(character);
+        const float advance = static_cast<float>(rasterizedChar.glyphAdvance >> 6);
+        const auto addInstance = [&](uint32_t packedCharacter, const glm::vec4 &transform) {
+            page->packedCharacters.push_back(packedCharacter);
+            page->transforms.push_back(transform);
+        };
+
+        if (style.backgroundColor.a > 0.0f) {
+            addInstance(packRectInstance(RectKind::Background, styleIndex),
+                        glm::vec4(pen.x, pen.y + fontEntry.descender, advance,
+                                  fontEntry.ascender - fontEntry.descender));
+        }
+        if (character != ' ' && character != '\t') {
+            const glm::vec2 glyphOffset =
+                pen + glm::vec2(rasterizedChar.glyphBearing.x,
+                                rasterizedChar.glyphBearing.y - rasterizedChar.glyphSize.y);
+            addInstance(packGlyphInstance(character, styleIndex),
+                        glm::vec4(glyphOffset, rasterizedChar.glyphSize.x,
+                                  rasterizedChar.glyphSize.y));
+        }
+        if (style.underline) {
+            addInstance(packRectInstance(RectKind::Foreground, styleIndex),
+                        glm::vec4(pen.x, pen.y - 2.0f * decorationThickness, advance,
+                                  decorationThickness));
+        }
+        if (style.strikethrough) {
+            addInstance(packRectInstance(RectKind::Foreground, styleIndex),
+                        glm::vec4(pen.x, pen.y + fontEntry.ascender * 0.3f, advance,
+                                  decorationThickness));
+        }
+        pen.x += advance;
+    }
+}
+
+void ImmediateTextRenderer::flush() {
+    _stats = {};
+    _stats.stringCount = _stringCount;
+    _stringCount = 0;
+    releaseUnusedPages();
+    if (_pages.empty()) {
+        clearStylePalette();
+        return;
+    }
+
+    // Two vec4 per style, matching the stylePalette buffer in TextRenderer.fs.
+    _stylePaletteData.clear();
+    for (const TextStyle &style : _stylePalette) {
+        _stylePaletteData.push_back(style.color);
+        _stylePaletteData.push_back(style.backgroundColor);
+    }
+    const size_t stylePaletteSize = _stylePaletteData.size() * sizeof(glm::vec4);
+    const rendell::byte_t *stylePaletteData =
+        reinterpret_cast<const rendell::byte_t *>(_stylePaletteData.data());
+    if (!_stylePaletteBuffer || _stylePaletteBuffer.getSize() < stylePaletteSize) {
+        _stylePaletteBuffer = ShaderBufferPool::getShared()->acquire(
+            stylePaletteSize, stylePaletteData, stylePaletteSize);
+    } else {
+        _stylePaletteBuffer->setSubData(stylePaletteData, stylePaletteSize);
+    }
+
+    // All pages share one ring, each draw starts at the first instance of its page.
+    _pageStarts.clear();
+    _textBuffer->beginUpdating();
+    for (const PageInstances &page : _pages) {
+        _pageStarts.push_back(_textBuffer->getCurrentLength());
+        _textBuffer->appendInstances(page.packedCharacters.data(), page.transforms.data(),
+                                     page.packedCharacters.size());
+    }
+    _textBuffer->endUpdating();
+
+    for (size_t i = 0; i < _pages.size(); i++) {
+        PageInstances &page = _pages[i];
+        const GlyphBitmapPage &bitmapPage = page.glyphBuffer->getBitmapPage();
+        const size_t instanceCount = page.packedCharacters.size();
+        getShaderProgram(page.glyphBuffer->isBlockCompressed())->use();
+        s_vertexAssembly->use();
+        page.glyphBuffer->use(s_texturesUniform->getId(), TEXTURE_ARRAY_BLOCK);
+        _textBuffer->use(TEXT_BUFFER_BINDING, GLYPH_TRANSFORM_BUFFER_BINDING);
+        _stylePaletteBuffer->use(STYLE_PALETTE_BUFFER_BINDING);
+        s_matrixUniform->set(glm::value_ptr(_matrix));
+        s_textColorUniform->set(0.0f, 0.0f, 0.0f, 0.0f);
+        s_backgroundColorUniform->set(0.0f, 0.0f, 0.0f, 0.0f);
+        s_fontSizeUniform->set(static_cast<float>(bitmapPage.glyphWidth),
+                               static_cast<float>(bitmapPage.glyphHeight));
+        s_charFromUniform->set(static_cast<int>(page.glyphBuffer->getRange().first));
+        s_glyphCountUniform->set(static_cast<int>(instanceCount));
+        s_instanceBaseUniform->set(static_cast<int>(_textBuffer->getBase() + _pageStarts[i]));
+        s_instanceCapacityUniform->set(static_cast<int>(_textBuffer->getCapacity()));
+        s_instanceOriginUniform->set(0.0f, 0.0f);
+        rendell::setDrawType(rendell::DrawMode::ArraysInstanced,
+                             rendell::PrimitiveTopology::TriangleStrip,
+                             static_cast<uint32_t>(instanceCount));
+        rendell::submit();
+
+        // The vectors keep their capacity for the next frame.
+        page.packedCharacters.clear();
+        page.transforms.clear();
+    }
+
+    _stats.instanceCount = _textBuffer->getCurrentLength();
+    _stats.drawCount = _pages.size();
+    clearStylePalette();
+}
+
+const ImmediateTextStats &ImmediateTextRenderer::getStats() const {
+    return _stats;
+}
+
+bool ImmediateTextRenderer::init() {
+    if (!s_initialized) {
+        s_initialized = initStaticRendererStuff();
+    }
+
+    return s_initialized;
+}
+
+ImmediateTextRenderer::PageInstances *
+ImmediateTextRenderer::getPageInstances(const FontEntry &fontEntry, char32_t character) {
+    const RasteredFontStorage *rasteredFontStorage = fontEntry.rasteredFontStorage.get();
+    const uint32_t rangeIndex = rasteredFontStorage->getRangeIndex(character);
+    // Strings mostly stay within one page, the map is only searched when the page changes.
+    if (rasteredFontStorage == _lastPageStorage && rangeIndex == _lastPageRangeIndex) {
+        return &_pages[_lastPageIndex];
+    }
+
+    size_t pageIndex = 0;
+    auto it = _pageIndices.find({rasteredFontStorage, rangeIndex});
+    if (it != _pageIndices.end()) {
+        pageIndex = it->second;
+    } else {
+        GlyphBufferSharedPtr glyphBuffer =
+            fontEntry.rasteredFontStorage->rasterizeGlyphRange(rangeIndex);
+        if (!glyphBuffer) {
+            RT_ERROR("Failed to rasterize the glyph page of U+{:04X}",
+                     static_cast<uint32_t>(character));
+            return nullptr;
+        }
+        pageIndex = _pages.size();
+        _pages.push_back({rasteredFontStorage, rangeIndex, std::move(glyphBuffer)});
+        _pageIndices[{rasteredFontStorage, rangeIndex}] = pageIndex;
+    }
+
+    _lastPageStorage = rasteredFontStorage;
+    _lastPageRangeIndex = rangeIndex;
+    _lastPageIndex = pageIndex;
+    return &_pages[pageIndex];
+}
+
+uint32_t ImmediateTextRenderer::getStyleIndex(const TextStyle &style) {
+    // Consecutive strings mostly share their style.
+    if (_lastStyleIndex != 0 && _stylePalette[_lastStyleIndex] == style) {
+        return static_cast<uint32_t>(_lastStyleIndex);
+    }
+
+    const auto it = _styleIndices.find(style);
+    if (it != _styleIndices.end()) {
+        _lastStyleIndex = it->second;
+        return it->second;
+    }
+
+    if (_stylePalette.size() > MAX_INSTANCE_STYLE_INDEX) {
+        flush();
+    }
+    const uint32_t styleIndex = static_cast<uint32_t>(_stylePalette.size());
+    _stylePalette.push_back(style);
+    if (_spareStyleNodes.empty()) {
+        _styleIndices.emplace(style, styleIndex);
+    } else {
+        StyleIndices::node_type node = std::move(_spareStyleNodes.back());
+        _spareStyleNodes.pop_back();
+        node.key() = style;
+        node.mapped() = styleIndex;
+        _styleIndices.insert(std::move(node));
+    }
+    _lastStyleIndex = styleIndex;
+    return styleIndex;
+}
+
+void ImmediateTextRenderer::clearStylePalette() {
+    _stylePalette.resize(1);
+    while (!_styleIndices.empty()) {
+        _spareStyleNodes.push_back(_styleIndices.extract(_styleIndices.begin()));
+    }
+    _lastStyleIndex = 0;
+}
+
+size_t ImmediateTextRenderer::StyleHash::operator()(const TextStyle &style) const {
+    // Field by field, the padding after the flags is not part of the style.
+    uint64_t result = hash_bytes(&style.color, sizeof(style.color));
+    result = hash_bytes(&style.backgroundColor, sizeof(style.backgroundColor), result);
+    const uint8_t flags = (style.underline ? 1 : 0) | (style.strikethrough ? 2 : 0);
+    return static_cast<size_t>(hash_bytes(&flags, sizeof(flags), result));
+}
+
+void ImmediateTextRenderer::releaseUnusedPages() {
+    const size_t pageCount = _pages.size();
+    std::erase_if(_pages, [](const PageInstances &page) { return page.packedCharacters.empty(); });
+    if (_pages.size() == pageCount) {
+        return;
+    }
+
+    _pageIndices.clear();
+    for (size_t i = 0; i < _pages.size(); i++) {
+        _pageIndices[{_pages[i].rasteredFontStorage, _pages[i].rangeIndex}] = i;
+    }
+    _lastPageStorage = nullptr;
+}
+} // namespace rendell_text
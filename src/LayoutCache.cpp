@@ -0,0 +1,83 @@
+#include "LayoutCache.h"
+#include <algorithm>
+#include <cassert>
+
+// Spare nodes kept for reuse, enough for the layouts edited in a frame.
+#define MAX_SPARE_NODE_COUNT 64
+
+namespace rendell_text {
+std::shared_ptr<LayoutState> LayoutCache::find(const LayoutKey &key) {
+    const auto [begin, end] = _entries.equal_range(hashKey(key));
+    for (auto it = begin; it != end; it++) {
+        std::shared_ptr<LayoutState> layoutState = it->second.lock();
+        if (layoutState && layoutState->key == key) {
+            return layoutState;
+        }
+    }
+    return nullptr;
+}
+
+void LayoutCache::insert(const std::shared_ptr<LayoutState> &layoutState) {
+    assert(!layoutState->cached);
+    if (_spareNodes.empty()) {
+        _entries.emplace(hashKey(layoutState->key), layoutState);
+    } else {
+        Entries::node_type node = std::move(_spareNodes.back());
+        _spareNodes.pop_back();
+        node.key() = hashKey(layoutState->key);
+        node.mapped() = layoutState;
+        _entries.insert(std::move(node));
+    }
+    layoutState->cached = true;
+
+    // Expired entries are swept whenever the map has doubled since the last sweep.
+    if (_entries.size() >= 2 * std::max<size_t>(_sizeAfterCleanup, 64)) {
+        eraseExpired();
+    }
+}
+
+void LayoutCache::erase(LayoutState &layoutState) {
+    if (!layoutState.cached) {
+        return;
+    }
+
+    const auto [begin, end] = _entries.equal_range(hashKey(layoutState.key));
+    for (auto it = begin; it != end; it++) {
+        if (it->second.lock().get() == &layoutState) {
+            if (_spareNodes.size() < MAX_SPARE_NODE_COUNT) {
+                // A weak reference to a state made by make_shared would pin its memory.
+                Entries::node_type &node = _spareNodes.emplace_back(_entries.extract(it));
+                node.mapped().reset();
+            } else {
+                _entries.erase(it);
+            }
+            break;
+        }
+    }
+    layoutState.cached = false;
+}
+
+size_t LayoutCache::getSize() const {
+    return _entries.size();
+}
+
+size_t LayoutCache::hashKey(const LayoutKey &key) {
+    size_t result = std::hash<std::wstring>{}(key.text);
+    const auto combine = [&](size_t value) {
+        result ^= value + 0x9e3779b97f4a7c15ull + (result << 6) + (result >> 2);
+    };
+    for (const std::filesystem::path &fontPath : key.fontPaths) {
+        combine(std::filesystem::hash_value(fontPath));
+    }
+    combine(std::hash<int>{}(key.fontSize.x));
+    combine(std::hash<int>{}(key.fontSize.y));
+    combine(std::hash<float>{}(key.wrapWidth));
+    combine(static_cast<size_t>(key.wrapMode));
+    return result;
+}
+
+void LayoutCache::eraseExpired() {
+    std::erase_if(_entries, [](const auto &entry) { return entry.second.expired(); });
+    _sizeAfterCleanup = _entries.size();
+}
+} // namespace rendell_text
@@ -0,0 +1,128 @@
+#pragma once
+#include <rendell_text/TextLayout.h>
+#include <rendell_text/private/RasteredFontStorage.h>
+#include <rendell_text/private/TextBatch.h>
+
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rendell_text {
+struct LayoutInstance {
+    uint32_t textBatchIndex{};
+    uint32_t packedCharacter{};
+    glm::vec4 transform{};
+};
+
+struct LayoutLine {
+    float baseline{};
+    float ascender{};
+    float descender{};
+};
+
+// A run of text between '\n's shaped on a single unwrapped line: pens start at x = 0 and the
+// baseline is at y = 0. Wrapping and placement only offset the instances, so neither a new
+// wrap width nor edits in other paragraphs shape it again.
+struct LayoutParagraph {
+    // In units, without the terminating '\n'.
+    size_t length{};
+    std::vector<LayoutInstance> instances{};
+    // The paragraph unit each instance was emitted for, non-decreasing.
+    std::vector<uint32_t> instanceCharacters{};
+    // Pen position after every unit.
+    std::vector<float> penPositions{};
+    size_t missingGlyphCount{};
+    float ascender{};
+    float descender{};
+    float lineHeight{};
+
+    // Starts of the wrapped lines relative to the paragraph, valid for the wrap settings below.
+    std::vector<size_t> lineStarts{0};
+    float wrapWidth{-1.0f};
+    WrapMode wrapMode{WrapMode::None};
+};
+
+// Identifies the result of laying out plain text: no styles, no font runs.
+struct LayoutKey {
+    std::wstring text{};
+    // The layout font followed by the fallback fonts.
+    std::vector<std::filesystem::path> fontPaths{};
+    glm::ivec2 fontSize{};
+    float wrapWidth{};
+    WrapMode wrapMode{WrapMode::None};
+
+    bool operator==(const LayoutKey &other) const = default;
+};
+
+// Everything a layout pass produces, GPU batches included. A state found in the LayoutCache is
+// shared by every layout with the same key and is only written to while it has a single owner.
+struct LayoutState {
+    size_t textLength{};
+    std::vector<LayoutParagraph> paragraphs{};
+    std::vector<size_t> paragraphStarts{};
+    // Index of the first line of every paragraph in lines.
+    std::vector<size_t> paragraphFirstLines{};
+
+    std::vector<LayoutLine> lines{};
+    std::vector<uint32_t> textAdvance{};
+    std::vector<size_t> lineStarts{0};
+    // Added to the instance positions on the GPU, it grows as the scrollback drops lines.
+    glm::vec2 instanceOrigin{};
+    // The paragraphs whose instances are in the batches, all of them unless the layout has
+    // visible lines.
+    size_t filledParagraphsFrom{};
+    size_t filledParagraphsTo{std::numeric_limits<size_t>::max()};
+
+    std::map<std::pair<const RasteredFontStorage *, uint32_t>, uint32_t> textBatchIndices{};
+    std::vector<TextBatchSharedPtr> textBatches{};
+    // The batches holding instances, in the order their first instance was appended.
+    std::vector<TextBatchSharedPtr> textBatchesForRendering{};
+    // Per batch in textBatches, whether it is in textBatchesForRendering.
+    std::vector<bool> textBatchesRendered{};
+    bool uploadPending{};
+
+    LayoutKey key{};
+    bool cached{};
+
+    // Scratch of the layout passes. Paragraphs that are shaped again hand their buffers over to
+    // the new ones, so a pass that produces as much as the last one allocates nothing.
+    std::vector<LayoutParagraph> spareParagraphs{};
+    std::vector<LayoutParagraph> shapedParagraphs{};
+    std::vector<size_t> shapedParagraphStarts{};
+    std::vector<size_t> instanceCounts{};
+};
+
+// Content-addressed index of the layout states alive in the process. Entries do not own their
+// states, the layouts do, so a state leaves the cache with its last layout.
+class LayoutCache final {
+public:
+    // Longer texts are documents rather than labels and are never shared.
+    static constexpr size_t MAX_TEXT_LENGTH = 256;
+
+    LayoutCache() = default;
+    ~LayoutCache() = default;
+
+    std::shared_ptr<LayoutState> find(const LayoutKey &key);
+    void insert(const std::shared_ptr<LayoutState> &layoutState);
+    void erase(LayoutState &layoutState);
+
+    size_t getSize() const;
+
+private:
+    using Entries = std::unordered_multimap<size_t, std::weak_ptr<LayoutState>>;
+
+    static size_t hashKey(const LayoutKey &key);
+    void eraseExpired();
+
+    Entries _entries{};
+    // Nodes of erased entries, reused by insert: a layout edited every frame leaves and enters
+    // the cache on every pass.
+    std::vector<Entries::node_type> _spareNodes{};
+    size_t _sizeAfterCleanup{};
+};
+} // namespace rendell_text
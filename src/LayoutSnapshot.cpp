@@ -0,0 +1,279 @@
+#include "LayoutSnapshot.h"
+#include <cstring>
+#include <hash.h>
+#include <type_traits>
+
+namespace rendell_text {
+static constexpr uint32_t LAYOUT_SNAPSHOT_MAGIC = 0x534C5452; // "RTLS"
+static constexpr uint32_t LAYOUT_SNAPSHOT_VERSION = 2;
+// Catches snapshots of builds with another memory layout of the stored structures.
+static constexpr uint32_t LAYOUT_SNAPSHOT_NATIVE_LAYOUT =
+    (sizeof(size_t) << 16) | (sizeof(LayoutInstance) << 8) | sizeof(LayoutLine);
+// The checksum follows magic, version and native layout, and covers every byte after it.
+static constexpr size_t LAYOUT_SNAPSHOT_CHECKSUM_OFFSET = 3 * sizeof(uint32_t);
+static constexpr size_t LAYOUT_SNAPSHOT_PAYLOAD_OFFSET =
+    LAYOUT_SNAPSHOT_CHECKSUM_OFFSET + sizeof(uint64_t);
+
+class SnapshotWriter final {
+public:
+    template <typename T> void write(const T &value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        append(&value, sizeof(T));
+    }
+
+    template <typename T> void writeArray(const std::vector<T> &values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        write<uint64_t>(values.size());
+        append(values.data(), values.size() * sizeof(T));
+    }
+
+    void append(const void *data, size_t size) {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        _data.insert(_data.end(), bytes, bytes + size);
+    }
+
+    std::vector<uint8_t> &getData() { return _data; }
+
+private:
+    std::vector<uint8_t> _data{};
+};
+
+class SnapshotReader final {
+public:
+    SnapshotReader(std::span<const uint8_t> data) : _data(data) {}
+
+    template <typename T> bool read(T &value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        return readBytes(&value, sizeof(T));
+    }
+
+    // The count is checked against the remaining bytes before anything is allocated.
+    template <typename T> bool readArray(std::vector<T> &values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        uint64_t count{};
+        if (!read(count) || count > getRemainingSize() / sizeof(T)) {
+            return false;
+        }
+        values.resize(count);
+        return readBytes(values.data(), count * sizeof(T));
+    }
+
+    bool readBytes(void *data, size_t size) {
+        if (size > getRemainingSize()) {
+            return false;
+        }
+        if (size > 0) {
+            std::memcpy(data, _data.data() + _offset, size);
+        }
+        _offset += size;
+        return true;
+    }
+
+    size_t getRemainingSize() const { return _data.size() - _offset; }
+
+private:
+    std::span<const uint8_t> _data;
+    size_t _offset{};
+};
+
+static void writeKey(SnapshotWriter &writer, const LayoutSnapshotKey &key) {
+    writer.write(LAYOUT_SNAPSHOT_MAGIC);
+    writer.write(LAYOUT_SNAPSHOT_VERSION);
+    writer.write(LAYOUT_SNAPSHOT_NATIVE_LAYOUT);
+    // Filled in once the whole snapshot is written.
+    writer.write<uint64_t>(0);
+    writer.write(key.textLength);
+    writer.write(key.textHash);
+    writer.writeArray(key.fontHashes);
+    writer.write(key.fontSize.x);
+    writer.write(key.fontSize.y);
+    writer.write(key.wrapWidth);
+    writer.write(static_cast<uint32_t>(key.wrapMode));
+}
+
+static bool readWrapMode(SnapshotReader &reader, WrapMode &wrapMode) {
+    uint32_t value{};
+    if (!reader.read(value) || value > static_cast<uint32_t>(WrapMode::Character)) {
+        return false;
+    }
+    wrapMode = static_cast<WrapMode>(value);
+    return true;
+}
+
+static bool readKey(SnapshotReader &reader, LayoutSnapshotKey &key) {
+    uint32_t magic{};
+    uint32_t version{};
+    uint32_t nativeLayout{};
+    uint64_t checksum{};
+    if (!reader.read(magic) || !reader.read(version) || !reader.read(nativeLayout) ||
+        !reader.read(checksum)) {
+        return false;
+    }
+    if (magic != LAYOUT_SNAPSHOT_MAGIC || version != LAYOUT_SNAPSHOT_VERSION ||
+        nativeLayout != LAYOUT_SNAPSHOT_NATIVE_LAYOUT) {
+        return false;
+    }
+    return reader.read(key.textLength) && reader.read(key.textHash) &&
+           reader.readArray(key.fontHashes) && reader.read(key.fontSize.x) &&
+           reader.read(key.fontSize.y) && reader.read(key.wrapWidth) &&
+           readWrapMode(reader, key.wrapMode);
+}
+
+// The offsets and lengths in a snapshot are only checked for fitting the arrays they index, so a
+// corrupted snapshot must be rejected as a whole before it is read.
+static bool hasValidChecksum(std::span<const uint8_t> snapshot) {
+    uint64_t checksum{};
+    if (snapshot.size() < LAYOUT_SNAPSHOT_PAYLOAD_OFFSET) {
+        return false;
+    }
+    std::memcpy(&checksum, snapshot.data() + LAYOUT_SNAPSHOT_CHECKSUM_OFFSET, sizeof(checksum));
+    return checksum == hash_bytes(snapshot.data() + LAYOUT_SNAPSHOT_PAYLOAD_OFFSET,
+                                  snapshot.size() - LAYOUT_SNAPSHOT_PAYLOAD_OFFSET);
+}
+
+static void writeParagraph(SnapshotWriter &writer, const LayoutParagraph &paragraph) {
+    writer.write<uint64_t>(paragraph.length);
+    writer.write<uint64_t>(paragraph.missingGlyphCount);
+    writer.write(paragraph.ascender);
+    writer.write(paragraph.descender);
+    writer.write(paragraph.lineHeight);
+    writer.write(paragraph.wrapWidth);
+    writer.write(static_cast<uint32_t>(paragraph.wrapMode));
+    writer.writeArray(paragraph.instances);
+    writer.writeArray(paragraph.instanceCharacters);
+    writer.writeArray(paragraph.penPositions);
+    writer.writeArray(paragraph.lineStarts);
+}
+
+static bool readParagraph(SnapshotReader &reader, LayoutParagraph &paragraph) {
+    uint64_t length{};
+    uint64_t missingGlyphCount{};
+    if (!reader.read(length) || !reader.read(missingGlyphCount) ||
+        !reader.read(paragraph.ascender) || !reader.read(paragraph.descender) ||
+        !reader.read(paragraph.lineHeight) || !reader.read(paragraph.wrapWidth) ||
+        !readWrapMode(reader, paragraph.wrapMode) || !reader.readArray(paragraph.instances) ||
+        !reader.readArray(paragraph.instanceCharacters) ||
+        !reader.readArray(paragraph.penPositions) || !reader.readArray(paragraph.lineStarts)) {
+        return false;
+    }
+    paragraph.length = static_cast<size_t>(length);
+    paragraph.missingGlyphCount = static_cast<size_t>(missingGlyphCount);
+    return paragraph.penPositions.size() == paragraph.length &&
+           paragraph.instanceCharacters.size() == paragraph.instances.size() &&
+           !paragraph.lineStarts.empty();
+}
+
+std::vector<uint8_t> writeLayoutSnapshot(const LayoutSnapshotKey &key,
+                                         const LayoutState &layoutState,
+                                         const std::vector<LayoutSnapshotBatch> &batches) {
+    SnapshotWriter writer;
+    writeKey(writer, key);
+
+    writer.write(layoutState.instanceOrigin.x);
+    writer.write(layoutState.instanceOrigin.y);
+    writer.writeArray(layoutState.paragraphStarts);
+    writer.writeArray(layoutState.paragraphFirstLines);
+    writer.write<uint64_t>(layoutState.paragraphs.size());
+    for (const LayoutParagraph &paragraph : layoutState.paragraphs) {
+        writeParagraph(writer, paragraph);
+    }
+    writer.writeArray(layoutState.lines);
+    writer.writeArray(layoutState.lineStarts);
+    writer.writeArray(layoutState.textAdvance);
+
+    // The instance arrays are stored as the batches hold them, loading copies them back.
+    std::vector<uint32_t> packedCharacters;
+    std::vector<glm::vec4> transforms;
+    writer.write<uint64_t>(batches.size());
+    for (size_t i = 0; i < batches.size(); i++) {
+        const TextBatchSharedPtr &textBatch = layoutState.textBatches[i];
+        const TextBuffer &textBuffer = textBatch->getTextBuffer();
+        packedCharacters.resize(textBuffer.getCurrentLength());
+        transforms.resize(textBuffer.getCurrentLength());
+        textBuffer.copyInstances(packedCharacters.data(), transforms.data());
+
+        writer.write(batches[i]);
+        writer.write<uint8_t>(i < layoutState.textBatchesRendered.size() &&
+                              layoutState.textBatchesRendered[i]);
+        writer.writeArray(packedCharacters);
+        writer.writeArray(transforms);
+    }
+
+    std::vector<uint8_t> &data = writer.getData();
+    const uint64_t checksum = hash_bytes(data.data() + LAYOUT_SNAPSHOT_PAYLOAD_OFFSET,
+                                         data.size() - LAYOUT_SNAPSHOT_PAYLOAD_OFFSET);
+    std::memcpy(data.data() + LAYOUT_SNAPSHOT_CHECKSUM_OFFSET, &checksum, sizeof(checksum));
+    return std::move(data);
+}
+
+bool readLayoutSnapshotKey(std::span<const uint8_t> snapshot, LayoutSnapshotKey &key) {
+    SnapshotReader reader(snapshot);
+    return readKey(reader, key);
+}
+
+bool readLayoutSnapshot(
+    std::span<const uint8_t> snapshot, LayoutState &layoutState,
+    const std::function<uint32_t(const LayoutSnapshotBatch &)> &createTextBatch) {
+    SnapshotReader reader(snapshot);
+    LayoutSnapshotKey key;
+    if (!readKey(reader, key) || !hasValidChecksum(snapshot)) {
+        return false;
+    }
+
+    uint64_t paragraphCount{};
+    if (!reader.read(layoutState.instanceOrigin.x) || !reader.read(layoutState.instanceOrigin.y) ||
+        !reader.readArray(layoutState.paragraphStarts) ||
+        !reader.readArray(layoutState.paragraphFirstLines) || !reader.read(paragraphCount) ||
+        paragraphCount != layoutState.paragraphStarts.size() ||
+        paragraphCount != layoutState.paragraphFirstLines.size()) {
+        return false;
+    }
+    layoutState.paragraphs.resize(static_cast<size_t>(paragraphCount));
+    for (LayoutParagraph &paragraph : layoutState.paragraphs) {
+        if (!readParagraph(reader, paragraph)) {
+            return false;
+        }
+    }
+    if (!reader.readArray(layoutState.lines) || !reader.readArray(layoutState.lineStarts) ||
+        !reader.readArray(layoutState.textAdvance) || layoutState.lineStarts.empty() ||
+        layoutState.textAdvance.size() != key.textLength) {
+        return false;
+    }
+    layoutState.textLength = static_cast<size_t>(key.textLength);
+
+    uint64_t batchCount{};
+    if (!reader.read(batchCount)) {
+        return false;
+    }
+    std::vector<uint32_t> packedCharacters;
+    std::vector<glm::vec4> transforms;
+    for (uint64_t i = 0; i < batchCount; i++) {
+        LayoutSnapshotBatch batch;
+        uint8_t rendered{};
+        if (!reader.read(batch) || !reader.read(rendered) ||
+            !reader.readArray(packedCharacters) || !reader.readArray(transforms) ||
+            packedCharacters.size() != transforms.size() || createTextBatch(batch) != i) {
+            return false;
+        }
+
+        const TextBatchSharedPtr &textBatch = layoutState.textBatches[i];
+        textBatch->beginUpdating();
+        textBatch->appendInstances(packedCharacters.data(), transforms.data(),
+                                   packedCharacters.size());
+        layoutState.textBatchesRendered.push_back(rendered != 0);
+        if (rendered) {
+            layoutState.textBatchesForRendering.push_back(textBatch);
+        }
+    }
+    layoutState.uploadPending = true;
+
+    for (const LayoutParagraph &paragraph : layoutState.paragraphs) {
+        for (const LayoutInstance &layoutInstance : paragraph.instances) {
+            if (layoutInstance.textBatchIndex >= batchCount) {
+                return false;
+            }
+        }
+    }
+    return reader.getRemainingSize() == 0;
+}
+} // namespace rendell_text
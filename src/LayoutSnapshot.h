@@ -0,0 +1,47 @@
+#pragma once
+#include "LayoutCache.h"
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace rendell_text {
+// What a snapshot was laid out for. Fonts are identified by their content, so a snapshot still
+// loads after the font file moved but not after it changed.
+struct LayoutSnapshotKey {
+    uint64_t textLength{};
+    uint64_t textHash{};
+    // The layout font followed by the fallback fonts.
+    std::vector<uint64_t> fontHashes{};
+    glm::ivec2 fontSize{};
+    float wrapWidth{};
+    WrapMode wrapMode{WrapMode::None};
+
+    bool operator==(const LayoutSnapshotKey &other) const = default;
+};
+
+// The glyph page a batch draws from: the font's index in the key and the character range.
+struct LayoutSnapshotBatch {
+    uint32_t fontIndex{};
+    uint32_t rangeIndex{};
+};
+
+// Snapshots hold the finished layout state in the native byte order and float format: they load
+// on the platform that wrote them. Arrays are stored as they are in memory and read back with a
+// single copy each.
+std::vector<uint8_t> writeLayoutSnapshot(const LayoutSnapshotKey &key,
+                                         const LayoutState &layoutState,
+                                         const std::vector<LayoutSnapshotBatch> &batches);
+
+// Reads the header only, so a mismatching snapshot is rejected before anything is allocated. The
+// checksum of the payload is not verified here but by readLayoutSnapshot.
+bool readLayoutSnapshotKey(std::span<const uint8_t> snapshot, LayoutSnapshotKey &key);
+
+// Fills an empty state, unless the payload does not match the checksum. createTextBatch makes
+// the batch of the glyph page in the state and returns its index, the batches must come out in
+// the order they were written.
+bool readLayoutSnapshot(
+    std::span<const uint8_t> snapshot, LayoutState &layoutState,
+    const std::function<uint32_t(const LayoutSnapshotBatch &)> &createTextBatch);
+} // namespace rendell_text
@@ -0,0 +1,204 @@
+#include <cstring>
+#include <logging.h>
+#include <rendell_text/MappedTextSource.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rendell_text {
+// The view outlives the handles it was created from on both platforms, so nothing but the
+// address and the size is kept.
+static const char8_t *mapFile(const std::filesystem::path &filePath, size_t &size) {
+#ifdef _WIN32
+    const HANDLE file =
+        CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    LARGE_INTEGER fileSize{};
+    const char8_t *result = nullptr;
+    if (GetFileSizeEx(file, &fileSize)) {
+        size = static_cast<size_t>(fileSize.QuadPart);
+        if (size == 0) {
+            // Empty files cannot be mapped, an empty text needs no memory anyway.
+            result = u8"";
+        } else if (const HANDLE mapping =
+                       CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr)) {
+            result = static_cast<const char8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+    return result;
+#else
+    const int file = ::open(filePath.c_str(), O_RDONLY);
+    if (file < 0) {
+        return nullptr;
+    }
+
+    struct stat fileStat {};
+    const char8_t *result = nullptr;
+    if (fstat(file, &fileStat) == 0) {
+        size = static_cast<size_t>(fileStat.st_size);
+        if (size == 0) {
+            // Empty files cannot be mapped, an empty text needs no memory anyway.
+            result = u8"";
+        } else {
+            void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+            result = data == MAP_FAILED ? nullptr : static_cast<const char8_t *>(data);
+        }
+    }
+    ::close(file);
+    return result;
+#endif
+}
+
+static void unmapFile(const char8_t *data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#else
+    munmap(const_cast<char8_t *>(data), size);
+#endif
+}
+
+MappedTextSource::MappedTextSource() = default;
+
+MappedTextSource::~MappedTextSource() {
+    close();
+}
+
+bool MappedTextSource::open(const std::filesystem::path &filePath) {
+    close();
+
+    size_t size = 0;
+    const char8_t *data = mapFile(filePath, size);
+    if (!data) {
+        RT_ERROR("Failed to map {}", filePath.string());
+        return false;
+    }
+
+    _filePath = filePath;
+    _data = data;
+    _size = size;
+    _lineIndex.assign(1, 0);
+    _lineCount = 1;
+    _indexComplete = false;
+    _stopIndexing = false;
+    _indexThread = std::thread(&MappedTextSource::buildLineIndex, this);
+    return true;
+}
+
+void MappedTextSource::close() {
+    if (!_data) {
+        return;
+    }
+
+    _stopIndexing = true;
+    if (_indexThread.joinable()) {
+        _indexThread.join();
+    }
+    unmapFile(_data, _size);
+
+    _filePath.clear();
+    _data = nullptr;
+    _size = 0;
+    _lineIndex.clear();
+    _lineCount = 0;
+    _indexComplete = false;
+}
+
+bool MappedTextSource::isOpen() const {
+    return _data != nullptr;
+}
+
+const std::filesystem::path &MappedTextSource::getFilePath() const {
+    return _filePath;
+}
+
+size_t MappedTextSource::getSize() const {
+    return _size;
+}
+
+bool MappedTextSource::isIndexComplete() const {
+    return _indexComplete;
+}
+
+size_t MappedTextSource::getLineCount() const {
+    return _lineCount;
+}
+
+size_t MappedTextSource::getLineOffset(size_t lineIndex) const {
+    if (!_data) {
+        return 0;
+    }
+
+    size_t offset = 0;
+    size_t indexedLine = 0;
+    {
+        const std::lock_guard lock(_lineIndexMutex);
+        const size_t entry = std::min(lineIndex / LINE_INDEX_STRIDE, _lineIndex.size() - 1);
+        offset = _lineIndex[entry];
+        indexedLine = entry * LINE_INDEX_STRIDE;
+    }
+
+    offset = skipLines(offset, lineIndex - indexedLine);
+    return offset == std::string_view::npos ? _size : offset;
+}
+
+std::u8string_view MappedTextSource::getLines(size_t firstLine, size_t lineCount) const {
+    if (!_data || lineCount == 0) {
+        return {};
+    }
+
+    const size_t from = getLineOffset(firstLine);
+    const size_t next = skipLines(from, lineCount);
+    // The '\n' ending the last line is not part of the window.
+    const size_t to = next == std::string_view::npos ? _size : next - 1;
+    return std::u8string_view(_data + from, to - from);
+}
+
+void MappedTextSource::buildLineIndex() {
+    size_t offset = 0;
+    size_t lineCount = 1;
+    while (!_stopIndexing) {
+        const void *lineEnd = std::memchr(_data + offset, '\n', _size - offset);
+        if (!lineEnd) {
+            _lineCount = lineCount;
+            _indexComplete = true;
+            return;
+        }
+
+        offset = static_cast<size_t>(static_cast<const char8_t *>(lineEnd) - _data) + 1;
+        if (lineCount++ % LINE_INDEX_STRIDE == 0) {
+            const std::lock_guard lock(_lineIndexMutex);
+            _lineIndex.push_back(offset);
+            _lineCount = lineCount;
+        }
+    }
+}
+
+size_t MappedTextSource::skipLines(size_t offset, size_t lineCount) const {
+    for (size_t i = 0; i < lineCount; i++) {
+        const void *lineEnd = offset < _size ? std::memchr(_data + offset, '\n', _size - offset)
+                                             : nullptr;
+        if (!lineEnd) {
+            return std::string_view::npos;
+        }
+        offset = static_cast<size_t>(static_cast<const char8_t *>(lineEnd) - _data) + 1;
+    }
+    return offset;
+}
+} // namespace rendell_text
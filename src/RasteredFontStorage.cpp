@@ -2,26 +2,43 @@
 #include <rendell_text/private/RasteredFontStorage.h>
 
 namespace rendell_text {
-RasteredFontStorage::RasteredFontStorage(IFontRasterSharedPtr fontRaster, wchar_t charRangeSize)
+RasteredFontStorage::RasteredFontStorage(IFontRasterSharedPtr fontRaster, uint32_t charRangeSize,
+                                         bool blockCompressed)
     : _fontRaster(fontRaster)
-    , _charRangeSize(charRangeSize) {
+    , _charRangeSize(charRangeSize)
+    , _blockCompressed(blockCompressed)
+    , _glyphCache(GlyphCache::getShared()) {
+}
+
+RasteredFontStorage::~RasteredFontStorage() {
+    _glyphCache->erase(this);
 }
 
 void RasteredFontStorage::clearCache() {
-    _cachedGlyphBuffers.clear();
+    _glyphCache->erase(this);
 }
 
-GlyphBufferSharedPtr RasteredFontStorage::rasterizeGlyphRange(wchar_t rangeIndex) {
-    if (auto it = _cachedGlyphBuffers.find(rangeIndex); it != _cachedGlyphBuffers.end()) {
-        return it->second;
+GlyphBufferSharedPtr RasteredFontStorage::rasterizeGlyphRange(uint32_t rangeIndex) {
+    if (GlyphBufferSharedPtr glyphBuffer = _glyphCache->find(this, rangeIndex)) {
+        return glyphBuffer;
     }
 
     GlyphBufferSharedPtr glyphBufferPtr = createGlyphBuffer(rangeIndex);
-    _cachedGlyphBuffers[rangeIndex] = glyphBufferPtr;
+    if (glyphBufferPtr) {
+        _glyphCache->insert(this, rangeIndex, glyphBufferPtr);
+    }
     return glyphBufferPtr;
 }
 
-wchar_t RasteredFontStorage::getRangeIndex(wchar_t character) const {
+uint32_t RasteredFontStorage::getGlyphAdvance(char32_t character) {
+    auto [it, inserted] = _cachedGlyphAdvances.try_emplace(character);
+    if (inserted) {
+        it->second = _fontRaster->getGlyphAdvance(character);
+    }
+    return it->second;
+}
+
+uint32_t RasteredFontStorage::getRangeIndex(char32_t character) const {
     return character / _charRangeSize;
 }
 
@@ -33,13 +50,17 @@ uint32_t RasteredFontStorage::getFontHeight() const {
     return _fontHeight;
 }
 
+bool RasteredFontStorage::isBlockCompressed() const {
+    return _blockCompressed;
+}
+
 const IFontRasterSharedPtr RasteredFontStorage::getFontRaster() const {
     return _fontRaster;
 }
 
-GlyphBufferSharedPtr RasteredFontStorage::createGlyphBuffer(wchar_t rangeIndex) {
-    const wchar_t from = rangeIndex * _charRangeSize;
-    const wchar_t to = (rangeIndex + 1) * _charRangeSize;
+GlyphBufferSharedPtr RasteredFontStorage::createGlyphBuffer(uint32_t rangeIndex) {
+    const char32_t from = rangeIndex * _charRangeSize;
+    const char32_t to = (rangeIndex + 1) * _charRangeSize;
     FontRasterizationResult fontRasterizationResult;
     if (!_fontRaster->rasterize(from, to, fontRasterizationResult)) {
         RT_ERROR("Rasterization failure: {{{}, {}}}", static_cast<size_t>(from),
@@ -47,6 +68,6 @@ GlyphBufferSharedPtr RasteredFontStorage::createGlyphBuffer(wchar_t rangeIndex)
         return nullptr;
     }
 
-    return makeGlyphBuffer(from, to, std::move(fontRasterizationResult));
+    return makeGlyphBuffer(from, to, std::move(fontRasterizationResult), _blockCompressed);
 }
 } // namespace rendell_text
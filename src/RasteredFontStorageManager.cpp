@@ -1,8 +1,15 @@
 #include "RasteredFontStorageManager.h"
+#include "EmbeddedFontRaster.h"
 #include "FontRaster.h"
+#include <rendell_text/GlyphCompression.h>
 #include <algorithm>
+#include <shared_instance.h>
 
 namespace rendell_text {
+std::shared_ptr<RasteredFontStorageManager> RasteredFontStorageManager::getShared() {
+    return getSharedInstance<RasteredFontStorageManager>();
+}
+
 void RasteredFontStorageManager::clearUnusedCache() {
     // This is a lazy cache clearing algorithm.
     std::vector<size_t> releasedKeys;
@@ -25,17 +32,27 @@ RasteredFontStorageManager::getRasteredFontStorage(const RasteredFontStoragePres
         return it->second;
     }
 
-    FontRasterSharedPtr fontRaster =
-        makeFontRaster(preset.fontPath, preset.fontWidth, preset.fontHeight);
-    RasteredFontStorageSharedPtr rasteredFontStorage =
-        makeRasteredFontStorage(fontRaster, preset.charRangeSize);
+    IFontRasterSharedPtr fontRaster = createFontRaster(preset);
+    RasteredFontStorageSharedPtr rasteredFontStorage = makeRasteredFontStorage(
+        fontRaster, preset.charRangeSize, isGlyphBlockCompressionEnabled(preset.fontPath));
     _rasteredFontStorages[key] = rasteredFontStorage;
     return rasteredFontStorage;
 }
 
+IFontRasterSharedPtr
+RasteredFontStorageManager::createFontRaster(const RasteredFontStoragePreset &preset) const {
+    // Fonts baked into the binary take precedence, so embedded builds never touch FreeType.
+    if (findEmbeddedFont(preset.fontPath, preset.fontWidth, preset.fontHeight)) {
+        return makeEmbeddedFontRaster(preset.fontPath, preset.fontWidth, preset.fontHeight);
+    }
+    return makeFontRaster(preset.fontPath, preset.fontWidth, preset.fontHeight);
+}
+
 size_t RasteredFontStorageManager::hashFontPreset(const RasteredFontStoragePreset &preset) const {
     std::hash<std::string> hasher;
+    // Storages made before the compression setting of their font changed are not reused.
     return hasher(preset.fontPath.string() + std::to_string(preset.fontWidth) +
-                  std::to_string(preset.fontHeight));
+                  std::to_string(preset.fontHeight) +
+                  (isGlyphBlockCompressionEnabled(preset.fontPath) ? "bc4" : ""));
 }
 } // namespace rendell_text
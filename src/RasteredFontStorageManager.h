@@ -1,14 +1,18 @@
 #pragma once
 #include <filesystem>
 #include <map>
+#include <memory>
 #include <rendell_text/private/RasteredFontStorage.h>
 
 namespace rendell_text {
+// Storages are shared by preset, so every user must split the codepoints into the same ranges.
+inline constexpr uint32_t CHAR_RANGE_SIZE = 200;
+
 struct RasteredFontStoragePreset {
     std::filesystem::path fontPath{};
     uint32_t fontWidth{};
     uint32_t fontHeight{};
-    wchar_t charRangeSize{};
+    uint32_t charRangeSize{};
 };
 
 class RasteredFontStorageManager {
@@ -16,11 +20,15 @@ public:
     RasteredFontStorageManager() = default;
     ~RasteredFontStorageManager() = default;
 
+    // The manager shared by layouts and grids.
+    static std::shared_ptr<RasteredFontStorageManager> getShared();
+
     void clearUnusedCache();
 
     RasteredFontStorageSharedPtr getRasteredFontStorage(const RasteredFontStoragePreset &preset);
 
 private:
+    IFontRasterSharedPtr createFontRaster(const RasteredFontStoragePreset &preset) const;
     size_t hashFontPreset(const RasteredFontStoragePreset &preset) const;
 
     std::map<size_t, RasteredFontStorageSharedPtr> _rasteredFontStorages{};
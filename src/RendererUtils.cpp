@@ -0,0 +1,60 @@
+#include "RendererUtils.h"
+#include <logging.h>
+
+namespace rendell_text {
+rendell::oop::VertexAssemblySharedPtr createVertexAssembly() {
+    static std::vector<float> vertexPos{
+        0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f,
+    };
+    static std::vector<uint32_t> indices{0, 0, 0, 0};
+
+    auto indexBuffer = rendell::oop::makeIndexBuffer(indices.data(), indices.size());
+    auto vertexBuffer = rendell::oop::makeVertexBuffer(vertexPos.data(), vertexPos.size());
+    auto vertexLayout =
+        rendell::VertexLayout().addAttribute(0, rendell::ShaderDataType::float2, false, 0);
+    auto vertexAssembly = rendell::oop::makeVertexAssembly(indexBuffer, std::vector{vertexBuffer},
+                                                           std::vector{vertexLayout});
+    return vertexAssembly;
+}
+
+rendell::oop::ShaderProgramSharedPtr createShaderProgram(const std::string &vertexSrc,
+                                                         const std::string &fragmentSrc) {
+    auto vertexShader =
+        rendell::oop::makeVertexShader(vertexSrc, [](bool success, const std::string &infoLog) {
+            if (!infoLog.empty()) {
+                if (success) {
+                    RT_WARNING("Vertex shader compilation warning:\n{}", infoLog);
+                } else {
+                    RT_CRITICAL("Vertex shader compilation error:\n{}", infoLog);
+                }
+            }
+            assert(success);
+        });
+
+    auto fragmentShader =
+        rendell::oop::makeFragmentShader(fragmentSrc, [](bool success, const std::string &infoLog) {
+            if (!infoLog.empty()) {
+                if (success) {
+                    RT_WARNING("Fragment shader compilation warning:\n{}", infoLog);
+                } else {
+                    RT_CRITICAL("Fragment shader compilation error:\n{}", infoLog);
+                }
+            }
+            assert(success);
+        });
+
+    auto program = rendell::oop::makeShaderProgram(
+        vertexShader, fragmentShader, [](bool success, const std::string &infoLog) {
+            if (!infoLog.empty()) {
+                if (success) {
+                    RT_WARNING("Shader program linking warning:\n{}", infoLog);
+                } else {
+                    RT_CRITICAL("Shader program linking error:\n{}", infoLog);
+                }
+            }
+            assert(success);
+        });
+
+    return program;
+}
+} // namespace rendell_text
@@ -0,0 +1,13 @@
+#pragma once
+#include <rendell/oop/rendell_oop.h>
+#include <rendell/rendell.h>
+
+#include <string>
+
+namespace rendell_text {
+// A unit quad drawn as a triangle strip, shared by every instanced text draw.
+rendell::oop::VertexAssemblySharedPtr createVertexAssembly();
+
+rendell::oop::ShaderProgramSharedPtr createShaderProgram(const std::string &vertexSrc,
+                                                         const std::string &fragmentSrc);
+} // namespace rendell_text
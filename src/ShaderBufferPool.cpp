@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <utility>
+#include <rendell_text/private/ShaderBufferPool.h>
+#include <shared_instance.h>
+
+namespace rendell_text {
+// rendell creates buffers from data covering them, the ones without data of their own share
+// this block of zeros. It grows to the largest size class created.
+static const rendell::byte_t *getZeroBlock(size_t size) {
+    static std::vector<rendell::byte_t> s_zeroBlock;
+    if (s_zeroBlock.size() < size) {
+        s_zeroBlock.resize(size);
+    }
+    return s_zeroBlock.data();
+}
+
+PooledShaderBuffer::PooledShaderBuffer(std::shared_ptr<ShaderBufferPool> pool,
+                                       rendell::oop::ShaderBufferSharedPtr shaderBuffer,
+                                       size_t size)
+    : _pool(std::move(pool))
+    , _shaderBuffer(std::move(shaderBuffer))
+    , _size(size) {
+}
+
+PooledShaderBuffer::PooledShaderBuffer(PooledShaderBuffer &&other) noexcept
+    : _pool(std::move(other._pool))
+    , _shaderBuffer(std::move(other._shaderBuffer))
+    , _size(std::exchange(other._size, 0)) {
+}
+
+PooledShaderBuffer &PooledShaderBuffer::operator=(PooledShaderBuffer &&other) noexcept {
+    if (this != &other) {
+        reset();
+        _pool = std::move(other._pool);
+        _shaderBuffer = std::move(other._shaderBuffer);
+        _size = std::exchange(other._size, 0);
+    }
+    return *this;
+}
+
+PooledShaderBuffer::~PooledShaderBuffer() {
+    reset();
+}
+
+void PooledShaderBuffer::reset() {
+    if (_pool && _shaderBuffer) {
+        _pool->release(std::move(_shaderBuffer), _size);
+    }
+    _pool.reset();
+    _shaderBuffer.reset();
+    _size = 0;
+}
+
+rendell::oop::ShaderBuffer *PooledShaderBuffer::operator->() const {
+    return _shaderBuffer.get();
+}
+
+PooledShaderBuffer::operator bool() const {
+    return _shaderBuffer != nullptr;
+}
+
+size_t PooledShaderBuffer::getSize() const {
+    return _size;
+}
+
+std::shared_ptr<ShaderBufferPool> ShaderBufferPool::getShared() {
+    return getSharedInstance<ShaderBufferPool>();
+}
+
+size_t ShaderBufferPool::getSizeClass(size_t size) {
+    return std::bit_ceil(std::max(size, MIN_SIZE_CLASS));
+}
+
+PooledShaderBuffer ShaderBufferPool::acquire(size_t size, const rendell::byte_t *data,
+                                             size_t dataSize) {
+    const size_t sizeClass = getSizeClass(size);
+    assert(dataSize <= sizeClass);
+    rendell::oop::ShaderBufferSharedPtr shaderBuffer;
+
+    auto it = _freeBuffers.find(sizeClass);
+    if (it != _freeBuffers.end() && !it->second.empty()) {
+        shaderBuffer = std::move(it->second.back());
+        it->second.pop_back();
+        _stats.freeBufferCount--;
+        _stats.freeBytes -= sizeClass;
+        _stats.reusedBufferCount++;
+        if (dataSize > 0) {
+            shaderBuffer->setSubData(data, dataSize);
+        }
+    } else if (dataSize == sizeClass) {
+        shaderBuffer = rendell::oop::makeShaderBuffer(data, sizeClass);
+        _stats.createdBufferCount++;
+    } else {
+        shaderBuffer = rendell::oop::makeShaderBuffer(getZeroBlock(sizeClass), sizeClass);
+        if (dataSize > 0) {
+            shaderBuffer->setSubData(data, dataSize);
+        }
+        _stats.createdBufferCount++;
+    }
+
+    _stats.usedBufferCount++;
+    _stats.usedBytes += sizeClass;
+    return PooledShaderBuffer(shared_from_this(), std::move(shaderBuffer), sizeClass);
+}
+
+void ShaderBufferPool::setMaxFreeBytes(size_t maxFreeBytes) {
+    _maxFreeBytes = maxFreeBytes;
+    trimToBudget();
+}
+
+void ShaderBufferPool::trim() {
+    _freeBuffers.clear();
+    _stats.freeBufferCount = 0;
+    _stats.freeBytes = 0;
+}
+
+ShaderBufferPoolStats ShaderBufferPool::getStats() const {
+    return _stats;
+}
+
+void ShaderBufferPool::release(rendell::oop::ShaderBufferSharedPtr shaderBuffer, size_t size) {
+    _stats.usedBufferCount--;
+    _stats.usedBytes -= size;
+
+    _freeBuffers[size].push_back(std::move(shaderBuffer));
+    _stats.freeBufferCount++;
+    _stats.freeBytes += size;
+    trimToBudget();
+}
+
+void ShaderBufferPool::trimToBudget() {
+    // The largest buffers go first: they are the rarest to be asked for again.
+    for (auto it = _freeBuffers.rbegin();
+         it != _freeBuffers.rend() && _stats.freeBytes > _maxFreeBytes; it++) {
+        std::vector<rendell::oop::ShaderBufferSharedPtr> &shaderBuffers = it->second;
+        while (!shaderBuffers.empty() && _stats.freeBytes > _maxFreeBytes) {
+            shaderBuffers.pop_back();
+            _stats.freeBufferCount--;
+            _stats.freeBytes -= it->first;
+        }
+    }
+}
+} // namespace rendell_text
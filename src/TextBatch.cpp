@@ -1,46 +1,50 @@
 #include <rendell_text/private/TextBatch.h>
 
 namespace rendell_text {
-TextBatch::TextBatch(GlyphBufferSharedPtr glyphBuffer, size_t textBufferSize) {
+TextBatch::TextBatch(GlyphBufferSharedPtr glyphBuffer, size_t textBufferCapacity) {
     _glyphBuffer = glyphBuffer;
-    _textBufferSize = textBufferSize;
-
-    _textBuffers.push_back(std::make_unique<TextBuffer>(textBufferSize));
+    _textBuffer = std::make_unique<TextBuffer>(textBufferCapacity);
 }
 
 void TextBatch::beginUpdating() {
-    _counter = 0;
-    for (std::unique_ptr<TextBuffer> &textBuffer : _textBuffers) {
-        textBuffer->beginUpdating();
-    }
+    _textBuffer->beginUpdating();
 }
 
-void TextBatch::appendCharacter(wchar_t character, glm::vec2 offset) {
-    TextBuffer *textBuffer = _textBuffers[_counter].get();
-
-    if (textBuffer->isFull()) {
-        _counter++;
-        textBuffer = new TextBuffer(_textBufferSize);
-        _textBuffers.push_back(std::unique_ptr<TextBuffer>(textBuffer));
-    }
-
+void TextBatch::appendCharacter(char32_t character, glm::vec2 offset, uint32_t styleIndex) {
     const RasterizedChar &rasterizedChar = _glyphBuffer->getRasterizedChar(character);
-    glm::vec4 glyphTransform(offset, rasterizedChar.glyphSize.x, rasterizedChar.glyphSize.y);
-    textBuffer->appendCharacter(rasterizedChar, offset);
+    _textBuffer->appendCharacter(rasterizedChar, offset, styleIndex);
+}
+
+void TextBatch::appendRect(const glm::vec4 &rect, RectKind rectKind, uint32_t styleIndex) {
+    _textBuffer->appendRect(rect, rectKind, styleIndex);
 }
 
 void TextBatch::endUpdating() {
-    _textBuffers.resize(_counter + 1);
-    for (std::unique_ptr<TextBuffer> &textBuffer : _textBuffers) {
-        textBuffer->endUpdating();
-    }
+    _textBuffer->endUpdating();
+}
+
+void TextBatch::appendInstance(uint32_t packedCharacter, const glm::vec4 &transform) {
+    _textBuffer->appendInstance(packedCharacter, transform);
+}
+
+void TextBatch::appendInstances(const uint32_t *packedCharacters, const glm::vec4 *transforms,
+                                size_t count) {
+    _textBuffer->appendInstances(packedCharacters, transforms, count);
+}
+
+void TextBatch::eraseFirstInstances(size_t count) {
+    _textBuffer->eraseFirstInstances(count);
+}
+
+void TextBatch::eraseLastInstances(size_t count) {
+    _textBuffer->eraseLastInstances(count);
 }
 
 const GlyphBuffer *TextBatch::getGlyphBuffer() const {
     return _glyphBuffer.get();
 }
 
-const std::vector<TextBufferUniquePtr> &TextBatch::getTextBuffers() const {
-    return _textBuffers;
+const TextBuffer &TextBatch::getTextBuffer() const {
+    return *_textBuffer;
 }
 } // namespace rendell_text
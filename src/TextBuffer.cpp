@@ -1,66 +1,119 @@
 #include <algorithm>
+#include <cstring>
 #include <glm/gtc/matrix_transform.hpp>
 #include <rendell_text/private/TextBatch.h>
 
 namespace rendell_text {
-TextBuffer::TextBuffer(size_t length)
-    : _length(length) {
-    _textBufferData.resize(_length);
-    _transformBufferData.resize(_length);
-
-    // TODO: Right now rendell requires that the data is not null.
-    const std::vector<rendell::byte_t> textEmptyData(_length * sizeof(uint32_t));
-    const std::vector<rendell::byte_t> transformEmptyData(_length * sizeof(glm::mat4));
-    _textBuffer = rendell::oop::makeShaderBuffer(textEmptyData.data(), _length * sizeof(uint32_t));
-    _transformBuffer =
-        rendell::oop::makeShaderBuffer(transformEmptyData.data(), _length * sizeof(glm::mat4));
+TextBuffer::TextBuffer(size_t capacity) : _minCapacity(getRingCapacity(capacity)) {
+    _capacity = _minCapacity;
+    _textBufferData.resize(_capacity);
+    _transformBufferData.resize(_capacity);
+    // The GPU side is borrowed from the pool on the first upload.
+    _shaderBufferPool = ShaderBufferPool::getShared();
 }
 
 void TextBuffer::beginUpdating() {
+    // The slots keep their content, so refilled instances equal to the old ones are not uploaded
+    // again. Pending slots can not be followed to the new base, the whole ring goes then.
+    if (_base != 0 && _uploadFrom < _uploadTo) {
+        _uploadFrom = 0;
+        _uploadTo = _capacity;
+    }
+    _base = 0;
     _counter = 0;
 }
 
-void TextBuffer::appendCharacter(const RasterizedChar &rasterizedChar, glm::vec2 offset) {
-    _textBufferData[_counter] = static_cast<uint32_t>(rasterizedChar.character);
-    _transformBufferData[_counter] =
-        glm::vec4(offset, rasterizedChar.glyphSize.x, rasterizedChar.glyphSize.y);
-    _counter++;
+void TextBuffer::appendCharacter(const RasterizedChar &rasterizedChar, glm::vec2 offset,
+                                 uint32_t styleIndex) {
+    appendInstance(packGlyphInstance(rasterizedChar.character, styleIndex),
+                   glm::vec4(offset, rasterizedChar.glyphSize.x, rasterizedChar.glyphSize.y));
+}
+
+void TextBuffer::appendRect(const glm::vec4 &rect, RectKind rectKind, uint32_t styleIndex) {
+    appendInstance(packRectInstance(rectKind, styleIndex), rect);
+}
+
+void TextBuffer::appendInstance(uint32_t packedCharacter, const glm::vec4 &transform) {
+    if (_counter == _capacity) {
+        resize(_capacity * 2);
+    }
+    const size_t index = _counter++;
+    const size_t ringIndex = getRingIndex(index);
+    if (ringIndex >= _mirroredSize || _textBufferData[ringIndex] != packedCharacter ||
+        _transformBufferData[ringIndex] != transform) {
+        _textBufferData[ringIndex] = packedCharacter;
+        _transformBufferData[ringIndex] = transform;
+        markChanged(index, index + 1);
+    }
+}
+
+void TextBuffer::appendInstances(const uint32_t *packedCharacters, const glm::vec4 *transforms,
+                                 size_t count) {
+    if (count == 0) {
+        return;
+    }
+    if (_counter + count > _capacity) {
+        resize(getRingCapacity(_counter + count));
+    }
+    // At most two copies: up to the end of the ring and on from its start.
+    const size_t ringIndex = getRingIndex(_counter);
+    const size_t headCount = std::min(count, _capacity - ringIndex);
+    std::memcpy(_textBufferData.data() + ringIndex, packedCharacters,
+                headCount * sizeof(uint32_t));
+    std::memcpy(_transformBufferData.data() + ringIndex, transforms,
+                headCount * sizeof(glm::vec4));
+    std::memcpy(_textBufferData.data(), packedCharacters + headCount,
+                (count - headCount) * sizeof(uint32_t));
+    std::memcpy(_transformBufferData.data(), transforms + headCount,
+                (count - headCount) * sizeof(glm::vec4));
+    markChanged(_counter, _counter + count);
+    _counter += count;
 }
 
 void TextBuffer::insertCharacter(const RasterizedChar &rasterizedChar, glm::vec2 offset,
                                  size_t index) {
-    _textBufferData[index] = static_cast<uint32_t>(rasterizedChar.character);
-    _transformBufferData[index] =
+    const size_t ringIndex = getRingIndex(index);
+    _textBufferData[ringIndex] = static_cast<uint32_t>(rasterizedChar.character);
+    _transformBufferData[ringIndex] =
         glm::vec4(offset, rasterizedChar.glyphSize.x, rasterizedChar.glyphSize.y);
+    markChanged(index, index + 1);
 }
 
-void TextBuffer::endUpdating() {
-    if (_counter == 0) {
+void TextBuffer::eraseFirstInstances(size_t count) {
+    assert(count <= _counter);
+    _base = getRingIndex(count);
+    _counter -= count;
+    if (_uploadFrom >= _uploadTo) {
         return;
     }
-    _textBuffer->setSubData(reinterpret_cast<const rendell::byte_t *>(_textBufferData.data()),
-                            _counter * sizeof(uint32_t));
-    _transformBuffer->setSubData(
-        reinterpret_cast<const rendell::byte_t *>(_transformBufferData.data()),
-        _counter * sizeof(glm::vec4));
-}
-
-void TextBuffer::updateBufferSubData(size_t from, size_t to) {
-#ifdef _DEBUG
-    assert(from > 0);
-    assert(from < to);
-#endif
-    const size_t count = to - from;
+    if (_uploadFrom < count) {
+        // Pending slots of the dropped instances wrap around to the end of the ring.
+        _uploadFrom = 0;
+        _uploadTo = _capacity;
+    } else {
+        _uploadFrom -= count;
+        _uploadTo -= count;
+    }
+}
 
-    _textBuffer->setSubData(reinterpret_cast<const rendell::byte_t *>(_textBufferData.data()),
-                            count * sizeof(uint32_t), from);
-    _transformBuffer->setSubData(
-        reinterpret_cast<const rendell::byte_t *>(_transformBufferData.data()),
-        count * sizeof(glm::mat4), from);
+void TextBuffer::eraseLastInstances(size_t count) {
+    assert(count <= _counter);
+    _counter -= count;
 }
 
-bool TextBuffer::isFull() const {
-    return _counter >= _length;
+void TextBuffer::endUpdating() {
+    if (_counter * 4 < _capacity && _capacity > _minCapacity) {
+        // Shrinking only below a quarter of the capacity leaves room to grow back for free.
+        resize(std::max(getRingCapacity(_counter * 2), _minCapacity));
+    }
+    if (_reallocatePending) {
+        reallocate();
+        upload(0, _counter);
+    } else {
+        upload(_uploadFrom, _uploadTo);
+    }
+    _uploadFrom = 0;
+    _uploadTo = 0;
 }
 
 void TextBuffer::use(uint32_t textBufferBinding, uint32_t transformBufferBinding) const {
@@ -68,11 +121,92 @@ void TextBuffer::use(uint32_t textBufferBinding, uint32_t transformBufferBinding
     _transformBuffer->use(transformBufferBinding);
 }
 
-size_t TextBuffer::getLength() const {
-    return _length;
+size_t TextBuffer::getCapacity() const {
+    return _capacity;
 }
 
 size_t TextBuffer::getCurrentLength() const {
     return _counter;
 }
+
+size_t TextBuffer::getBase() const {
+    return _base;
+}
+
+void TextBuffer::copyInstances(uint32_t *packedCharacters, glm::vec4 *transforms) const {
+    const size_t headCount = std::min(_counter, _capacity - _base);
+    std::copy_n(_textBufferData.begin() + _base, headCount, packedCharacters);
+    std::copy_n(_transformBufferData.begin() + _base, headCount, transforms);
+    std::copy_n(_textBufferData.begin(), _counter - headCount, packedCharacters + headCount);
+    std::copy_n(_transformBufferData.begin(), _counter - headCount, transforms + headCount);
+}
+
+size_t TextBuffer::getRingCapacity(size_t count) {
+    // Both buffers land exactly on a size class, so nothing of the pooled memory goes unused.
+    return ShaderBufferPool::getSizeClass(count * sizeof(uint32_t)) / sizeof(uint32_t);
+}
+
+size_t TextBuffer::getRingIndex(size_t index) const {
+    return (_base + index) % _capacity;
+}
+
+void TextBuffer::markChanged(size_t from, size_t to) {
+    if (_uploadFrom < _uploadTo) {
+        _uploadFrom = std::min(_uploadFrom, from);
+        _uploadTo = std::max(_uploadTo, to);
+    } else {
+        _uploadFrom = from;
+        _uploadTo = to;
+    }
+}
+
+void TextBuffer::resize(size_t capacity) {
+    // The ring is unrolled so the instances keep their order with the new capacity.
+    std::rotate(_textBufferData.begin(), _textBufferData.begin() + _base, _textBufferData.end());
+    std::rotate(_transformBufferData.begin(), _transformBufferData.begin() + _base,
+                _transformBufferData.end());
+    _base = 0;
+    _capacity = capacity;
+    _textBufferData.resize(_capacity);
+    _transformBufferData.resize(_capacity);
+    _uploadFrom = 0;
+    _uploadTo = 0;
+    _mirroredSize = 0;
+    _reallocatePending = true;
+}
+
+void TextBuffer::reallocate() {
+    // The instances are uploaded right after, the buffers need no data of their own.
+    _textBuffer.reset();
+    _transformBuffer.reset();
+    _textBuffer = _shaderBufferPool->acquire(_capacity * sizeof(uint32_t));
+    _transformBuffer = _shaderBufferPool->acquire(_capacity * sizeof(glm::vec4));
+    _reallocatePending = false;
+}
+
+void TextBuffer::upload(size_t from, size_t to) {
+    const auto uploadRange = [&](size_t ringIndex, size_t count) {
+        _textBuffer->setSubData(
+            reinterpret_cast<const rendell::byte_t *>(_textBufferData.data() + ringIndex),
+            count * sizeof(uint32_t), ringIndex * sizeof(uint32_t));
+        _transformBuffer->setSubData(
+            reinterpret_cast<const rendell::byte_t *>(_transformBufferData.data() + ringIndex),
+            count * sizeof(glm::vec4), ringIndex * sizeof(glm::vec4));
+        if (ringIndex <= _mirroredSize) {
+            _mirroredSize = std::max(_mirroredSize, ringIndex + count);
+        }
+    };
+
+    if (from >= to) {
+        return;
+    }
+    // A range running past the end of the ring continues at its start.
+    const size_t ringIndex = getRingIndex(from);
+    const size_t count = to - from;
+    const size_t headCount = std::min(count, _capacity - ringIndex);
+    uploadRange(ringIndex, headCount);
+    if (headCount < count) {
+        uploadRange(0, count - headCount);
+    }
+}
 } // namespace rendell_text
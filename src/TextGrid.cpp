@@ -0,0 +1,391 @@
+#include "RasteredFontStorageManager.h"
+#include <algorithm>
+#include <logging.h>
+#include <rendell_text/TextGrid.h>
+#include <unicode.h>
+
+const size_t CLEAR_BUFFER_CACHE_FLAG = 1 << 0;
+const size_t RECREATE_CELL_BUFFER_FLAG = 1 << 1;
+const size_t UPDATE_GLYPH_BUFFERS_FLAG = 1 << 2;
+const size_t UPLOAD_ATTRIBUTE_PALETTE_FLAG = 1 << 3;
+
+namespace rendell_text {
+static std::shared_ptr<RasteredFontStorageManager> s_rasteredFontStorageManager;
+static rendell::oop::ShaderBufferSharedPtr s_defaultAttributePaletteBuffer;
+static const glm::vec4 UNSTYLED_ATTRIBUTE_COLOR(-1.0f);
+static uint32_t s_instanceCount{};
+static bool s_initialized = false;
+
+static bool initStaticGridStuff() {
+    s_rasteredFontStorageManager = RasteredFontStorageManager::getShared();
+    return true;
+}
+
+static void releaseStaticGridStuff() {
+    s_rasteredFontStorageManager.reset();
+    s_defaultAttributePaletteBuffer.reset();
+    s_initialized = false;
+}
+
+// Without attribute styles the shaders only read attribute 0, any buffer does for the binding.
+static const rendell::oop::ShaderBufferSharedPtr &getDefaultAttributePaletteBuffer() {
+    if (!s_defaultAttributePaletteBuffer) {
+        const glm::vec4 paletteData[2]{};
+        s_defaultAttributePaletteBuffer = rendell::oop::makeShaderBuffer(
+            reinterpret_cast<const rendell::byte_t *>(paletteData), sizeof(paletteData));
+    }
+    return s_defaultAttributePaletteBuffer;
+}
+
+static bool isVisibleCharacter(char32_t character) {
+    return character > U' ';
+}
+
+TextGrid::TextGrid() {
+    s_instanceCount++;
+    init();
+}
+
+TextGrid::~TextGrid() {
+    _rasteredFontStorage.reset();
+    _glyphBuffersForRendering.clear();
+    s_rasteredFontStorageManager->clearUnusedCache();
+
+    s_instanceCount--;
+    if (s_instanceCount == 0) {
+        releaseStaticGridStuff();
+    }
+}
+
+bool TextGrid::isInitialized() const {
+    return s_initialized;
+}
+
+void TextGrid::update() {
+    if (_updateActionFlags & CLEAR_BUFFER_CACHE_FLAG) {
+        _rasteredFontStorage = getRasteredFontStorage();
+        updateCellSize();
+    }
+    if (_updateActionFlags & (CLEAR_BUFFER_CACHE_FLAG | UPDATE_GLYPH_BUFFERS_FLAG)) {
+        updateGlyphBuffers();
+    }
+    if (_cells.empty()) {
+        _cellBuffer.reset();
+    } else if (_updateActionFlags & RECREATE_CELL_BUFFER_FLAG) {
+        _cellBuffer = rendell::oop::makeShaderBuffer(
+            reinterpret_cast<const rendell::byte_t *>(_cells.data()),
+            _cells.size() * sizeof(uint32_t));
+        std::fill(_dirtyRows.begin(), _dirtyRows.end(), false);
+    } else {
+        uploadDirtyRows();
+    }
+    if (_updateActionFlags & UPLOAD_ATTRIBUTE_PALETTE_FLAG) {
+        uploadAttributePalette();
+    }
+    _updateActionFlags = 0;
+}
+
+void TextGrid::setFontPath(const std::filesystem::path &fontPath) {
+    if (_fontPath != fontPath) {
+        _fontPath = fontPath;
+        _updateActionFlags |= CLEAR_BUFFER_CACHE_FLAG;
+    }
+}
+
+void TextGrid::setFontSize(const glm::ivec2 &fontSize) {
+    if (_fontSize != fontSize) {
+        _fontSize = fontSize;
+        _updateActionFlags |= CLEAR_BUFFER_CACHE_FLAG;
+    }
+}
+
+void TextGrid::setGridSize(uint32_t columns, uint32_t rows) {
+    if (_columns == columns && _rows == rows) {
+        return;
+    }
+
+    // Keep the visible content that still fits, unrolling the ring buffer on the way.
+    std::vector<uint32_t> cells(static_cast<size_t>(columns) * rows, 0);
+    for (uint32_t row = 0; row < std::min(rows, _rows); row++) {
+        for (uint32_t column = 0; column < std::min(columns, _columns); column++) {
+            cells[static_cast<size_t>(row) * columns + column] = _cells[getCellIndex(column, row)];
+        }
+    }
+
+    _columns = columns;
+    _rows = rows;
+    _firstRow = 0;
+    _cells = std::move(cells);
+    _dirtyRows.assign(rows, false);
+
+    _rangeUsage.clear();
+    for (const uint32_t cell : _cells) {
+        const char32_t character = cell & CODEPOINT_MASK;
+        if (isVisibleCharacter(character)) {
+            _rangeUsage[character / CHAR_RANGE_SIZE]++;
+        }
+    }
+
+    _updateActionFlags |= RECREATE_CELL_BUFFER_FLAG | UPDATE_GLYPH_BUFFERS_FLAG;
+}
+
+void TextGrid::setCell(uint32_t column, uint32_t row, char32_t character, uint32_t attribute) {
+    assert(column < _columns && row < _rows);
+    assert(attribute <= MAX_ATTRIBUTE);
+    const uint32_t value = (attribute << CODEPOINT_BITS) | (character & CODEPOINT_MASK);
+    writeCell(getCellIndex(column, row), value);
+}
+
+void TextGrid::setText(uint32_t column, uint32_t row, std::wstring_view text,
+                       uint32_t attribute) {
+    size_t index = 0;
+    while (index < text.length() && column < _columns) {
+        setCell(column++, row, next_codepoint(text, index), attribute);
+    }
+}
+
+void TextGrid::clearRow(uint32_t row) {
+    assert(row < _rows);
+    for (uint32_t column = 0; column < _columns; column++) {
+        writeCell(getCellIndex(column, row), 0);
+    }
+}
+
+void TextGrid::clear() {
+    for (uint32_t row = 0; row < _rows; row++) {
+        clearRow(row);
+    }
+}
+
+void TextGrid::scroll(uint32_t rowCount) {
+    rowCount = std::min(rowCount, _rows);
+    for (uint32_t row = 0; row < rowCount; row++) {
+        clearRow(row);
+    }
+    if (_rows > 0) {
+        _firstRow = (_firstRow + rowCount) % _rows;
+    }
+}
+
+void TextGrid::setAttributeStyle(uint32_t attribute, const TextStyle &style) {
+    assert(attribute > 0 && attribute <= MAX_ATTRIBUTE);
+    if (attribute >= _attributePalette.size()) {
+        _attributePalette.resize(attribute + 1);
+        _attributeStyled.resize(attribute + 1);
+    } else if (_attributeStyled[attribute] && _attributePalette[attribute] == style) {
+        return;
+    }
+    _attributePalette[attribute] = style;
+    _attributeStyled[attribute] = true;
+    _updateActionFlags |= UPLOAD_ATTRIBUTE_PALETTE_FLAG;
+}
+
+void TextGrid::clearAttributeStyles() {
+    if (_attributePalette.size() > 1) {
+        _attributePalette.resize(1);
+        _attributeStyled.resize(1);
+        _updateActionFlags |= UPLOAD_ATTRIBUTE_PALETTE_FLAG;
+    }
+}
+
+const std::filesystem::path &TextGrid::getFontPath() const {
+    return _fontPath;
+}
+
+glm::ivec2 TextGrid::getFontSize() const {
+    return _fontSize;
+}
+
+uint32_t TextGrid::getColumns() const {
+    return _columns;
+}
+
+uint32_t TextGrid::getRows() const {
+    return _rows;
+}
+
+uint32_t TextGrid::getFirstRow() const {
+    return _firstRow;
+}
+
+glm::vec2 TextGrid::getCellSize() const {
+    return _cellSize;
+}
+
+char32_t TextGrid::getCharacter(uint32_t column, uint32_t row) const {
+    return _cells[getCellIndex(column, row)] & CODEPOINT_MASK;
+}
+
+uint32_t TextGrid::getAttribute(uint32_t column, uint32_t row) const {
+    return _cells[getCellIndex(column, row)] >> CODEPOINT_BITS;
+}
+
+const std::vector<TextStyle> &TextGrid::getAttributePalette() const {
+    return _attributePalette;
+}
+
+bool TextGrid::hasAttributeStyle(uint32_t attribute) const {
+    return attribute < _attributeStyled.size() && _attributeStyled[attribute];
+}
+
+bool TextGrid::hasAttributeBackgrounds() const {
+    return std::any_of(_attributePalette.begin() + 1, _attributePalette.end(),
+                       [](const TextStyle &style) { return style.backgroundColor.a > 0.0f; });
+}
+
+float TextGrid::getCellDescender() const {
+    return _cellDescender;
+}
+
+const std::vector<GlyphBufferSharedPtr> &TextGrid::getGlyphBuffersForRendering() const {
+    return _glyphBuffersForRendering;
+}
+
+void TextGrid::useCellBuffer(uint32_t cellBufferBinding) const {
+    _cellBuffer->use(cellBufferBinding);
+}
+
+void TextGrid::useAttributePalette(uint32_t attributePaletteBinding) const {
+    if (_attributePaletteBuffer) {
+        _attributePaletteBuffer->use(attributePaletteBinding);
+    } else {
+        getDefaultAttributePaletteBuffer()->use(attributePaletteBinding);
+    }
+}
+
+bool TextGrid::init() {
+    if (!s_initialized) {
+        s_initialized = initStaticGridStuff();
+    }
+
+    return s_initialized;
+}
+
+size_t TextGrid::getCellIndex(uint32_t column, uint32_t row) const {
+    const uint32_t storageRow = (_firstRow + row) % _rows;
+    return static_cast<size_t>(storageRow) * _columns + column;
+}
+
+void TextGrid::writeCell(size_t cellIndex, uint32_t value) {
+    const uint32_t oldValue = _cells[cellIndex];
+    if (oldValue == value) {
+        return;
+    }
+
+    const char32_t oldCharacter = oldValue & CODEPOINT_MASK;
+    const char32_t newCharacter = value & CODEPOINT_MASK;
+    if (oldCharacter != newCharacter) {
+        if (isVisibleCharacter(oldCharacter)) {
+            auto it = _rangeUsage.find(oldCharacter / CHAR_RANGE_SIZE);
+            if (--it->second == 0) {
+                _rangeUsage.erase(it);
+                _updateActionFlags |= UPDATE_GLYPH_BUFFERS_FLAG;
+            }
+        }
+        if (isVisibleCharacter(newCharacter)) {
+            if (_rangeUsage[newCharacter / CHAR_RANGE_SIZE]++ == 0) {
+                _updateActionFlags |= UPDATE_GLYPH_BUFFERS_FLAG;
+            }
+        }
+    }
+
+    _cells[cellIndex] = value;
+    markRowDirty(static_cast<uint32_t>(cellIndex / _columns));
+}
+
+void TextGrid::markRowDirty(uint32_t storageRow) {
+    _dirtyRows[storageRow] = true;
+}
+
+void TextGrid::updateCellSize() {
+    _cellSize = glm::vec2(0.0f, static_cast<float>(_fontSize.y));
+    _cellDescender = 0.0f;
+    if (!_rasteredFontStorage) {
+        return;
+    }
+
+    const IFontRasterSharedPtr fontRaster = _rasteredFontStorage->getFontRaster();
+    if (fontRaster->isInitialized()) {
+        _cellDescender = static_cast<float>(fontRaster->getDescender());
+    }
+
+    const GlyphBufferSharedPtr glyphBuffer =
+        _rasteredFontStorage->rasterizeGlyphRange(_rasteredFontStorage->getRangeIndex(U' '));
+    if (glyphBuffer) {
+        _cellSize.x = static_cast<float>(glyphBuffer->getRasterizedChar(U' ').glyphAdvance >> 6);
+    }
+}
+
+void TextGrid::updateGlyphBuffers() {
+    _glyphBuffersForRendering.clear();
+    if (!_rasteredFontStorage) {
+        return;
+    }
+
+    for (const auto &[rangeIndex, usage] : _rangeUsage) {
+        GlyphBufferSharedPtr glyphBuffer = _rasteredFontStorage->rasterizeGlyphRange(rangeIndex);
+        if (!glyphBuffer) {
+            RT_ERROR("Failed to rasterize glyph range {}", rangeIndex);
+            continue;
+        }
+        _glyphBuffersForRendering.push_back(std::move(glyphBuffer));
+    }
+}
+
+void TextGrid::uploadDirtyRows() {
+    if (!_cellBuffer) {
+        return;
+    }
+
+    // Adjacent dirty rows are contiguous in storage and go out as one transfer.
+    const size_t rowSize = static_cast<size_t>(_columns) * sizeof(uint32_t);
+    uint32_t row = 0;
+    while (row < _rows) {
+        if (!_dirtyRows[row]) {
+            row++;
+            continue;
+        }
+
+        const uint32_t from = row;
+        while (row < _rows && _dirtyRows[row]) {
+            _dirtyRows[row++] = false;
+        }
+        const size_t offset = from * rowSize;
+        _cellBuffer->setSubData(reinterpret_cast<const rendell::byte_t *>(_cells.data()) + offset,
+                                (row - from) * rowSize, offset);
+    }
+}
+
+void TextGrid::uploadAttributePalette() {
+    _attributePaletteBuffer.reset();
+    if (_attributePalette.size() <= 1) {
+        return;
+    }
+
+    // Two vec4 per attribute, matching the stylePalette buffer in TextRenderer.fs. Attributes
+    // without a style get a negative text alpha, which TextGrid.vs maps to the renderer colors.
+    std::vector<glm::vec4> paletteData;
+    paletteData.reserve(_attributePalette.size() * 2);
+    for (size_t i = 0; i < _attributePalette.size(); i++) {
+        paletteData.push_back(_attributeStyled[i] ? _attributePalette[i].color
+                                                  : UNSTYLED_ATTRIBUTE_COLOR);
+        paletteData.push_back(_attributePalette[i].backgroundColor);
+    }
+    _attributePaletteBuffer = rendell::oop::makeShaderBuffer(
+        reinterpret_cast<const rendell::byte_t *>(paletteData.data()),
+        paletteData.size() * sizeof(glm::vec4));
+}
+
+RasteredFontStorageSharedPtr TextGrid::getRasteredFontStorage() const {
+    RasteredFontStoragePreset preset{
+        _fontPath.string(),
+        static_cast<uint32_t>(_fontSize.x),
+        static_cast<uint32_t>(_fontSize.y),
+        CHAR_RANGE_SIZE,
+    };
+    const RasteredFontStorageSharedPtr result =
+        s_rasteredFontStorageManager->getRasteredFontStorage(preset);
+    s_rasteredFontStorageManager->clearUnusedCache();
+    return result;
+}
+} // namespace rendell_text
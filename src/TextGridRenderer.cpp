@@ -0,0 +1,211 @@
+#include <rendell_text/TextGridRenderer.h>
+
+#include "RendererUtils.h"
+#include "res_Shaders_TextGrid_vs.h"
+#include "res_Shaders_TextRenderer_styled_bc4_fs.h"
+#include "res_Shaders_TextRenderer_styled_fs.h"
+#include <logging.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <memory>
+
+#define TEXTURE_ARRAY_BLOCK 0
+#define CELL_BUFFER_BINDING 0
+#define GLYPH_METRICS_BUFFER_BINDING 1
+#define ATTRIBUTE_PALETTE_BUFFER_BINDING 2
+
+namespace rendell_text {
+static rendell::oop::VertexAssemblySharedPtr s_vertexAssembly;
+static rendell::oop::ShaderProgramSharedPtr s_shaderProgram;
+static rendell::oop::ShaderProgramSharedPtr s_blockCompressedShaderProgram;
+static std::unique_ptr<rendell::oop::Mat4Uniform> s_matrixUniform{nullptr};
+static std::unique_ptr<rendell::oop::Float2Uniform> s_fontSizeUniform{nullptr};
+static std::unique_ptr<rendell::oop::Float2Uniform> s_cellSizeUniform{nullptr};
+static std::unique_ptr<rendell::oop::Float4Uniform> s_textColorUniform{nullptr};
+static std::unique_ptr<rendell::oop::Float4Uniform> s_backgroundColorUniform{nullptr};
+static std::unique_ptr<rendell::oop::Int1Uniform> s_charFromUniform{nullptr};
+static std::unique_ptr<rendell::oop::Int1Uniform> s_charCountUniform{nullptr};
+static std::unique_ptr<rendell::oop::Int1Uniform> s_columnsUniform{nullptr};
+static std::unique_ptr<rendell::oop::Int1Uniform> s_rowsUniform{nullptr};
+static std::unique_ptr<rendell::oop::Int1Uniform> s_firstRowUniform{nullptr};
+static std::unique_ptr<rendell::oop::Int1Uniform> s_attributeCountUniform{nullptr};
+static std::unique_ptr<rendell::oop::Int1Uniform> s_backgroundPassUniform{nullptr};
+static std::unique_ptr<rendell::oop::Float2Uniform> s_cellBackgroundOffsetUniform{nullptr};
+static std::unique_ptr<rendell::oop::Sampler2DUniform> s_texturesUniform{nullptr};
+static uint32_t s_instanceCount{};
+static bool s_initialized = false;
+
+// Fonts with glyph block compression are rare, so their program is linked on first use.
+static const rendell::oop::ShaderProgramSharedPtr &getShaderProgram(bool blockCompressed) {
+    if (!blockCompressed) {
+        return s_shaderProgram;
+    }
+    if (!s_blockCompressedShaderProgram) {
+        s_blockCompressedShaderProgram =
+            createShaderProgram(res_Shaders_TextGrid_vs, res_Shaders_TextRenderer_styled_bc4_fs);
+        assert(s_blockCompressedShaderProgram);
+    }
+    return s_blockCompressedShaderProgram;
+}
+
+static bool initStaticRendererStuff() {
+    s_vertexAssembly = createVertexAssembly();
+    assert(s_vertexAssembly);
+
+    // Cells index the attribute palette, which the styled programs read like a style palette.
+    s_shaderProgram =
+        createShaderProgram(res_Shaders_TextGrid_vs, res_Shaders_TextRenderer_styled_fs);
+    assert(s_shaderProgram);
+
+    s_matrixUniform = std::make_unique<rendell::oop::Mat4Uniform>("u_Matrix");
+    s_fontSizeUniform = std::make_unique<rendell::oop::Float2Uniform>("u_FontSize");
+    s_cellSizeUniform = std::make_unique<rendell::oop::Float2Uniform>("u_CellSize");
+    s_textColorUniform = std::make_unique<rendell::oop::Float4Uniform>("u_TextColor");
+    s_backgroundColorUniform = std::make_unique<rendell::oop::Float4Uniform>("u_BackgroundColor");
+    s_charFromUniform = std::make_unique<rendell::oop::Int1Uniform>("u_CharFrom");
+    s_charCountUniform = std::make_unique<rendell::oop::Int1Uniform>("u_CharCount");
+    s_columnsUniform = std::make_unique<rendell::oop::Int1Uniform>("u_Columns");
+    s_rowsUniform = std::make_unique<rendell::oop::Int1Uniform>("u_Rows");
+    s_firstRowUniform = std::make_unique<rendell::oop::Int1Uniform>("u_FirstRow");
+    s_attributeCountUniform = std::make_unique<rendell::oop::Int1Uniform>("u_AttributeCount");
+    s_backgroundPassUniform = std::make_unique<rendell::oop::Int1Uniform>("u_BackgroundPass");
+    s_cellBackgroundOffsetUniform =
+        std::make_unique<rendell::oop::Float2Uniform>("u_CellBackgroundOffset");
+    s_texturesUniform = std::make_unique<rendell::oop::Sampler2DUniform>("u_Textures");
+
+    return true;
+}
+
+static void releaseStaticRendererStuff() {
+    s_vertexAssembly.reset();
+    s_shaderProgram.reset();
+    s_blockCompressedShaderProgram.reset();
+    s_matrixUniform.reset();
+    s_fontSizeUniform.reset();
+    s_cellSizeUniform.reset();
+    s_textColorUniform.reset();
+    s_backgroundColorUniform.reset();
+    s_charFromUniform.reset();
+    s_charCountUniform.reset();
+    s_columnsUniform.reset();
+    s_rowsUniform.reset();
+    s_firstRowUniform.reset();
+    s_attributeCountUniform.reset();
+    s_backgroundPassUniform.reset();
+    s_cellBackgroundOffsetUniform.reset();
+    s_texturesUniform.reset();
+
+    s_initialized = false;
+}
+
+TextGridRenderer::TextGridRenderer() {
+    s_instanceCount++;
+    init();
+}
+
+TextGridRenderer::~TextGridRenderer() {
+    s_instanceCount--;
+    if (s_instanceCount == 0) {
+        releaseStaticRendererStuff();
+    }
+}
+
+bool TextGridRenderer::isInitialized() const {
+    return s_initialized;
+}
+
+const TextGridSharedPtr &TextGridRenderer::getTextGrid() const {
+    return _textGrid;
+}
+
+void TextGridRenderer::setTextGrid(const TextGridSharedPtr &textGrid) {
+    _textGrid = textGrid;
+}
+
+void TextGridRenderer::setMatrix(const glm::mat4 &matrix) {
+    _matrix = matrix;
+}
+
+void TextGridRenderer::setColor(const glm::vec4 &color) {
+    _color = color;
+}
+
+void TextGridRenderer::setBackgroundColor(const glm::vec4 backgroundColor) {
+    _backgroundColor = backgroundColor;
+}
+
+const glm::vec4 &TextGridRenderer::getColor() const {
+    return _color;
+}
+
+void TextGridRenderer::draw() {
+    if (!_textGrid) {
+        return;
+    }
+
+    _textGrid->update();
+
+    const uint32_t cellCount = _textGrid->getColumns() * _textGrid->getRows();
+    if (cellCount == 0) {
+        return;
+    }
+
+    // The cell backgrounds go first, so the glyphs of every range end up on top of them. The
+    // background rects never sample the glyph pages.
+    if (_textGrid->hasAttributeBackgrounds()) {
+        s_shaderProgram->use();
+        s_vertexAssembly->use();
+        _textGrid->useCellBuffer(CELL_BUFFER_BINDING);
+        _textGrid->useAttributePalette(ATTRIBUTE_PALETTE_BUFFER_BINDING);
+        setUniforms();
+        s_backgroundPassUniform->set(1);
+        rendell::setDrawType(rendell::DrawMode::ArraysInstanced,
+                             rendell::PrimitiveTopology::TriangleStrip, cellCount);
+        rendell::submit();
+    }
+
+    // Every pass walks all cells; the shader drops the cells of other glyph ranges.
+    for (const GlyphBufferSharedPtr &glyphBuffer : _textGrid->getGlyphBuffersForRendering()) {
+        const std::pair<char32_t, char32_t> &range = glyphBuffer->getRange();
+        getShaderProgram(glyphBuffer->isBlockCompressed())->use();
+        s_vertexAssembly->use();
+        glyphBuffer->use(s_texturesUniform->getId(), TEXTURE_ARRAY_BLOCK);
+        glyphBuffer->useMetrics(GLYPH_METRICS_BUFFER_BINDING);
+        _textGrid->useCellBuffer(CELL_BUFFER_BINDING);
+        _textGrid->useAttributePalette(ATTRIBUTE_PALETTE_BUFFER_BINDING);
+        setUniforms();
+        s_backgroundPassUniform->set(0);
+        s_charFromUniform->set(static_cast<int>(range.first));
+        s_charCountUniform->set(static_cast<int>(range.second - range.first));
+        rendell::setDrawType(rendell::DrawMode::ArraysInstanced,
+                             rendell::PrimitiveTopology::TriangleStrip, cellCount);
+        rendell::submit();
+    }
+}
+
+bool TextGridRenderer::init() {
+    if (!s_initialized) {
+        s_initialized = initStaticRendererStuff();
+    }
+
+    return s_initialized;
+}
+
+void TextGridRenderer::setUniforms() {
+    const glm::ivec2 fontSize = _textGrid->getFontSize();
+    const glm::vec2 cellSize = _textGrid->getCellSize();
+
+    s_matrixUniform->set(glm::value_ptr(_matrix));
+    s_fontSizeUniform->set(static_cast<float>(fontSize.x), static_cast<float>(fontSize.y));
+    s_cellSizeUniform->set(cellSize.x, cellSize.y);
+    s_textColorUniform->set(_color.r, _color.g, _color.b, _color.a);
+    s_backgroundColorUniform->set(_backgroundColor.r, _backgroundColor.g, _backgroundColor.b,
+                                  _backgroundColor.a);
+    s_columnsUniform->set(static_cast<int>(_textGrid->getColumns()));
+    s_rowsUniform->set(static_cast<int>(_textGrid->getRows()));
+    s_firstRowUniform->set(static_cast<int>(_textGrid->getFirstRow()));
+    s_attributeCountUniform->set(static_cast<int>(_textGrid->getAttributePalette().size()));
+    s_cellBackgroundOffsetUniform->set(0.0f, _textGrid->getCellDescender());
+}
+} // namespace rendell_text
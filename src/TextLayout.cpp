@@ -1,40 +1,131 @@
+#include "LayoutCache.h"
+#include "LayoutSnapshot.h"
 #include "RasteredFontStorageManager.h"
+#include "TextTraceRecorder.h"
+#include <algorithm>
 #include <fstream>
+#include <cmath>
+#include <limits>
 #include <glm/gtc/matrix_transform.hpp>
+#include <hash.h>
+#include <line_break.h>
 #include <logging.h>
 #include <memory>
+#include <numeric>
+#include <iterator>
 #include <rendell_text/TextLayout.h>
 #include <rendell_text/private/IFontRaster.h>
+#include <unicode.h>
+#include <utility>
 
-#define CHAR_RANGE_SIZE 200
-#define TEXT_BUFFER_SIZE 100
+#define TEXT_BUFFER_CAPACITY 128
 
 const size_t CLEAR_BUFFER_CACHE_FLAG = 1 << 0;
 const size_t UPDATE_BUFFER_FLAG = 1 << 1;
+const size_t UPLOAD_STYLE_PALETTE_FLAG = 1 << 2;
+const size_t REFLOW_FLAG = 1 << 3;
+
+// Past this origin the instances are rebuilt around 0 so float positions stay exact.
+const float MAX_INSTANCE_ORIGIN = 1 << 22;
+
+const uint32_t INVALID_TEXT_BATCH_INDEX = std::numeric_limits<uint32_t>::max();
 
 namespace rendell_text {
-static std::unique_ptr<RasteredFontStorageManager> s_rasteredFontStorageManager;
+static std::shared_ptr<RasteredFontStorageManager> s_rasteredFontStorageManager;
+static std::unique_ptr<LayoutCache> s_layoutCache;
+static rendell::oop::ShaderBufferSharedPtr s_defaultStylePaletteBuffer;
 static uint32_t s_instanceCount{};
+static uint64_t s_lastRevision{};
 static bool s_initialized = false;
 
 static bool initStaticRendererStuff() {
-    s_rasteredFontStorageManager.reset(new RasteredFontStorageManager);
+    s_rasteredFontStorageManager = RasteredFontStorageManager::getShared();
+    s_layoutCache = std::make_unique<LayoutCache>();
     return true;
 }
 
 static void releaseStaticRendererStuff() {
-    s_rasteredFontStorageManager.reset(nullptr);
+    s_rasteredFontStorageManager.reset();
+    s_layoutCache.reset();
+    s_defaultStylePaletteBuffer.reset();
     s_initialized = false;
 }
 
+static const rendell::oop::ShaderBufferSharedPtr &getDefaultStylePaletteBuffer() {
+    if (!s_defaultStylePaletteBuffer) {
+        const glm::vec4 paletteData[2]{};
+        s_defaultStylePaletteBuffer = rendell::oop::makeShaderBuffer(
+            reinterpret_cast<const rendell::byte_t *>(paletteData), sizeof(paletteData));
+    }
+    return s_defaultStylePaletteBuffer;
+}
+
+// Spans are sorted and never overlap, so a forward iterator is enough to walk them along a line.
+template <typename SpanIterator>
+static uint32_t getSpanIndex(SpanIterator &it, SpanIterator end, size_t characterIndex) {
+    while (it != end && it->to <= characterIndex) {
+        it++;
+    }
+    return it != end && it->from <= characterIndex ? it->index : 0;
+}
+
+// Instances are appended in paragraph order, so the ones of a leading or trailing run of
+// paragraphs are at the start or the end of every batch. Only filled paragraphs count. The counts
+// go to layoutState.instanceCounts.
+static void countTextBatchInstances(LayoutState &layoutState, size_t from, size_t to) {
+    std::vector<size_t> &result = layoutState.instanceCounts;
+    result.assign(layoutState.textBatches.size(), 0);
+    from = std::max(from, layoutState.filledParagraphsFrom);
+    to = std::min(to, layoutState.filledParagraphsTo);
+    for (size_t i = from; i < to; i++) {
+        for (const LayoutInstance &layoutInstance : layoutState.paragraphs[i].instances) {
+            result[layoutInstance.textBatchIndex]++;
+        }
+    }
+}
+
+// Readies a paragraph for shaping while keeping the capacity of its buffers.
+static void resetParagraph(LayoutParagraph &paragraph) {
+    paragraph.length = 0;
+    paragraph.instances.clear();
+    paragraph.instanceCharacters.clear();
+    paragraph.penPositions.clear();
+    paragraph.missingGlyphCount = 0;
+    paragraph.ascender = 0.0f;
+    paragraph.descender = 0.0f;
+    paragraph.lineHeight = 0.0f;
+    paragraph.lineStarts.assign(1, 0);
+    paragraph.wrapWidth = -1.0f;
+    paragraph.wrapMode = WrapMode::None;
+}
+
+// Layout keys of shareable texts are built on every pass, into storage kept per thread.
+static thread_local LayoutKey s_layoutKey;
+
+template <typename Span>
+static typename std::vector<Span>::const_iterator findFirstSpan(const std::vector<Span> &spans,
+                                                                size_t characterIndex) {
+    return std::partition_point(spans.cbegin(), spans.cend(),
+                                [&](const Span &span) { return span.to <= characterIndex; });
+}
+
 TextLayout::TextLayout() {
     s_instanceCount++;
     init();
+    _layoutState = std::make_shared<LayoutState>();
+    bumpRevision();
 }
 
 TextLayout::~TextLayout() {
+    RT_TRACE_CALL(LayoutDestroy);
+    if (_layoutState.use_count() == 1) {
+        s_layoutCache->erase(*_layoutState);
+    }
+    _layoutState.reset();
+
     // Release it to check the cache.
     _rasteredFontStorage.reset();
+    _fontChains.clear();
     s_rasteredFontStorageManager->clearUnusedCache();
 
     s_instanceCount--;
@@ -47,42 +138,76 @@ bool TextLayout::isInitialized() const {
     return s_initialized;
 }
 
-const std::unordered_set<TextBatchSharedPtr> &TextLayout::getTextBatchesForRendering() const {
-    return _textBatchesForRendering;
+const std::vector<TextBatchSharedPtr> &TextLayout::getTextBatchesForRendering() const {
+    return _layoutState->textBatchesForRendering;
 }
 
-std::wstring TextLayout::getSubText(size_t indexFrom) const {
+std::wstring_view TextLayout::getSubText(size_t indexFrom) const {
     assert(indexFrom < _text.length());
-    return std::wstring(_text.begin() + indexFrom, _text.end());
+    return std::wstring_view(_text).substr(indexFrom);
 }
 
 void TextLayout::update() {
+    RT_TRACE_CALL(LayoutUpdate);
     updateBuffersIfNeeded();
+    uploadBuffersIfNeeded();
 }
 
 void TextLayout::setFontPath(const std::filesystem::path &fontPath) {
+    RT_TRACE_CALL(LayoutSetFontPath, fontPath);
     if (_fontPath != fontPath) {
         _fontPath = fontPath;
-        _rasteredFontStorage = getRasteredFontStorage();
+        _rasteredFontStorage = getRasteredFontStorage(_fontPath, _fontSize);
         _updateActionFlags |= CLEAR_BUFFER_CACHE_FLAG;
         _updateActionFlags |= UPDATE_BUFFER_FLAG;
     }
 }
 
-void TextLayout::setText(const std::wstring &value) {
-    std::wstring text = value;
-    setText(std::move(text));
+void TextLayout::setText(const wchar_t *value) {
+    setText(std::wstring_view(value));
+}
+
+void TextLayout::setText(std::wstring_view value) {
+    RT_TRACE_CALL(LayoutSetText, value);
+    // Assigning reuses the existing storage instead of going through a temporary string.
+    _decodedText.assign(value);
+    replaceText();
 }
 
 void TextLayout::setText(std::wstring &&value) {
-    _text = std::move(value);
-    _updateActionFlags |= UPDATE_BUFFER_FLAG;
+    RT_TRACE_CALL(LayoutSetText, std::wstring_view(value));
+    _decodedText = std::move(value);
+    replaceText();
+}
+
+void TextLayout::setText(std::u8string_view value) {
+    RT_TRACE_CALL(LayoutSetText, value);
+    _decodedText.clear();
+    append_utf8(_decodedText, value);
+    replaceText();
+}
+
+void TextLayout::setText(std::u32string_view value) {
+    RT_TRACE_CALL(LayoutSetText, value);
+    _decodedText.clear();
+    append_utf32(_decodedText, value);
+    replaceText();
 }
 
 void TextLayout::setFontSize(const glm::ivec2 &fontSize) {
+    RT_TRACE_CALL(LayoutSetFontSize, fontSize);
     if (_fontSize != fontSize) {
         _fontSize = fontSize;
-        _rasteredFontStorage = getRasteredFontStorage();
+        _rasteredFontStorage = getRasteredFontStorage(_fontPath, _fontSize);
+        _updateActionFlags |= CLEAR_BUFFER_CACHE_FLAG;
+        _updateActionFlags |= UPDATE_BUFFER_FLAG;
+    }
+}
+
+void TextLayout::setFallbackFontPaths(const std::vector<std::filesystem::path> &fontPaths) {
+    RT_TRACE_CALL(LayoutSetFallbackFontPaths, fontPaths);
+    if (_fallbackFontPaths != fontPaths) {
+        _fallbackFontPaths = fontPaths;
         _updateActionFlags |= CLEAR_BUFFER_CACHE_FLAG;
         _updateActionFlags |= UPDATE_BUFFER_FLAG;
     }
@@ -97,6 +222,18 @@ const std::filesystem::path &TextLayout::getFontPath() const {
     return emptyPath;
 }
 
+const std::vector<std::filesystem::path> &TextLayout::getFallbackFontPaths() const {
+    return _fallbackFontPaths;
+}
+
+size_t TextLayout::getMissingGlyphCount() const {
+    updateBuffersIfNeeded();
+    return std::accumulate(_layoutState->paragraphs.begin(), _layoutState->paragraphs.end(),
+                           size_t{0}, [](size_t count, const LayoutParagraph &paragraph) {
+                               return count + paragraph.missingGlyphCount;
+                           });
+}
+
 glm::ivec2 TextLayout::getFontSize() const {
     return _fontSize;
 }
@@ -123,7 +260,233 @@ uint32_t TextLayout::getDescender() const {
 
 const std::vector<uint32_t> &TextLayout::getTextAdvance() const {
     updateBuffersIfNeeded();
-    return _textAdvance;
+    return _layoutState->textAdvance;
+}
+
+void TextLayout::setWrapWidth(float wrapWidth) {
+    RT_TRACE_CALL(LayoutSetWrapWidth, wrapWidth);
+    if (_wrapWidth != wrapWidth) {
+        _wrapWidth = wrapWidth;
+        _updateActionFlags |= REFLOW_FLAG | UPDATE_BUFFER_FLAG;
+    }
+}
+
+void TextLayout::setWrapMode(WrapMode wrapMode) {
+    RT_TRACE_CALL(LayoutSetWrapMode, wrapMode);
+    if (_wrapMode != wrapMode) {
+        _wrapMode = wrapMode;
+        _updateActionFlags |= REFLOW_FLAG | UPDATE_BUFFER_FLAG;
+    }
+}
+
+float TextLayout::getWrapWidth() const {
+    return _wrapWidth;
+}
+
+WrapMode TextLayout::getWrapMode() const {
+    return _wrapMode;
+}
+
+void TextLayout::setVisibleLines(size_t firstLine, size_t lineCount) {
+    RT_TRACE_CALL(LayoutSetVisibleLines, firstLine, lineCount);
+    if (!_visibleLinesSet || _visibleFirstLine != firstLine || _visibleLineCount != lineCount) {
+        _visibleLinesSet = true;
+        _visibleFirstLine = firstLine;
+        _visibleLineCount = lineCount;
+        _updateActionFlags |= UPDATE_BUFFER_FLAG;
+    }
+}
+
+void TextLayout::clearVisibleLines() {
+    RT_TRACE_CALL(LayoutClearVisibleLines);
+    if (_visibleLinesSet) {
+        _visibleLinesSet = false;
+        _updateActionFlags |= UPDATE_BUFFER_FLAG;
+    }
+}
+
+void TextLayout::setScrollbackLimit(size_t maxLineCount, size_t maxLength) {
+    RT_TRACE_CALL(LayoutSetScrollbackLimit, maxLineCount, maxLength);
+    _maxLineCount = maxLineCount;
+    _maxLength = maxLength;
+    trimScrollback();
+}
+
+size_t TextLayout::getMaxLineCount() const {
+    return _maxLineCount;
+}
+
+size_t TextLayout::getMaxLength() const {
+    return _maxLength;
+}
+
+glm::vec2 TextLayout::getInstanceOrigin() const {
+    return _layoutState->instanceOrigin;
+}
+
+uint64_t TextLayout::getRevision() const {
+    return _revision;
+}
+
+std::vector<uint8_t> TextLayout::saveSnapshot() const {
+    updateBuffersIfNeeded();
+    LayoutSnapshotKey snapshotKey;
+    if (!_textSpans.empty() || !_fontSpans.empty() || !makeSnapshotKey(snapshotKey)) {
+        RT_WARNING("Only a laid out text without styles and font runs can be saved");
+        return {};
+    }
+    if (_visibleLinesSet) {
+        RT_WARNING("A layout with visible lines holds only their instances and cannot be saved");
+        return {};
+    }
+
+    // Batches are keyed by the font storage, the snapshot refers to the font by its chain index.
+    const LayoutState &layoutState = *_layoutState;
+    const std::vector<RasteredFontStorageSharedPtr> &fontChain = getFontChain(0);
+    std::vector<LayoutSnapshotBatch> batches(layoutState.textBatches.size());
+    for (const auto &[key, textBatchIndex] : layoutState.textBatchIndices) {
+        const auto it = std::find_if(fontChain.begin(), fontChain.end(),
+                                     [&](const RasteredFontStorageSharedPtr &rasteredFontStorage) {
+                                         return rasteredFontStorage.get() == key.first;
+                                     });
+        batches[textBatchIndex] = {static_cast<uint32_t>(it - fontChain.begin()), key.second};
+    }
+    return writeLayoutSnapshot(snapshotKey, layoutState, batches);
+}
+
+bool TextLayout::loadSnapshot(std::span<const uint8_t> snapshot) {
+    if (_updateActionFlags & CLEAR_BUFFER_CACHE_FLAG) {
+        clearBufferCache();
+        _updateActionFlags &= ~CLEAR_BUFFER_CACHE_FLAG;
+    }
+
+    LayoutSnapshotKey snapshotKey;
+    LayoutSnapshotKey expectedKey;
+    if (!_textSpans.empty() || !_fontSpans.empty() || !makeSnapshotKey(expectedKey) ||
+        !readLayoutSnapshotKey(snapshot, snapshotKey) || snapshotKey != expectedKey) {
+        return false;
+    }
+
+    std::shared_ptr<LayoutState> previousLayoutState =
+        std::exchange(_layoutState, std::make_shared<LayoutState>());
+    const std::vector<RasteredFontStorageSharedPtr> &fontChain = getFontChain(0);
+    const bool loaded =
+        readLayoutSnapshot(snapshot, *_layoutState, [&](const LayoutSnapshotBatch &batch) {
+            return batch.fontIndex < fontChain.size()
+                       ? createTextBatch(batch.rangeIndex, fontChain[batch.fontIndex])
+                       : INVALID_TEXT_BATCH_INDEX;
+        });
+    if (!loaded) {
+        RT_WARNING("Layout snapshot is corrupted, the text is laid out instead");
+        _layoutState = std::move(previousLayoutState);
+        return false;
+    }
+
+    if (previousLayoutState.use_count() == 1) {
+        s_layoutCache->erase(*previousLayoutState);
+    }
+    if (isLayoutShareable()) {
+        makeLayoutKey(_layoutState->key);
+        s_layoutCache->insert(_layoutState);
+    }
+    _relayoutFrom = std::numeric_limits<size_t>::max();
+    _unchangedSuffix = std::numeric_limits<size_t>::max();
+    _pendingEviction = 0;
+    _updateActionFlags &= UPLOAD_STYLE_PALETTE_FLAG;
+    bumpRevision();
+    return true;
+}
+
+size_t TextLayout::getLineCount() const {
+    RT_TRACE_CALL(LayoutGetLineCount);
+    updateBuffersIfNeeded();
+    return _layoutState->lineStarts.size();
+}
+
+size_t TextLayout::getLineIndex(size_t characterIndex) const {
+    RT_TRACE_CALL(LayoutGetLineIndex, characterIndex);
+    assert(characterIndex <= _text.length());
+    updateBuffersIfNeeded();
+    const std::vector<size_t> &lineStarts = _layoutState->lineStarts;
+    const auto it = std::upper_bound(lineStarts.begin(), lineStarts.end(), characterIndex);
+    return static_cast<size_t>(it - lineStarts.begin()) - 1;
+}
+
+std::pair<size_t, size_t> TextLayout::getLineRange(size_t lineIndex) const {
+    RT_TRACE_CALL(LayoutGetLineRange, lineIndex);
+    updateBuffersIfNeeded();
+    const std::vector<size_t> &lineStarts = _layoutState->lineStarts;
+    assert(lineIndex < lineStarts.size());
+    // The range excludes the terminating '\n', a wrapped line ends where the next one starts.
+    const size_t from = lineStarts[lineIndex];
+    if (lineIndex + 1 == lineStarts.size()) {
+        return {from, _text.length()};
+    }
+    const size_t next = lineStarts[lineIndex + 1];
+    return {from, _text[next - 1] == L'\n' ? next - 1 : next};
+}
+
+size_t TextLayout::getCharacterIndex(const glm::vec2 &point) const {
+    RT_TRACE_CALL(LayoutGetCharacterIndex, point);
+    updateBuffersIfNeeded();
+    const std::vector<LayoutLine> &lines = _layoutState->lines;
+    const std::vector<uint32_t> &textAdvance = _layoutState->textAdvance;
+    if (lines.empty()) {
+        return 0;
+    }
+
+    // A line covers everything from its bottom (baseline + descender) up to the next line.
+    const auto lineIt = std::upper_bound(
+        lines.begin(), lines.end(), point.y,
+        [](float y, const LayoutLine &line) { return y < line.baseline + line.descender; });
+    const size_t lineIndex = lineIt == lines.begin() ? 0 : (lineIt - lines.begin()) - 1;
+    const auto [from, to] = getLineRange(lineIndex);
+
+    // Advances grow monotonically within a line, so the nearest caret position is bisected.
+    size_t low = from;
+    size_t high = to;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        const float left = middle == from ? 0.0f : static_cast<float>(textAdvance[middle - 1]);
+        const float right = static_cast<float>(textAdvance[middle]);
+        if ((left + right) * 0.5f <= point.x) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (low < to && is_trailing_unit(_text[low])) {
+        low++;
+    }
+    return low;
+}
+
+TextRect TextLayout::getCharacterRect(size_t characterIndex) const {
+    RT_TRACE_CALL(LayoutGetCharacterRect, characterIndex);
+    const size_t lineIndex = getLineIndex(characterIndex);
+    const LayoutState &layoutState = *_layoutState;
+    const size_t lineStart = layoutState.lineStarts[lineIndex];
+    const float left = characterIndex == lineStart
+                           ? 0.0f
+                           : static_cast<float>(layoutState.textAdvance[characterIndex - 1]);
+    const float right = characterIndex < _text.length() && _text[characterIndex] != '\n'
+                            ? static_cast<float>(layoutState.textAdvance[characterIndex])
+                            : left;
+
+    if (lineIndex >= layoutState.lines.size()) {
+        return {glm::vec2(left, 0.0f), glm::vec2(right - left, 0.0f)};
+    }
+    const LayoutLine &line = layoutState.lines[lineIndex];
+    return {glm::vec2(left, line.baseline + line.descender),
+            glm::vec2(right - left, line.ascender - line.descender)};
+}
+
+TextRect TextLayout::getCaretRect(size_t characterIndex) const {
+    RT_TRACE_CALL(LayoutGetCaretRect, characterIndex);
+    TextRect result = getCharacterRect(characterIndex);
+    result.size.x = 0.0f;
+    return result;
 }
 
 void TextLayout::eraseText(size_t startIndex) {
@@ -131,24 +494,145 @@ void TextLayout::eraseText(size_t startIndex) {
 }
 
 void TextLayout::eraseText(size_t startIndex, size_t count) {
-    assert(startIndex >= 0 && startIndex + count <= _text.length());
+    RT_TRACE_CALL(LayoutEraseText, startIndex, count);
+    assert(startIndex + count <= _text.length());
     _text.erase(startIndex, count);
-    _updateActionFlags |= UPDATE_BUFFER_FLAG;
+    shiftTextSpans(startIndex, 0, count);
+    invalidateLayout(startIndex, startIndex);
 }
 
-void TextLayout::insertText(const std::wstring &text, size_t startIndex) {
-    assert(startIndex >= 0 && startIndex <= _text.length());
+void TextLayout::insertText(std::wstring_view text, size_t startIndex) {
+    RT_TRACE_CALL(LayoutInsertText, text, startIndex);
+    assert(startIndex <= _text.length());
     _text.insert(startIndex, text);
-    _updateActionFlags |= UPDATE_BUFFER_FLAG;
+    shiftTextSpans(startIndex, text.length(), 0);
+    invalidateLayout(startIndex, startIndex + text.length());
+}
+
+void TextLayout::insertText(std::u8string_view text, size_t startIndex) {
+    RT_TRACE_CALL(LayoutInsertText, text, startIndex);
+    assert(startIndex <= _text.length());
+    const size_t oldLength = _text.length();
+    insert_utf8(_text, startIndex, text);
+    const size_t insertedCount = _text.length() - oldLength;
+    shiftTextSpans(startIndex, insertedCount, 0);
+    invalidateLayout(startIndex, startIndex + insertedCount);
+}
+
+void TextLayout::insertText(std::u32string_view text, size_t startIndex) {
+    RT_TRACE_CALL(LayoutInsertText, text, startIndex);
+    assert(startIndex <= _text.length());
+    const size_t oldLength = _text.length();
+    insert_utf32(_text, startIndex, text);
+    const size_t insertedCount = _text.length() - oldLength;
+    shiftTextSpans(startIndex, insertedCount, 0);
+    invalidateLayout(startIndex, startIndex + insertedCount);
 }
 
-void TextLayout::appendText(const std::wstring &text) {
+void TextLayout::appendText(std::wstring_view text) {
+    RT_TRACE_CALL(LayoutAppendText, text);
     if (!text.empty()) {
+        const size_t oldLength = _text.length();
         _text += text;
-        _updateActionFlags |= UPDATE_BUFFER_FLAG;
+        onTextAppended(oldLength);
+    }
+}
+
+void TextLayout::appendText(std::u8string_view text) {
+    RT_TRACE_CALL(LayoutAppendText, text);
+    if (!text.empty()) {
+        const size_t oldLength = _text.length();
+        append_utf8(_text, text);
+        onTextAppended(oldLength);
     }
 }
 
+void TextLayout::appendText(std::u32string_view text) {
+    RT_TRACE_CALL(LayoutAppendText, text);
+    if (!text.empty()) {
+        const size_t oldLength = _text.length();
+        append_utf32(_text, text);
+        onTextAppended(oldLength);
+    }
+}
+
+void TextLayout::setTextStyle(size_t startIndex, size_t count, const TextStyle &style) {
+    RT_TRACE_CALL(LayoutSetTextStyle, startIndex, count, style);
+    assert(startIndex + count <= _text.length());
+    const uint32_t styleIndex = getStyleIndex(style);
+    if (styleIndex != 0 && count > 0) {
+        assignSpan(_textSpans, startIndex, startIndex + count, styleIndex);
+        invalidateLayout(startIndex, startIndex + count);
+    }
+}
+
+void TextLayout::clearTextStyle(size_t startIndex, size_t count) {
+    RT_TRACE_CALL(LayoutClearTextStyle, startIndex, count);
+    assert(startIndex + count <= _text.length());
+    if (count > 0) {
+        assignSpan(_textSpans, startIndex, startIndex + count, 0);
+        invalidateLayout(startIndex, startIndex + count);
+    }
+}
+
+void TextLayout::clearTextStyles() {
+    RT_TRACE_CALL(LayoutClearTextStyles);
+    _textSpans.clear();
+    _stylePalette.resize(1);
+    _updateActionFlags |= UPLOAD_STYLE_PALETTE_FLAG;
+    invalidateLayout(0, _text.length());
+}
+
+void TextLayout::useStylePalette(uint32_t stylePaletteBinding) const {
+    // Without styles the shader never reads the palette, any buffer does for the binding.
+    if (_stylePaletteBuffer) {
+        _stylePaletteBuffer->use(stylePaletteBinding);
+    } else {
+        getDefaultStylePaletteBuffer()->use(stylePaletteBinding);
+    }
+}
+
+const std::vector<TextStyle> &TextLayout::getStylePalette() const {
+    return _stylePalette;
+}
+
+void TextLayout::setTextFont(size_t startIndex, size_t count,
+                             const std::filesystem::path &fontPath, const glm::ivec2 &fontSize) {
+    RT_TRACE_CALL(LayoutSetTextFont, startIndex, count, fontPath, fontSize);
+    assert(startIndex + count <= _text.length());
+    if (count == 0) {
+        return;
+    }
+
+    auto it = std::find_if(_fontRuns.begin() + 1, _fontRuns.end(), [&](const FontRun &fontRun) {
+        return fontRun.fontPath == fontPath && fontRun.fontSize == fontSize;
+    });
+    if (it == _fontRuns.end()) {
+        it = _fontRuns.insert(_fontRuns.end(), FontRun{fontPath, fontSize});
+    }
+    assignSpan(_fontSpans, startIndex, startIndex + count,
+               static_cast<uint32_t>(it - _fontRuns.begin()));
+    invalidateLayout(startIndex, startIndex + count);
+}
+
+void TextLayout::clearTextFont(size_t startIndex, size_t count) {
+    RT_TRACE_CALL(LayoutClearTextFont, startIndex, count);
+    assert(startIndex + count <= _text.length());
+    if (count > 0) {
+        assignSpan(_fontSpans, startIndex, startIndex + count, 0);
+        invalidateLayout(startIndex, startIndex + count);
+    }
+}
+
+void TextLayout::clearTextFonts() {
+    RT_TRACE_CALL(LayoutClearTextFonts);
+    _fontSpans.clear();
+    _fontRuns.resize(1);
+    // Run indices get reused, so the chains and the batches keyed by their fonts go as well.
+    _updateActionFlags |= CLEAR_BUFFER_CACHE_FLAG;
+    invalidateLayout(0, _text.length());
+}
+
 bool TextLayout::init() {
     if (!s_initialized) {
         s_initialized = initStaticRendererStuff();
@@ -161,74 +645,793 @@ bool TextLayout::init() {
     return s_initialized;
 }
 
+void TextLayout::replaceText() {
+    // Texts set every frame (counters, clocks, live cells) mostly keep their start and end, only
+    // the paragraphs between are laid out again and only the instances that moved are uploaded.
+    const size_t prefixLength = common_prefix_length(_text, _decodedText);
+    if (prefixLength == _text.length() && prefixLength == _decodedText.length()) {
+        return;
+    }
+    const size_t suffixLength =
+        common_suffix_length(std::wstring_view(_text).substr(prefixLength),
+                             std::wstring_view(_decodedText).substr(prefixLength));
+    // The old text stays behind as the buffer of the next decode.
+    _text.swap(_decodedText);
+    invalidateLayout(prefixLength, _text.length() - suffixLength);
+}
+
+void TextLayout::invalidateLayout(size_t fromIndex, size_t toIndex) {
+    _relayoutFrom = std::min(_relayoutFrom, fromIndex);
+    _unchangedSuffix = std::min(_unchangedSuffix, _text.length() - toIndex);
+    _lineEndsValid = false;
+    _updateActionFlags |= UPDATE_BUFFER_FLAG;
+}
+
+void TextLayout::onTextAppended(size_t oldLength) {
+    const bool lineEndsValid = _lineEndsValid;
+    invalidateLayout(oldLength, _text.length());
+    if (_maxLineCount == 0 && _maxLength == 0) {
+        return;
+    }
+
+    if (lineEndsValid) {
+        for (size_t i = _text.find(L'\n', oldLength); i != std::wstring::npos;
+             i = _text.find(L'\n', i + 1)) {
+            _lineEnds.push_back(_evictedLength + i);
+        }
+        _lineEndsValid = true;
+    }
+    trimScrollback();
+}
+
+void TextLayout::trimScrollback() {
+    if (_maxLineCount == 0 && _maxLength == 0) {
+        return;
+    }
+
+    if (!_lineEndsValid) {
+        _lineEnds.clear();
+        for (size_t i = _text.find(L'\n'); i != std::wstring::npos; i = _text.find(L'\n', i + 1)) {
+            _lineEnds.push_back(_evictedLength + i);
+        }
+        _lineEndsValid = true;
+    }
+
+    // Lines are dropped whole, the text then starts right after the last dropped '\n'.
+    size_t eraseCount = 0;
+    while (!_lineEnds.empty() &&
+           ((_maxLineCount > 0 && _lineEnds.size() + 1 > _maxLineCount) ||
+            (_maxLength > 0 && _text.length() - eraseCount > _maxLength))) {
+        eraseCount = _lineEnds.front() - _evictedLength + 1;
+        _lineEnds.pop_front();
+    }
+    if (eraseCount == 0) {
+        return;
+    }
+
+    _text.erase(0, eraseCount);
+    shiftTextSpans(0, 0, eraseCount);
+    _evictedLength += eraseCount;
+    _pendingEviction += eraseCount;
+    if (_relayoutFrom != std::numeric_limits<size_t>::max()) {
+        _relayoutFrom -= std::min(_relayoutFrom, eraseCount);
+    }
+    _unchangedSuffix = std::min(_unchangedSuffix, _text.length());
+    _updateActionFlags |= UPDATE_BUFFER_FLAG;
+}
+
+uint32_t TextLayout::getStyleIndex(const TextStyle &style) {
+    auto it = std::find(_stylePalette.begin() + 1, _stylePalette.end(), style);
+    if (it != _stylePalette.end()) {
+        return static_cast<uint32_t>(it - _stylePalette.begin());
+    }
+
+    if (_stylePalette.size() > MAX_INSTANCE_STYLE_INDEX) {
+        compactStylePalette();
+    }
+    if (_stylePalette.size() > MAX_INSTANCE_STYLE_INDEX) {
+        RT_WARNING("Style palette is full ({} styles in use), the style is not applied",
+                   _stylePalette.size() - 1);
+        return 0;
+    }
+    _stylePalette.push_back(style);
+    _updateActionFlags |= UPLOAD_STYLE_PALETTE_FLAG;
+    return static_cast<uint32_t>(_stylePalette.size() - 1);
+}
+
+void TextLayout::compactStylePalette() {
+    // Maps every old index to its new one, 0 for the styles no span references.
+    std::vector<uint32_t> styleIndices(_stylePalette.size(), 0);
+    for (const TextSpan &span : _textSpans) {
+        styleIndices[span.index] = 1;
+    }
+    uint32_t styleCount = 1;
+    for (size_t i = 1; i < _stylePalette.size(); i++) {
+        if (styleIndices[i] != 0) {
+            styleIndices[i] = styleCount;
+            _stylePalette[styleCount++] = _stylePalette[i];
+        }
+    }
+    if (styleCount == _stylePalette.size()) {
+        return;
+    }
+    _stylePalette.resize(styleCount);
+    _updateActionFlags |= UPLOAD_STYLE_PALETTE_FLAG;
+
+    // The instances hold the style index, the spans that were renumbered are laid out again.
+    size_t from = std::numeric_limits<size_t>::max();
+    size_t to = 0;
+    for (TextSpan &span : _textSpans) {
+        if (styleIndices[span.index] != span.index) {
+            span.index = styleIndices[span.index];
+            from = std::min(from, span.from);
+            to = std::max(to, span.to);
+        }
+    }
+    if (from < to) {
+        invalidateLayout(from, to);
+    }
+}
+
+void TextLayout::assignSpan(std::vector<TextSpan> &spans, size_t from, size_t to,
+                            uint32_t index) {
+    if (from >= to) {
+        return;
+    }
+
+    std::vector<TextSpan> result;
+    result.reserve(spans.size() + 2);
+    bool inserted = false;
+    for (const TextSpan &span : spans) {
+        if (span.to <= from || span.from >= to) {
+            if (!inserted && span.from >= to) {
+                if (index != 0) {
+                    result.push_back({from, to, index});
+                }
+                inserted = true;
+            }
+            result.push_back(span);
+            continue;
+        }
+        // The span overlaps the new one, keep only the parts sticking out of it.
+        if (span.from < from) {
+            result.push_back({span.from, from, span.index});
+        }
+        if (!inserted) {
+            if (index != 0) {
+                result.push_back({from, to, index});
+            }
+            inserted = true;
+        }
+        if (span.to > to) {
+            result.push_back({to, span.to, span.index});
+        }
+    }
+    if (!inserted && index != 0) {
+        result.push_back({from, to, index});
+    }
+
+    spans = std::move(result);
+}
+
+void TextLayout::shiftTextSpans(size_t index, size_t insertedCount, size_t erasedCount) {
+    const size_t erasedTo = index + erasedCount;
+    const auto shift = [&](size_t position, bool isEnd) {
+        if (position < index || (isEnd && position == index)) {
+            return position;
+        }
+        if (position < erasedTo) {
+            return index;
+        }
+        return position - erasedCount + insertedCount;
+    };
+    const auto shiftSpans = [&](std::vector<TextSpan> &spans) {
+        std::erase_if(spans, [&](TextSpan &span) {
+            span.from = shift(span.from, false);
+            span.to = shift(span.to, true);
+            return span.from >= span.to;
+        });
+    };
+
+    shiftSpans(_textSpans);
+    shiftSpans(_fontSpans);
+}
+
 static glm::vec2 getInstanceLocalOffset(const RasterizedChar &rasterizedChar) {
     const glm::vec2 bearing = rasterizedChar.glyphBearing;
     const glm::vec2 size = rasterizedChar.glyphSize;
     return glm::vec2(bearing.x, bearing.y - size.y);
 }
 
+bool TextLayout::isLayoutShareable() const {
+    return _textSpans.empty() && _fontSpans.empty() && !_visibleLinesSet &&
+           _text.length() <= LayoutCache::MAX_TEXT_LENGTH;
+}
+
+void TextLayout::makeLayoutKey(LayoutKey &layoutKey) const {
+    layoutKey.text.assign(_text);
+    layoutKey.fontPaths.resize(_fallbackFontPaths.size() + 1);
+    layoutKey.fontPaths[0] = _fontPath;
+    std::copy(_fallbackFontPaths.begin(), _fallbackFontPaths.end(),
+              layoutKey.fontPaths.begin() + 1);
+    layoutKey.fontSize = _fontSize;
+    layoutKey.wrapWidth = _wrapWidth;
+    layoutKey.wrapMode = _wrapMode;
+}
+
+bool TextLayout::makeSnapshotKey(LayoutSnapshotKey &snapshotKey) const {
+    if (!_rasteredFontStorage || !_rasteredFontStorage->getFontRaster()->isInitialized()) {
+        return false;
+    }
+
+    snapshotKey.textLength = _text.length();
+    snapshotKey.textHash = hash_bytes(_text.data(), _text.length() * sizeof(wchar_t));
+    snapshotKey.fontHashes.clear();
+    for (const RasteredFontStorageSharedPtr &rasteredFontStorage : getFontChain(0)) {
+        const IFontRasterSharedPtr fontRaster = rasteredFontStorage->getFontRaster();
+        snapshotKey.fontHashes.push_back(fontRaster->isInitialized() ? fontRaster->getContentHash()
+                                                                     : 0);
+    }
+    snapshotKey.fontSize = _fontSize;
+    snapshotKey.wrapWidth = _wrapWidth;
+    snapshotKey.wrapMode = _wrapMode;
+    return true;
+}
+
+void TextLayout::prepareLayoutStateForWriting() const {
+    if (_layoutState.use_count() > 1) {
+        // Copy on write: the shared batches stay with the other layouts, this one starts over.
+        _layoutState = std::make_shared<LayoutState>();
+        _relayoutFrom = 0;
+        _unchangedSuffix = 0;
+    } else {
+        s_layoutCache->erase(*_layoutState);
+    }
+}
+
 void TextLayout::updateShaderBuffers() const {
-    _textBatchesForRendering.clear();
-    _textAdvance.resize(_text.length());
-    auto it = _textAdvance.begin();
+    const size_t pendingEviction = std::exchange(_pendingEviction, 0);
+    const LayoutKey *layoutKey = nullptr;
+    if (isLayoutShareable()) {
+        makeLayoutKey(s_layoutKey);
+        layoutKey = &s_layoutKey;
+        if (_layoutState->cached && _layoutState->key == *layoutKey) {
+            _relayoutFrom = std::numeric_limits<size_t>::max();
+            _unchangedSuffix = std::numeric_limits<size_t>::max();
+            return;
+        }
+        if (std::shared_ptr<LayoutState> layoutState = s_layoutCache->find(*layoutKey)) {
+            _layoutState = std::move(layoutState);
+            _relayoutFrom = std::numeric_limits<size_t>::max();
+            _unchangedSuffix = std::numeric_limits<size_t>::max();
+            return;
+        }
+    }
+    prepareLayoutStateForWriting();
+    if (pendingEviction > 0 && !evictParagraphs(pendingEviction)) {
+        // The dropped text was never laid out, everything is laid out again.
+        _layoutState = std::make_shared<LayoutState>();
+        _relayoutFrom = 0;
+        _unchangedSuffix = 0;
+    }
 
-    glm::vec2 currentOffset(0.0f, 0.0f);
+    LayoutState &layoutState = *_layoutState;
     const size_t length = _text.length();
-    for (size_t i = 0; i < length; i++) {
-        const wchar_t currentCharacter = _text[i];
+    const bool reflow = (_updateActionFlags & REFLOW_FLAG) != 0;
+    const bool textChanged = _relayoutFrom != std::numeric_limits<size_t>::max() ||
+                             layoutState.paragraphs.empty();
 
-        if (currentCharacter == '\n') {
-            currentOffset.x = 0.0f;
-            currentOffset.y += _fontSize.y;
-            continue;
+    if (!_rasteredFontStorage || !_rasteredFontStorage->getFontRaster()->isInitialized()) {
+        // Nothing can be rasterized, the text is kept as a single empty line.
+        layoutState.textLength = length;
+        layoutState.paragraphs.clear();
+        layoutState.paragraphStarts.clear();
+        layoutState.paragraphFirstLines.clear();
+        layoutState.lines.clear();
+        layoutState.lineStarts.assign(1, 0);
+        layoutState.textAdvance.assign(length, 0);
+        fillTextBatches(0);
+        _relayoutFrom = 0;
+        _unchangedSuffix = 0;
+        return;
+    }
+
+    size_t firstPlacedParagraph = reflow ? 0 : layoutState.paragraphs.size();
+    size_t firstFilledParagraph = reflow ? 0 : layoutState.paragraphs.size();
+    if (textChanged) {
+        // Paragraphs before the first edited character and after the last one keep their shaping,
+        // the ones in between are shaped again.
+        const std::vector<size_t> &paragraphStarts = layoutState.paragraphStarts;
+        const size_t oldLength = layoutState.textLength;
+        const size_t relayoutFrom = std::min({_relayoutFrom, length, oldLength});
+        const size_t unchangedSuffix =
+            std::min(_unchangedSuffix, std::min(length, oldLength) - relayoutFrom);
+
+        size_t firstShapedParagraph = 0;
+        size_t keptBackCount = 0;
+        if (!paragraphStarts.empty()) {
+            firstShapedParagraph = static_cast<size_t>(std::upper_bound(paragraphStarts.begin(),
+                                                                        paragraphStarts.end(),
+                                                                        relayoutFrom) -
+                                                       paragraphStarts.begin()) -
+                                   1;
+            // A paragraph is kept when the '\n' before it is in the unchanged suffix.
+            const auto keptBackIt = std::upper_bound(
+                paragraphStarts.begin() + firstShapedParagraph + 1, paragraphStarts.end(),
+                oldLength - unchangedSuffix);
+            keptBackCount = static_cast<size_t>(paragraphStarts.end() - keptBackIt);
+        }
+
+        // Only the tail changed: the batches drop the instances of the paragraphs shaped again
+        // and get the new ones appended, everything before stays on the GPU as it is.
+        const bool appendOnly = !reflow && keptBackCount == 0 && firstShapedParagraph > 0 &&
+                                layoutState.instanceOrigin.y < MAX_INSTANCE_ORIGIN;
+        if (appendOnly) {
+            countTextBatchInstances(layoutState, firstShapedParagraph,
+                                    layoutState.paragraphs.size());
+            const std::vector<size_t> &instanceCounts = layoutState.instanceCounts;
+            for (size_t i = 0; i < instanceCounts.size(); i++) {
+                if (instanceCounts[i] > 0) {
+                    layoutState.textBatches[i]->eraseLastInstances(instanceCounts[i]);
+                }
+            }
         }
 
-        const TextBatchSharedPtr &textBatch = createTextBatch(currentCharacter);
-        if (!textBatch) {
-            std::cout << "ERROR::TextLayout: Failed to create text batch";
+        if (!shapeParagraphs(firstShapedParagraph, keptBackCount)) {
+            // Start over on the next change, the paragraphs were only partially shaped.
+            layoutState.textLength = length;
+            layoutState.paragraphs.clear();
+            layoutState.paragraphStarts.clear();
+            layoutState.paragraphFirstLines.clear();
+            layoutState.lines.clear();
+            layoutState.lineStarts.assign(1, 0);
+            layoutState.textAdvance.assign(length, 0);
+            fillTextBatches(0);
+            _relayoutFrom = 0;
+            _unchangedSuffix = 0;
             return;
         }
+        firstPlacedParagraph = std::min(firstPlacedParagraph, firstShapedParagraph);
+        firstFilledParagraph = appendOnly ? firstShapedParagraph : 0;
+    }
+    _relayoutFrom = std::numeric_limits<size_t>::max();
+    _unchangedSuffix = std::numeric_limits<size_t>::max();
+
+    placeParagraphs(firstPlacedParagraph);
+    fillTextBatches(firstFilledParagraph);
+    if (layoutKey) {
+        layoutState.key = *layoutKey;
+        s_layoutCache->insert(_layoutState);
+    }
+}
+
+bool TextLayout::shapeParagraphs(size_t paragraphIndex, size_t keptBackCount) const {
+    LayoutState &layoutState = *_layoutState;
+    const size_t length = _text.length();
+    const size_t oldLength = layoutState.textLength;
+    const size_t keptBackIndex = layoutState.paragraphs.size() - keptBackCount;
+
+    // The shaped range ends at the '\n' before the first kept paragraph, shifted by the edit.
+    const size_t from =
+        paragraphIndex < layoutState.paragraphs.size() ? layoutState.paragraphStarts[paragraphIndex]
+                                                       : 0;
+    const size_t to = keptBackCount > 0
+                          ? layoutState.paragraphStarts[keptBackIndex] - 1 + length - oldLength
+                          : length;
+
+    // The paragraphs shaped again become spares, the new ones are shaped into them.
+    std::vector<LayoutParagraph> &spareParagraphs = layoutState.spareParagraphs;
+    std::move(layoutState.paragraphs.begin() + paragraphIndex,
+              layoutState.paragraphs.begin() + keptBackIndex, std::back_inserter(spareParagraphs));
+    std::vector<LayoutParagraph> &paragraphs = layoutState.shapedParagraphs;
+    std::vector<size_t> &paragraphStarts = layoutState.shapedParagraphStarts;
+    paragraphs.clear();
+    paragraphStarts.clear();
+
+    size_t paragraphStart = from;
+    while (true) {
+        size_t paragraphEnd = _text.find(L'\n', paragraphStart);
+        if (paragraphEnd == std::wstring::npos || paragraphEnd > to) {
+            paragraphEnd = to;
+        }
+
+        if (spareParagraphs.empty()) {
+            paragraphs.emplace_back();
+        } else {
+            paragraphs.push_back(std::move(spareParagraphs.back()));
+            spareParagraphs.pop_back();
+            resetParagraph(paragraphs.back());
+        }
+        LayoutParagraph &paragraph = paragraphs.back();
+        if (!shapeParagraph(paragraphStart, paragraphEnd, paragraph)) {
+            return false;
+        }
+        paragraphStarts.push_back(paragraphStart);
+
+        if (paragraphEnd == to) {
+            break;
+        }
+        paragraphStart = paragraphEnd + 1;
+    }
+
+    for (size_t i = keptBackIndex; i < layoutState.paragraphStarts.size(); i++) {
+        layoutState.paragraphStarts[i] = layoutState.paragraphStarts[i] + length - oldLength;
+    }
+    const auto replace = [&](auto &target, auto &source) {
+        target.erase(target.begin() + paragraphIndex, target.begin() + keptBackIndex);
+        target.insert(target.begin() + paragraphIndex, std::make_move_iterator(source.begin()),
+                      std::make_move_iterator(source.end()));
+    };
+    replace(layoutState.paragraphs, paragraphs);
+    replace(layoutState.paragraphStarts, paragraphStarts);
+    paragraphs.clear();
+    layoutState.textLength = length;
+    return true;
+}
+
+bool TextLayout::shapeParagraph(size_t paragraphStart, size_t paragraphEnd,
+                                LayoutParagraph &paragraph) const {
+    measureParagraph(paragraphStart, paragraphEnd, paragraph);
+    paragraph.length = paragraphEnd - paragraphStart;
+    paragraph.penPositions.resize(paragraph.length);
+
+    auto styleIt = findFirstSpan(_textSpans, paragraphStart);
+    auto fontIt = findFirstSpan(_fontSpans, paragraphStart);
+    auto penIt = paragraph.penPositions.begin();
 
-        if (_textBatchesForRendering.find(textBatch) == _textBatchesForRendering.end()) {
-            textBatch->beginUpdating();
-            _textBatchesForRendering.insert(textBatch);
+    float penPosition = 0.0f;
+    size_t i = paragraphStart;
+    while (i < paragraphEnd) {
+        const size_t characterIndex = i;
+        const char32_t currentCharacter = next_codepoint(_text, i);
+        const uint32_t paragraphCharacter = static_cast<uint32_t>(characterIndex - paragraphStart);
+
+        const uint32_t fontRunIndex = getSpanIndex(fontIt, _fontSpans.cend(), characterIndex);
+        const RasteredFontStorageSharedPtr &rasteredFontStorage =
+            resolveFontStorage(currentCharacter, fontRunIndex, paragraph.missingGlyphCount);
+        const uint32_t textBatchIndex = createTextBatch(
+            rasteredFontStorage->getRangeIndex(currentCharacter), rasteredFontStorage);
+        if (textBatchIndex == INVALID_TEXT_BATCH_INDEX) {
+            RT_ERROR("Failed to create text batch for U+{:04X}",
+                     static_cast<uint32_t>(currentCharacter));
+            return false;
         }
 
-        const RasterizedChar &rasterizedChar =
-            textBatch->getGlyphBuffer()->getRasterizedChar(currentCharacter);
+        const RasterizedChar &rasterizedChar = _layoutState->textBatches[textBatchIndex]
+                                                   ->getGlyphBuffer()
+                                                   ->getRasterizedChar(currentCharacter);
+        const float advance = static_cast<float>(rasterizedChar.glyphAdvance >> 6);
+
+        const uint32_t styleIndex = getSpanIndex(styleIt, _textSpans.cend(), characterIndex);
+        const TextStyle &style = _stylePalette[styleIndex];
+        const float decorationThickness =
+            std::max(1.0f, std::round(getFontRunSize(fontRunIndex).y / 16.0f));
+
+        const auto addInstance = [&](uint32_t packedCharacter, const glm::vec4 &transform) {
+            paragraph.instances.push_back({textBatchIndex, packedCharacter, transform});
+            paragraph.instanceCharacters.push_back(paragraphCharacter);
+        };
+
+        // Decorations are solid instances in the character's batch: the highlight goes before
+        // the glyph so it stays behind it, the lines go after. The highlight spans the whole
+        // paragraph height so mixed font sizes still get an even band.
+        if (styleIndex != 0 && style.backgroundColor.a > 0.0f) {
+            addInstance(packRectInstance(RectKind::Background, styleIndex),
+                        glm::vec4(penPosition, paragraph.descender, advance,
+                                  paragraph.ascender - paragraph.descender));
+        }
 
         if (currentCharacter != ' ' && currentCharacter != '\t') {
-            const glm::vec2 glyphOffset = currentOffset + getInstanceLocalOffset(rasterizedChar);
-            textBatch->appendCharacter(currentCharacter, glyphOffset);
+            const glm::vec2 glyphOffset =
+                glm::vec2(penPosition, 0.0f) + getInstanceLocalOffset(rasterizedChar);
+            addInstance(packGlyphInstance(currentCharacter, styleIndex),
+                        glm::vec4(glyphOffset, rasterizedChar.glyphSize.x,
+                                  rasterizedChar.glyphSize.y));
         }
 
-        currentOffset.x += (rasterizedChar.glyphAdvance >> 6);
-        *it = static_cast<uint32_t>(currentOffset.x);
-        it++;
+        if (styleIndex != 0 && style.underline) {
+            addInstance(packRectInstance(RectKind::Foreground, styleIndex),
+                        glm::vec4(penPosition, -2.0f * decorationThickness, advance,
+                                  decorationThickness));
+        }
+        if (styleIndex != 0 && style.strikethrough) {
+            const float ascender = static_cast<float>(
+                rasteredFontStorage->getFontRaster()->getAscender());
+            addInstance(packRectInstance(RectKind::Foreground, styleIndex),
+                        glm::vec4(penPosition, ascender * 0.3f, advance, decorationThickness));
+        }
+
+        penPosition += advance;
+        // Surrogate pairs occupy two units of the text, both share the pen position.
+        penIt = std::fill_n(penIt, i - characterIndex, penPosition);
     }
+    return true;
+}
+
+void TextLayout::measureParagraph(size_t paragraphStart, size_t paragraphEnd,
+                                  LayoutParagraph &paragraph) const {
+    const auto addFontRun = [&](uint32_t fontRunIndex) {
+        const IFontRasterSharedPtr fontRaster = getFontChain(fontRunIndex).front()->getFontRaster();
+        if (fontRaster->isInitialized()) {
+            paragraph.ascender =
+                std::max(paragraph.ascender, static_cast<float>(fontRaster->getAscender()));
+            paragraph.descender =
+                std::min(paragraph.descender, static_cast<float>(fontRaster->getDescender()));
+        }
+        paragraph.lineHeight =
+            std::max(paragraph.lineHeight, static_cast<float>(getFontRunSize(fontRunIndex).y));
+    };
 
-    for (const TextBatchSharedPtr &textBatch : _textBatchesForRendering) {
-        textBatch->endUpdating();
+    // An empty paragraph takes the font of the position it starts at.
+    const size_t paragraphTo = std::max(paragraphEnd, paragraphStart + 1);
+    size_t coveredTo = paragraphStart;
+    for (auto it = findFirstSpan(_fontSpans, paragraphStart);
+         it != _fontSpans.cend() && it->from < paragraphTo; it++) {
+        if (it->from > coveredTo) {
+            addFontRun(0);
+        }
+        addFontRun(it->index);
+        coveredTo = it->to;
+    }
+    if (coveredTo < paragraphTo) {
+        addFontRun(0);
     }
 }
 
+void TextLayout::breakParagraph(size_t paragraphStart, LayoutParagraph &paragraph) const {
+    paragraph.lineStarts.assign(1, 0);
+    paragraph.wrapWidth = _wrapWidth;
+    paragraph.wrapMode = _wrapMode;
+    if (_wrapMode == WrapMode::None || _wrapWidth <= 0.0f) {
+        return;
+    }
+
+    break_lines(_text.data() + paragraphStart, paragraph.penPositions.data(), paragraph.length,
+                _wrapWidth, _wrapMode == WrapMode::Word, paragraph.lineStarts);
+}
+
+void TextLayout::placeParagraphs(size_t paragraphIndex) const {
+    LayoutState &layoutState = *_layoutState;
+    const std::vector<LayoutParagraph> &paragraphs = layoutState.paragraphs;
+
+    // The lines of the paragraphs before paragraphIndex are still valid.
+    const size_t firstLine = paragraphIndex == 0
+                                 ? 0
+                                 : layoutState.paragraphFirstLines[paragraphIndex - 1] +
+                                       paragraphs[paragraphIndex - 1].lineStarts.size();
+    layoutState.paragraphFirstLines.resize(paragraphs.size());
+    layoutState.lines.resize(firstLine);
+    layoutState.lineStarts.resize(firstLine);
+    layoutState.textAdvance.resize(_text.length());
+
+    for (size_t i = paragraphIndex; i < paragraphs.size(); i++) {
+        LayoutParagraph &paragraph = layoutState.paragraphs[i];
+        const size_t paragraphStart = layoutState.paragraphStarts[i];
+        if (paragraph.wrapWidth != _wrapWidth || paragraph.wrapMode != _wrapMode) {
+            breakParagraph(paragraphStart, paragraph);
+        }
+
+        layoutState.paragraphFirstLines[i] = layoutState.lines.size();
+        for (size_t j = 0; j < paragraph.lineStarts.size(); j++) {
+            const float baseline = layoutState.lines.empty()
+                                       ? 0.0f
+                                       : layoutState.lines.back().baseline + paragraph.lineHeight;
+            layoutState.lines.push_back({baseline, paragraph.ascender, paragraph.descender});
+
+            const size_t lineStart = paragraph.lineStarts[j];
+            const size_t lineEnd = j + 1 < paragraph.lineStarts.size()
+                                       ? paragraph.lineStarts[j + 1]
+                                       : paragraph.length;
+            layoutState.lineStarts.push_back(paragraphStart + lineStart);
+
+            const float penStart = lineStart == 0 ? 0.0f : paragraph.penPositions[lineStart - 1];
+            for (size_t k = lineStart; k < lineEnd; k++) {
+                layoutState.textAdvance[paragraphStart + k] =
+                    static_cast<uint32_t>(paragraph.penPositions[k] - penStart);
+            }
+        }
+        if (paragraphStart + paragraph.length < _text.length()) {
+            layoutState.textAdvance[paragraphStart + paragraph.length] = 0;
+        }
+    }
+}
+
+bool TextLayout::evictParagraphs(size_t length) const {
+    LayoutState &layoutState = *_layoutState;
+    std::vector<size_t> &paragraphStarts = layoutState.paragraphStarts;
+    const auto it = std::lower_bound(paragraphStarts.begin(), paragraphStarts.end(), length);
+    if (it == paragraphStarts.end() || *it != length) {
+        return false;
+    }
+
+    // The instances are dropped from the front of the rings, what stays is not touched.
+    const size_t paragraphCount = static_cast<size_t>(it - paragraphStarts.begin());
+    countTextBatchInstances(layoutState, 0, paragraphCount);
+    const std::vector<size_t> &instanceCounts = layoutState.instanceCounts;
+    for (size_t i = 0; i < instanceCounts.size(); i++) {
+        if (instanceCounts[i] > 0) {
+            layoutState.textBatches[i]->eraseFirstInstances(instanceCounts[i]);
+        }
+    }
+
+    // The remaining lines move up, the GPU positions stay and the origin follows instead.
+    const size_t lineCount = layoutState.paragraphFirstLines[paragraphCount];
+    const float baselineShift = layoutState.lines[lineCount].baseline;
+    layoutState.instanceOrigin.y += baselineShift;
+
+    layoutState.paragraphs.erase(layoutState.paragraphs.begin(),
+                                 layoutState.paragraphs.begin() + paragraphCount);
+    layoutState.filledParagraphsFrom =
+        std::max(layoutState.filledParagraphsFrom, paragraphCount) - paragraphCount;
+    layoutState.filledParagraphsTo =
+        std::max(layoutState.filledParagraphsTo, paragraphCount) - paragraphCount;
+    paragraphStarts.erase(paragraphStarts.begin(), it);
+    for (size_t &paragraphStart : paragraphStarts) {
+        paragraphStart -= length;
+    }
+    layoutState.paragraphFirstLines.erase(layoutState.paragraphFirstLines.begin(),
+                                          layoutState.paragraphFirstLines.begin() +
+                                              paragraphCount);
+    for (size_t &paragraphFirstLine : layoutState.paragraphFirstLines) {
+        paragraphFirstLine -= lineCount;
+    }
+    layoutState.lines.erase(layoutState.lines.begin(), layoutState.lines.begin() + lineCount);
+    for (LayoutLine &line : layoutState.lines) {
+        line.baseline -= baselineShift;
+    }
+    layoutState.lineStarts.erase(layoutState.lineStarts.begin(),
+                                 layoutState.lineStarts.begin() + lineCount);
+    for (size_t &lineStart : layoutState.lineStarts) {
+        lineStart -= length;
+    }
+    layoutState.textAdvance.erase(layoutState.textAdvance.begin(),
+                                  layoutState.textAdvance.begin() + length);
+    layoutState.textLength -= length;
+    return true;
+}
+
+void TextLayout::fillTextBatches(size_t paragraphIndex) const {
+    LayoutState &layoutState = *_layoutState;
+    size_t fillFrom = 0;
+    size_t fillTo = layoutState.paragraphs.size();
+    if (_visibleLinesSet) {
+        const std::vector<size_t> &paragraphFirstLines = layoutState.paragraphFirstLines;
+        const size_t lineEnd =
+            _visibleFirstLine +
+            std::min(_visibleLineCount, std::numeric_limits<size_t>::max() - _visibleFirstLine);
+        fillFrom = static_cast<size_t>(std::upper_bound(paragraphFirstLines.begin(),
+                                                        paragraphFirstLines.end(),
+                                                        _visibleFirstLine) -
+                                       paragraphFirstLines.begin());
+        fillFrom -= std::min<size_t>(fillFrom, 1);
+        fillTo = static_cast<size_t>(
+            std::lower_bound(paragraphFirstLines.begin(), paragraphFirstLines.end(), lineEnd) -
+            paragraphFirstLines.begin());
+        fillTo = std::max(fillTo, fillFrom);
+    }
+
+    // Appending keeps the filled paragraphs, which must reach the index to be continued and
+    // cover the visible ones. Otherwise the visible paragraphs are filled from scratch.
+    if (paragraphIndex > 0) {
+        const size_t filledFrom = layoutState.filledParagraphsFrom;
+        const size_t filledTo = layoutState.filledParagraphsTo >= paragraphIndex
+                                    ? std::max(paragraphIndex, fillTo)
+                                    : layoutState.filledParagraphsTo;
+        if (fillFrom < filledFrom || fillTo > filledTo) {
+            paragraphIndex = 0;
+        } else {
+            fillFrom = paragraphIndex;
+            fillTo = layoutState.filledParagraphsTo >= paragraphIndex ? filledTo : paragraphIndex;
+            layoutState.filledParagraphsTo = filledTo;
+        }
+    }
+    if (paragraphIndex == 0) {
+        layoutState.textBatchesForRendering.clear();
+        layoutState.textBatchesRendered.assign(layoutState.textBatches.size(), false);
+        layoutState.instanceOrigin = glm::vec2(0.0f);
+        layoutState.filledParagraphsFrom = fillFrom;
+        layoutState.filledParagraphsTo = fillTo;
+    } else {
+        layoutState.textBatchesRendered.resize(layoutState.textBatches.size(), false);
+    }
+    for (size_t i = fillFrom; i < fillTo; i++) {
+        const LayoutParagraph &paragraph = layoutState.paragraphs[i];
+        const size_t firstLine = layoutState.paragraphFirstLines[i];
+        // Instances were shaped on one unwrapped line, each is moved to the start of its line.
+        size_t line = 0;
+        glm::vec2 lineOffset =
+            glm::vec2(0.0f, layoutState.lines[firstLine].baseline) + layoutState.instanceOrigin;
+        for (size_t j = 0; j < paragraph.instances.size(); j++) {
+            const uint32_t paragraphCharacter = paragraph.instanceCharacters[j];
+            if (line + 1 < paragraph.lineStarts.size() &&
+                paragraph.lineStarts[line + 1] <= paragraphCharacter) {
+                while (line + 1 < paragraph.lineStarts.size() &&
+                       paragraph.lineStarts[line + 1] <= paragraphCharacter) {
+                    line++;
+                }
+                lineOffset = glm::vec2(-paragraph.penPositions[paragraph.lineStarts[line] - 1],
+                                       layoutState.lines[firstLine + line].baseline) +
+                             layoutState.instanceOrigin;
+            }
+
+            const LayoutInstance &layoutInstance = paragraph.instances[j];
+            const TextBatchSharedPtr &textBatch =
+                layoutState.textBatches[layoutInstance.textBatchIndex];
+            if (!layoutState.textBatchesRendered[layoutInstance.textBatchIndex]) {
+                layoutState.textBatchesRendered[layoutInstance.textBatchIndex] = true;
+                layoutState.textBatchesForRendering.push_back(textBatch);
+                textBatch->beginUpdating();
+            }
+            glm::vec4 transform = layoutInstance.transform;
+            transform.x += lineOffset.x;
+            transform.y += lineOffset.y;
+            textBatch->appendInstance(layoutInstance.packedCharacter, transform);
+        }
+    }
+    layoutState.uploadPending = true;
+}
+
+void TextLayout::clearBufferCache() const {
+    _rasteredFontStorage = getRasteredFontStorage(_fontPath, _fontSize);
+    _fontChains.clear();
+    s_layoutCache->erase(*_layoutState);
+    _layoutState = std::make_shared<LayoutState>();
+    _relayoutFrom = 0;
+    _unchangedSuffix = 0;
+}
+
+void TextLayout::bumpRevision() const {
+    _revision = ++s_lastRevision;
+}
+
 void TextLayout::updateBuffersIfNeeded() const {
+    if (_updateActionFlags & (CLEAR_BUFFER_CACHE_FLAG | UPDATE_BUFFER_FLAG)) {
+        bumpRevision();
+    }
     if (_updateActionFlags & CLEAR_BUFFER_CACHE_FLAG) {
-        _rasteredFontStorage = getRasteredFontStorage();
-        _cachedTextBatches.clear();
-        _textBatchesForRendering.clear();
+        clearBufferCache();
     }
     if (_updateActionFlags & UPDATE_BUFFER_FLAG) {
         updateShaderBuffers();
     }
-    _updateActionFlags = 0;
+    _updateActionFlags &= UPLOAD_STYLE_PALETTE_FLAG;
+}
+
+void TextLayout::uploadBuffersIfNeeded() const {
+    if (_updateActionFlags & UPLOAD_STYLE_PALETTE_FLAG) {
+        bumpRevision();
+        _stylePaletteBuffer.reset();
+        _updateActionFlags &= ~UPLOAD_STYLE_PALETTE_FLAG;
+    }
+    if (!_stylePaletteBuffer && _stylePalette.size() > 1) {
+        // Two vec4 per style, matching the stylePalette buffer in TextRenderer.fs.
+        std::vector<glm::vec4> paletteData;
+        paletteData.reserve(_stylePalette.size() * 2);
+        for (const TextStyle &style : _stylePalette) {
+            paletteData.push_back(style.color);
+            paletteData.push_back(style.backgroundColor);
+        }
+        _stylePaletteBuffer = rendell::oop::makeShaderBuffer(
+            reinterpret_cast<const rendell::byte_t *>(paletteData.data()),
+            paletteData.size() * sizeof(glm::vec4));
+    }
+
+    // A shared state is uploaded by whichever of its layouts gets here first.
+    if (_layoutState->uploadPending) {
+        for (const TextBatchSharedPtr &textBatch : _layoutState->textBatchesForRendering) {
+            textBatch->endUpdating();
+        }
+        _layoutState->uploadPending = false;
+    }
 }
 
-RasteredFontStorageSharedPtr TextLayout::getRasteredFontStorage() const {
+RasteredFontStorageSharedPtr
+TextLayout::getRasteredFontStorage(const std::filesystem::path &fontPath,
+                                   const glm::ivec2 &fontSize) const {
     RasteredFontStoragePreset preset{
-        _fontPath.string(),
-        static_cast<uint32_t>(_fontSize.x),
-        static_cast<uint32_t>(_fontSize.y),
+        fontPath.string(),
+        static_cast<uint32_t>(fontSize.x),
+        static_cast<uint32_t>(fontSize.y),
         CHAR_RANGE_SIZE,
     };
     const RasteredFontStorageSharedPtr result =
@@ -237,19 +1440,67 @@ RasteredFontStorageSharedPtr TextLayout::getRasteredFontStorage() const {
     return result;
 }
 
-TextBatchSharedPtr TextLayout::createTextBatch(wchar_t character) const {
-    const wchar_t rangeIndex = _rasteredFontStorage->getRangeIndex(character);
-    if (auto it = _cachedTextBatches.find(rangeIndex); it != _cachedTextBatches.end()) {
+const std::vector<RasteredFontStorageSharedPtr> &
+TextLayout::getFontChain(uint32_t fontRunIndex) const {
+    if (_fontChains.size() < _fontRuns.size()) {
+        _fontChains.resize(_fontRuns.size());
+    }
+
+    std::vector<RasteredFontStorageSharedPtr> &fontChain = _fontChains[fontRunIndex];
+    if (fontChain.empty()) {
+        const glm::ivec2 fontSize = getFontRunSize(fontRunIndex);
+        fontChain.push_back(fontRunIndex == 0
+                                ? _rasteredFontStorage
+                                : getRasteredFontStorage(_fontRuns[fontRunIndex].fontPath,
+                                                         fontSize));
+        for (const std::filesystem::path &fontPath : _fallbackFontPaths) {
+            fontChain.push_back(getRasteredFontStorage(fontPath, fontSize));
+        }
+    }
+    return fontChain;
+}
+
+glm::ivec2 TextLayout::getFontRunSize(uint32_t fontRunIndex) const {
+    return fontRunIndex == 0 ? _fontSize : _fontRuns[fontRunIndex].fontSize;
+}
+
+const RasteredFontStorageSharedPtr &
+TextLayout::resolveFontStorage(char32_t character, uint32_t fontRunIndex,
+                               size_t &missingGlyphCount) const {
+    const std::vector<RasteredFontStorageSharedPtr> &fontChain = getFontChain(fontRunIndex);
+    for (const RasteredFontStorageSharedPtr &rasteredFontStorage : fontChain) {
+        if (rasteredFontStorage->getFontRaster()->hasGlyph(character)) {
+            return rasteredFontStorage;
+        }
+    }
+
+    // Nothing to draw: the run's own font lays it out as an empty glyph.
+    if (character >= U' ') {
+        missingGlyphCount++;
+    }
+    return fontChain.front();
+}
+
+uint32_t
+TextLayout::createTextBatch(uint32_t rangeIndex,
+                            const RasteredFontStorageSharedPtr &rasteredFontStorage) const {
+    // Runs of the same face and size share their batches, so every glyph page is drawn once no
+    // matter how many runs use it.
+    const std::pair<const RasteredFontStorage *, uint32_t> key{rasteredFontStorage.get(),
+                                                               rangeIndex};
+    LayoutState &layoutState = *_layoutState;
+    auto it = layoutState.textBatchIndices.find(key);
+    if (it != layoutState.textBatchIndices.end()) {
         return it->second;
     }
 
-    GlyphBufferSharedPtr glyphBuffer = _rasteredFontStorage->rasterizeGlyphRange(rangeIndex);
+    GlyphBufferSharedPtr glyphBuffer = rasteredFontStorage->rasterizeGlyphRange(rangeIndex);
     if (!glyphBuffer) {
-        return nullptr;
+        return INVALID_TEXT_BATCH_INDEX;
     }
-    const TextBatchSharedPtr result = makeTextBatch(glyphBuffer, TEXT_BUFFER_SIZE);
-    ;
-    _cachedTextBatches[rangeIndex] = result;
+    const uint32_t result = static_cast<uint32_t>(layoutState.textBatches.size());
+    layoutState.textBatches.push_back(makeTextBatch(glyphBuffer, TEXT_BUFFER_CAPACITY));
+    layoutState.textBatchIndices[key] = result;
     return result;
 }
 } // namespace rendell_text
@@ -0,0 +1,225 @@
+#include "RasteredFontStorageManager.h"
+#include <algorithm>
+#include <line_break.h>
+#include <rendell_text/TextMeasurer.h>
+#include <unicode.h>
+
+namespace rendell_text {
+static std::shared_ptr<RasteredFontStorageManager> s_rasteredFontStorageManager;
+static uint32_t s_instanceCount{};
+static bool s_initialized = false;
+
+static bool initStaticMeasurerStuff() {
+    s_rasteredFontStorageManager = RasteredFontStorageManager::getShared();
+    return true;
+}
+
+static void releaseStaticMeasurerStuff() {
+    s_rasteredFontStorageManager.reset();
+    s_initialized = false;
+}
+
+TextMeasurer::TextMeasurer() {
+    s_instanceCount++;
+    init();
+}
+
+TextMeasurer::~TextMeasurer() {
+    _rasteredFontStorages.clear();
+    s_rasteredFontStorageManager->clearUnusedCache();
+
+    s_instanceCount--;
+    if (s_instanceCount == 0) {
+        releaseStaticMeasurerStuff();
+    }
+}
+
+bool TextMeasurer::isInitialized() const {
+    return s_initialized;
+}
+
+void TextMeasurer::setFontPath(const std::filesystem::path &fontPath) {
+    if (_fontPath != fontPath) {
+        _fontPath = fontPath;
+        _fontStoragesDirty = true;
+    }
+}
+
+void TextMeasurer::setFontSize(const glm::ivec2 &fontSize) {
+    if (_fontSize != fontSize) {
+        _fontSize = fontSize;
+        _fontStoragesDirty = true;
+    }
+}
+
+void TextMeasurer::setFallbackFontPaths(const std::vector<std::filesystem::path> &fontPaths) {
+    if (_fallbackFontPaths != fontPaths) {
+        _fallbackFontPaths = fontPaths;
+        _fontStoragesDirty = true;
+    }
+}
+
+const std::filesystem::path &TextMeasurer::getFontPath() const {
+    return _fontPath;
+}
+
+glm::ivec2 TextMeasurer::getFontSize() const {
+    return _fontSize;
+}
+
+const std::vector<std::filesystem::path> &TextMeasurer::getFallbackFontPaths() const {
+    return _fallbackFontPaths;
+}
+
+float TextMeasurer::getAdvance(char32_t character) const {
+    updateFontStoragesIfNeeded();
+    if (_rasteredFontStorages.empty()) {
+        return 0.0f;
+    }
+
+    // The same resolution as in TextLayout: the first font with the glyph, else the main font.
+    const RasteredFontStorageSharedPtr *rasteredFontStorage = &_rasteredFontStorages.front();
+    for (const RasteredFontStorageSharedPtr &candidate : _rasteredFontStorages) {
+        if (candidate->getFontRaster()->hasGlyph(character)) {
+            rasteredFontStorage = &candidate;
+            break;
+        }
+    }
+    return static_cast<float>((*rasteredFontStorage)->getGlyphAdvance(character) >> 6);
+}
+
+float TextMeasurer::measureWidth(std::wstring_view text) const {
+    float result = 0.0f;
+    size_t lineStart = 0;
+    while (lineStart <= text.length()) {
+        size_t lineEnd = text.find(L'\n', lineStart);
+        if (lineEnd == std::wstring_view::npos) {
+            lineEnd = text.length();
+        }
+        result = std::max(result, measureLineWidth(text.substr(lineStart, lineEnd - lineStart)));
+        lineStart = lineEnd + 1;
+    }
+    return result;
+}
+
+TextMeasurement TextMeasurer::measure(std::wstring_view text, float maxWidth) const {
+    TextMeasurement result;
+    // The pen after every unit of the paragraph, as TextLayout keeps it: both units of a
+    // surrogate pair share the position after the pair.
+    std::vector<float> penPositions;
+    size_t paragraphStart = 0;
+    while (paragraphStart <= text.length()) {
+        size_t paragraphEnd = text.find(L'\n', paragraphStart);
+        if (paragraphEnd == std::wstring_view::npos) {
+            paragraphEnd = text.length();
+        }
+        const std::wstring_view paragraph =
+            text.substr(paragraphStart, paragraphEnd - paragraphStart);
+
+        penPositions.resize(paragraph.length());
+        float penPosition = 0.0f;
+        size_t i = 0;
+        while (i < paragraph.length()) {
+            const size_t characterIndex = i;
+            penPosition += getAdvance(next_codepoint(paragraph, i));
+            std::fill(penPositions.begin() + characterIndex, penPositions.begin() + i,
+                      penPosition);
+        }
+
+        const size_t firstLine = result.lineStarts.size();
+        result.lineStarts.push_back(0);
+        if (maxWidth > 0.0f) {
+            break_lines(paragraph.data(), penPositions.data(), paragraph.length(), maxWidth, true,
+                        result.lineStarts);
+        }
+        for (size_t line = firstLine; line < result.lineStarts.size(); line++) {
+            const size_t lineStart = result.lineStarts[line];
+            size_t lineEnd = line + 1 < result.lineStarts.size() ? result.lineStarts[line + 1]
+                                                                 : paragraph.length();
+            // The spaces a wrapped line ends with hang past the edge and add no width.
+            if (line + 1 < result.lineStarts.size()) {
+                while (lineEnd > lineStart && paragraph[lineEnd - 1] == L' ') {
+                    lineEnd--;
+                }
+            }
+            const float penStart = lineStart == 0 ? 0.0f : penPositions[lineStart - 1];
+            const float penEnd = lineEnd == lineStart ? penStart : penPositions[lineEnd - 1];
+            result.lineWidths.push_back(penEnd - penStart);
+            result.lineStarts[line] += paragraphStart;
+        }
+        paragraphStart = paragraphEnd + 1;
+    }
+
+    result.width = *std::max_element(result.lineWidths.begin(), result.lineWidths.end());
+    result.height = static_cast<float>(result.lineStarts.size() * _fontSize.y);
+    return result;
+}
+
+size_t TextMeasurer::fitText(std::wstring_view text, float maxWidth) const {
+    float x = 0.0f;
+    size_t i = 0;
+    while (i < text.length()) {
+        size_t next = i;
+        const char32_t character = next_codepoint(text, next);
+        x += getAdvance(character);
+        if (character == '\n' || x > maxWidth) {
+            break;
+        }
+        i = next;
+    }
+    return i;
+}
+
+std::wstring TextMeasurer::truncateText(std::wstring_view text, float maxWidth,
+                                        std::wstring_view ellipsis) const {
+    if (measureLineWidth(text) <= maxWidth) {
+        return std::wstring(text);
+    }
+
+    const float ellipsisWidth = measureLineWidth(ellipsis);
+    std::wstring result(text.substr(0, fitText(text, std::max(maxWidth - ellipsisWidth, 0.0f))));
+    result += ellipsis;
+    return result;
+}
+
+bool TextMeasurer::init() {
+    if (!s_initialized) {
+        s_initialized = initStaticMeasurerStuff();
+    }
+
+    return s_initialized;
+}
+
+void TextMeasurer::updateFontStoragesIfNeeded() const {
+    if (!_fontStoragesDirty) {
+        return;
+    }
+
+    _rasteredFontStorages.clear();
+    if (!_fontPath.empty()) {
+        std::vector<std::filesystem::path> fontPaths{_fontPath};
+        fontPaths.insert(fontPaths.end(), _fallbackFontPaths.begin(), _fallbackFontPaths.end());
+        for (const std::filesystem::path &fontPath : fontPaths) {
+            RasteredFontStoragePreset preset{
+                fontPath.string(),
+                static_cast<uint32_t>(_fontSize.x),
+                static_cast<uint32_t>(_fontSize.y),
+                CHAR_RANGE_SIZE,
+            };
+            _rasteredFontStorages.push_back(
+                s_rasteredFontStorageManager->getRasteredFontStorage(preset));
+        }
+    }
+    s_rasteredFontStorageManager->clearUnusedCache();
+    _fontStoragesDirty = false;
+}
+
+float TextMeasurer::measureLineWidth(std::wstring_view text) const {
+    float result = 0.0f;
+    size_t i = 0;
+    while (i < text.length()) {
+        result += getAdvance(next_codepoint(text, i));
+    }
+    return result;
+}
+} // namespace rendell_text
@@ -1,95 +1,91 @@
 #include <rendell_text/TextRenderer.h>
 
 #include "RasteredFontStorageManager.h"
+#include "RendererUtils.h"
+#include "TextTraceRecorder.h"
+#include "res_Shaders_TextRenderer_copies_vs.h"
+#include "res_Shaders_TextRenderer_bc4_fs.h"
 #include "res_Shaders_TextRenderer_fs.h"
+#include "res_Shaders_TextRenderer_styled_bc4_fs.h"
+#include "res_Shaders_TextRenderer_styled_fs.h"
 #include "res_Shaders_TextRenderer_vs.h"
+#include "res_Shaders_TextSurface_fs.h"
+#include "res_Shaders_TextSurface_vs.h"
 #include <logging.h>
 #include <rendell_text/private/IFontRaster.h>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <fstream>
+#include <limits>
 #include <memory>
 
 #define TEXTURE_ARRAY_BLOCK 0
 #define TEXT_BUFFER_BINDING 0
 #define GLYPH_TRANSFORM_BUFFER_BINDING 1
+#define STYLE_PALETTE_BUFFER_BINDING 2
+#define COPY_BUFFER_BINDING 3
+
+// Bits of a program variant, built from the SHADER_VARIANTS in CMakeLists.txt.
+#define SHADER_VARIANT_COPIES (1 << 0)
+#define SHADER_VARIANT_STYLES (1 << 1)
+#define SHADER_VARIANT_BC4 (1 << 2)
+#define SHADER_VARIANT_COUNT 8
+
+// Kept within the texture size every GL 4.3 driver supports.
+#define MAX_SURFACE_SIZE 8192
 
 namespace rendell_text {
 static rendell::oop::VertexAssemblySharedPtr s_vertexAssembly;
-static rendell::oop::ShaderProgramSharedPtr s_shaderProgram;
+static std::array<rendell::oop::ShaderProgramSharedPtr, SHADER_VARIANT_COUNT> s_shaderPrograms;
+static rendell::oop::ShaderProgramSharedPtr s_surfaceShaderProgram;
 static std::unique_ptr<RasteredFontStorageManager> s_rasteredFontStorageManager;
 static std::unique_ptr<rendell::oop::Mat4Uniform> s_matrixUniform{nullptr};
 static std::unique_ptr<rendell::oop::Float2Uniform> s_fontSizeUniform{nullptr};
 static std::unique_ptr<rendell::oop::Float4Uniform> s_textColorUniform{nullptr};
 static std::unique_ptr<rendell::oop::Float4Uniform> s_backgroundColorUniform{nullptr};
 static std::unique_ptr<rendell::oop::Int1Uniform> s_charFromUniformUniform{nullptr};
+static std::unique_ptr<rendell::oop::Int1Uniform> s_glyphCountUniform{nullptr};
+static std::unique_ptr<rendell::oop::Int1Uniform> s_instanceBaseUniform{nullptr};
+static std::unique_ptr<rendell::oop::Int1Uniform> s_instanceCapacityUniform{nullptr};
+static std::unique_ptr<rendell::oop::Float2Uniform> s_instanceOriginUniform{nullptr};
 static std::unique_ptr<rendell::oop::Sampler2DUniform> s_texturesUniform{nullptr};
+static std::unique_ptr<rendell::oop::Float4Uniform> s_surfaceRectUniform{nullptr};
 static uint32_t s_instanceCount{};
 static bool s_initialized = false;
 
-static rendell::oop::VertexAssemblySharedPtr createVertexAssembly() {
-    static std::vector<float> vertexPos{
-        0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f,
-    };
-    static std::vector<uint32_t> indices{0, 0, 0, 0};
-
-    auto indexBuffer = rendell::oop::makeIndexBuffer(indices.data(), indices.size());
-    auto vertexBuffer = rendell::oop::makeVertexBuffer(vertexPos.data(), vertexPos.size());
-    auto vertexLayout =
-        rendell::VertexLayout().addAttribute(0, rendell::ShaderDataType::float2, false, 0);
-    auto vertexAssembly = rendell::oop::makeVertexAssembly(indexBuffer, std::vector{vertexBuffer},
-                                                           std::vector{vertexLayout});
-    return vertexAssembly;
-}
-
-static rendell::oop::ShaderProgramSharedPtr createShaderProgram(const std::string &vertexSrc,
-                                                                const std::string &fragmentSrc) {
-    auto vertexShader =
-        rendell::oop::makeVertexShader(vertexSrc, [](bool success, const std::string &infoLog) {
-            if (!infoLog.empty()) {
-                if (success) {
-                    RT_WARNING("Vertex shader compilation warning:\n{}", infoLog);
-                } else {
-                    RT_CRITICAL("Vertex shader compilation error:\n{}", infoLog);
-                }
-            }
-            assert(success);
-        });
-
-    auto fragmentShader =
-        rendell::oop::makeFragmentShader(fragmentSrc, [](bool success, const std::string &infoLog) {
-            if (!infoLog.empty()) {
-                if (success) {
-                    RT_WARNING("Fragment shader compilation warning:\n{}", infoLog);
-                } else {
-                    RT_CRITICAL("Fragment shader compilation error:\n{}", infoLog);
-                }
-            }
-            assert(success);
-        });
-
-    auto program = rendell::oop::makeShaderProgram(
-        vertexShader, fragmentShader, [](bool success, const std::string &infoLog) {
-            if (!infoLog.empty()) {
-                if (success) {
-                    RT_WARNING("Shader program linking warning:\n{}", infoLog);
-                } else {
-                    RT_CRITICAL("Shader program linking error:\n{}", infoLog);
-                }
-            }
-            assert(success);
-        });
-
-    return program;
+// Programs are linked on their first draw, so variants and modes no renderer uses cost nothing.
+static const rendell::oop::ShaderProgramSharedPtr &getShaderProgram(uint32_t variant) {
+    rendell::oop::ShaderProgramSharedPtr &shaderProgram = s_shaderPrograms[variant];
+    if (!shaderProgram) {
+        const char *vertexSrc = (variant & SHADER_VARIANT_COPIES)
+                                    ? res_Shaders_TextRenderer_copies_vs
+                                    : res_Shaders_TextRenderer_vs;
+        const char *fragmentSrc = nullptr;
+        if (variant & SHADER_VARIANT_BC4) {
+            fragmentSrc = (variant & SHADER_VARIANT_STYLES) ? res_Shaders_TextRenderer_styled_bc4_fs
+                                                            : res_Shaders_TextRenderer_bc4_fs;
+        } else {
+            fragmentSrc = (variant & SHADER_VARIANT_STYLES) ? res_Shaders_TextRenderer_styled_fs
+                                                            : res_Shaders_TextRenderer_fs;
+        }
+        shaderProgram = createShaderProgram(vertexSrc, fragmentSrc);
+        assert(shaderProgram);
+    }
+    return shaderProgram;
 }
 
-static bool loadShaders(std::string &vertSrcResult, std::string &fragSrcResult) {
-    vertSrcResult = res_Shaders_TextRenderer_vs;
-    fragSrcResult = res_Shaders_TextRenderer_fs;
-
-    return true;
+static const rendell::oop::ShaderProgramSharedPtr &getSurfaceShaderProgram() {
+    if (!s_surfaceShaderProgram) {
+        s_surfaceShaderProgram =
+            createShaderProgram(res_Shaders_TextSurface_vs, res_Shaders_TextSurface_fs);
+        assert(s_surfaceShaderProgram);
+    }
+    return s_surfaceShaderProgram;
 }
 
 static bool initStaticRendererStuff() {
@@ -98,35 +94,168 @@ static bool initStaticRendererStuff() {
     s_vertexAssembly = createVertexAssembly();
     assert(s_vertexAssembly);
 
-    std::string vertexSrc, fragmentSrc;
-    if (!loadShaders(vertexSrc, fragmentSrc)) {
-        RT_ERROR("Shader loading failed");
-        return false;
-    }
-
-    s_shaderProgram = createShaderProgram(vertexSrc, fragmentSrc);
-    assert(s_shaderProgram);
-
     s_matrixUniform = std::make_unique<rendell::oop::Mat4Uniform>("u_Matrix");
     s_fontSizeUniform = std::make_unique<rendell::oop::Float2Uniform>("u_FontSize");
     s_textColorUniform = std::make_unique<rendell::oop::Float4Uniform>("u_TextColor");
     s_backgroundColorUniform = std::make_unique<rendell::oop::Float4Uniform>("u_BackgroundColor");
     s_charFromUniformUniform = std::make_unique<rendell::oop::Int1Uniform>("u_CharFrom");
+    s_glyphCountUniform = std::make_unique<rendell::oop::Int1Uniform>("u_GlyphCount");
+    s_instanceBaseUniform = std::make_unique<rendell::oop::Int1Uniform>("u_InstanceBase");
+    s_instanceCapacityUniform = std::make_unique<rendell::oop::Int1Uniform>("u_InstanceCapacity");
+    s_instanceOriginUniform = std::make_unique<rendell::oop::Float2Uniform>("u_InstanceOrigin");
     s_texturesUniform = std::make_unique<rendell::oop::Sampler2DUniform>("u_Textures");
+    s_surfaceRectUniform = std::make_unique<rendell::oop::Float4Uniform>("u_SurfaceRect");
+
+    return true;
+}
+
+// Blends one fragment of TextRenderer.fs over the surface the way alpha blending would.
+static void blendSurfacePixel(uint8_t *pixel, const glm::vec4 &color) {
+    const float alpha = std::clamp(color.a, 0.0f, 1.0f);
+    const float destinationAlpha = pixel[3] / 255.0f;
+    const float destinationWeight = destinationAlpha * (1.0f - alpha);
+    const float resultAlpha = alpha + destinationWeight;
+    for (int i = 0; i < 3; i++) {
+        const float destination = pixel[i] / 255.0f;
+        float result = color[i] * alpha + destination * destinationWeight;
+        result = resultAlpha > 0.0f ? std::clamp(result / resultAlpha, 0.0f, 1.0f) : 0.0f;
+        pixel[i] = static_cast<uint8_t>(std::lround(result * 255.0f));
+    }
+    pixel[3] = static_cast<uint8_t>(std::lround(resultAlpha * 255.0f));
+}
+
+// Runs TextRenderer.vs and TextRenderer.fs for every instance on the CPU, one texel per layout
+// unit, which is the resolution the glyph pages are sampled at. Returns false for layouts that
+// draw nothing or whose surface would be larger than maxBytes.
+static bool composeTextSurface(const TextLayout &textLayout, const TextSurfaceKey &key,
+                               size_t maxBytes, TextSurface &result) {
+    struct BatchInstances {
+        const GlyphBuffer *glyphBuffer{};
+        std::vector<uint32_t> packedCharacters{};
+        std::vector<glm::vec4> transforms{};
+    };
+
+    const glm::vec2 instanceOrigin = textLayout.getInstanceOrigin();
+    std::vector<BatchInstances> batches;
+    float left = std::numeric_limits<float>::max();
+    float bottom = std::numeric_limits<float>::max();
+    float right = std::numeric_limits<float>::lowest();
+    float top = std::numeric_limits<float>::lowest();
+    for (const TextBatchSharedPtr &textBatch : textLayout.getTextBatchesForRendering()) {
+        const TextBuffer &textBuffer = textBatch->getTextBuffer();
+        BatchInstances &batch = batches.emplace_back();
+        batch.glyphBuffer = textBatch->getGlyphBuffer();
+        batch.packedCharacters.resize(textBuffer.getCurrentLength());
+        batch.transforms.resize(textBuffer.getCurrentLength());
+        textBuffer.copyInstances(batch.packedCharacters.data(), batch.transforms.data());
+        for (glm::vec4 &transform : batch.transforms) {
+            transform.x -= instanceOrigin.x;
+            transform.y -= instanceOrigin.y;
+            if (transform.z > 0.0f && transform.w > 0.0f) {
+                left = std::min(left, transform.x);
+                bottom = std::min(bottom, transform.y);
+                right = std::max(right, transform.x + transform.z);
+                top = std::max(top, transform.y + transform.w);
+            }
+        }
+    }
+    if (left > right) {
+        return false;
+    }
+
+    const glm::vec2 origin(std::floor(left), std::floor(bottom));
+    const glm::vec2 size(std::ceil(right) - origin.x, std::ceil(top) - origin.y);
+    if (size.x > MAX_SURFACE_SIZE || size.y > MAX_SURFACE_SIZE) {
+        return false;
+    }
+    const int width = static_cast<int>(size.x);
+    const int height = static_cast<int>(size.y);
+    const size_t byteSize = static_cast<size_t>(width) * height * 4;
+    if (byteSize > maxBytes) {
+        return false;
+    }
+
+    // Rows go from the top down, like the rows of the glyph pages.
+    const std::vector<TextStyle> &stylePalette = textLayout.getStylePalette();
+    std::vector<uint8_t> pixels(byteSize, 0);
+    for (const BatchInstances &batch : batches) {
+        const GlyphBitmapPage &bitmapPage = batch.glyphBuffer->getBitmapPage();
+        const char32_t charFrom = batch.glyphBuffer->getRange().first;
+        for (size_t i = 0; i < batch.transforms.size(); i++) {
+            const uint32_t packedCharacter = batch.packedCharacters[i];
+            const glm::vec4 &transform = batch.transforms[i];
+            const uint32_t styleIndex =
+                (packedCharacter >> INSTANCE_STYLE_SHIFT) & MAX_INSTANCE_STYLE_INDEX;
+            glm::vec4 textColor = key.color;
+            glm::vec4 backgroundColor = key.backgroundColor;
+            if (styleIndex != 0) {
+                textColor = stylePalette[styleIndex].color;
+                backgroundColor = stylePalette[styleIndex].backgroundColor;
+            }
+
+            const int quadLeft = static_cast<int>(std::lround(transform.x - origin.x));
+            const int quadTop =
+                height - static_cast<int>(std::lround(transform.y + transform.w - origin.y));
+            const int quadWidth = static_cast<int>(std::lround(transform.z));
+            const int quadHeight = static_cast<int>(std::lround(transform.w));
+            const bool isRect = (packedCharacter & INSTANCE_RECT_FLAG) != 0;
+            const uint8_t *glyphPixels = nullptr;
+            if (!isRect) {
+                const char32_t character = packedCharacter & INSTANCE_CODEPOINT_MASK;
+                glyphPixels = bitmapPage.getGlyphPixels(character - charFrom);
+            }
+
+            for (int y = std::max(0, -quadTop); y < quadHeight && quadTop + y < height; y++) {
+                for (int x = std::max(0, -quadLeft); x < quadWidth && quadLeft + x < width; x++) {
+                    glm::vec4 color;
+                    if (isRect) {
+                        const RectKind rectKind =
+                            static_cast<RectKind>(packedCharacter & INSTANCE_CODEPOINT_MASK);
+                        color = rectKind == RectKind::Background ? backgroundColor : textColor;
+                    } else if (static_cast<uint32_t>(x) < bitmapPage.glyphWidth &&
+                               static_cast<uint32_t>(y) < bitmapPage.glyphHeight) {
+                        const float sampled = glyphPixels[y * bitmapPage.glyphWidth + x] / 255.0f;
+                        const float sampledInverse = 1.0f - sampled;
+                        for (int i = 0; i < 3; i++) {
+                            color[i] = textColor[i] * sampled + backgroundColor[i] * sampledInverse;
+                        }
+                        color.a = textColor.a + backgroundColor.a * sampledInverse;
+                    } else {
+                        continue;
+                    }
+                    const size_t pixelIndex =
+                        static_cast<size_t>(quadTop + y) * width + (quadLeft + x);
+                    blendSurfacePixel(pixels.data() + pixelIndex * 4, color);
+                }
+            }
+        }
+    }
 
+    result.key = key;
+    result.rect = glm::vec4(origin, size);
+    result.byteSize = byteSize;
+    result.texture =
+        rendell::oop::makeTexture2DArray(width, height, 1, rendell::TextureFormat::RGBA);
+    result.texture->setSubData(0, width, height, pixels.data());
     return true;
 }
 
 static void releaseStaticRendererStuff() {
     s_rasteredFontStorageManager.reset(nullptr);
     s_vertexAssembly.reset();
-    s_shaderProgram.reset();
+    s_shaderPrograms.fill(nullptr);
+    s_surfaceShaderProgram.reset();
     s_matrixUniform.reset();
     s_fontSizeUniform.reset();
     s_textColorUniform.reset();
     s_backgroundColorUniform.reset();
     s_charFromUniformUniform.reset();
+    s_glyphCountUniform.reset();
+    s_instanceBaseUniform.reset();
+    s_instanceCapacityUniform.reset();
+    s_instanceOriginUniform.reset();
     s_texturesUniform.reset();
+    s_surfaceRectUniform.reset();
 
     s_initialized = false;
 }
@@ -137,6 +266,10 @@ TextRenderer::TextRenderer() {
 }
 
 TextRenderer::~TextRenderer() {
+    RT_TRACE_CALL(RendererDestroy);
+    _copyBuffer.reset();
+    setCached(false);
+
     s_instanceCount--;
     if (s_instanceCount == 0) {
         releaseStaticRendererStuff();
@@ -152,18 +285,22 @@ const TextLayoutSharedPtr &TextRenderer::getTextLayout() const {
 }
 
 void TextRenderer::setTextLayout(const TextLayoutSharedPtr &textLayout) {
+    RT_TRACE_CALL(RendererSetTextLayout, textLayout);
     _textLayout = textLayout;
 }
 
 void TextRenderer::setMatrix(const glm::mat4 &matrix) {
+    RT_TRACE_CALL(RendererSetMatrix, matrix);
     _matrix = matrix;
 }
 
 void TextRenderer::setColor(const glm::vec4 &color) {
+    RT_TRACE_CALL(RendererSetColor, color);
     _color = color;
 }
 
 void TextRenderer::setBackgroundColor(const glm::vec4 backgroundColor) {
+    RT_TRACE_CALL(RendererSetBackgroundColor, backgroundColor);
     _backgroundColor = backgroundColor;
 }
 
@@ -171,30 +308,122 @@ const glm::vec4 &TextRenderer::getColor() const {
     return _color;
 }
 
+void TextRenderer::setCached(bool cached) {
+    RT_TRACE_CALL(RendererSetCached, cached);
+    if (cached && !_surfaceCache) {
+        _surfaceCache = TextSurfaceCache::getShared();
+    } else if (!cached && _surfaceCache) {
+        _surfaceCache->erase(this);
+        _surfaceCache.reset();
+        _rejectedSurfaceKey = {};
+    }
+}
+
+bool TextRenderer::isCached() const {
+    return _surfaceCache != nullptr;
+}
+
 void TextRenderer::draw() {
+    RT_TRACE_CALL(RendererDraw);
     if (!_textLayout || _textLayout->getText().length() == 0) {
         return;
     }
 
     _textLayout->update();
+    if (!_surfaceCache || !drawSurface()) {
+        drawBatches(0);
+    }
+}
 
+void TextRenderer::drawCopies(std::span<const TextCopy> copies) {
+    RT_TRACE_CALL(RendererDrawCopies, copies);
+    if (!_textLayout || _textLayout->getText().length() == 0 || copies.empty()) {
+        return;
+    }
+
+    _textLayout->update();
+
+    const size_t copiesSize = copies.size_bytes();
+    const rendell::byte_t *copiesData = reinterpret_cast<const rendell::byte_t *>(copies.data());
+    if (!_copyBuffer || _copyBuffer.getSize() < copiesSize) {
+        _copyBuffer = ShaderBufferPool::getShared()->acquire(copiesSize, copiesData, copiesSize);
+    } else {
+        _copyBuffer->setSubData(copiesData, copiesSize);
+    }
+    drawBatches(static_cast<uint32_t>(copies.size()));
+}
+
+void TextRenderer::drawBatches(uint32_t copyCount) {
+    const bool styled = _textLayout->getStylePalette().size() > 1;
+    const uint32_t baseVariant =
+        (copyCount > 0 ? SHADER_VARIANT_COPIES : 0) | (styled ? SHADER_VARIANT_STYLES : 0);
     for (const TextBatchSharedPtr &textBatch : _textLayout->getTextBatchesForRendering()) {
         const GlyphBuffer *glyphBuffer = textBatch->getGlyphBuffer();
-        for (const std::unique_ptr<TextBuffer> &textBuffer : textBatch->getTextBuffers()) {
-            s_shaderProgram->use();
-            s_vertexAssembly->use();
-            glyphBuffer->use(s_texturesUniform->getId(), TEXTURE_ARRAY_BLOCK);
-            textBuffer->use(TEXT_BUFFER_BINDING, GLYPH_TRANSFORM_BUFFER_BINDING);
-            setUniforms();
-            s_charFromUniformUniform->set(glyphBuffer->getRange().first);
-            const uint32_t instanceCount = static_cast<uint32_t>(textBuffer->getCurrentLength());
-            rendell::setDrawType(rendell::DrawMode::ArraysInstanced,
-                                 rendell::PrimitiveTopology::TriangleStrip, instanceCount);
-            rendell::submit();
+        const TextBuffer &textBuffer = textBatch->getTextBuffer();
+        const uint32_t glyphCount = static_cast<uint32_t>(textBuffer.getCurrentLength());
+        if (glyphCount == 0) {
+            continue;
+        }
+
+        // Font runs can mix block compressed and plain pages.
+        const uint32_t variant =
+            baseVariant | (glyphBuffer->isBlockCompressed() ? SHADER_VARIANT_BC4 : 0);
+        getShaderProgram(variant)->use();
+        s_vertexAssembly->use();
+        glyphBuffer->use(s_texturesUniform->getId(), TEXTURE_ARRAY_BLOCK);
+        textBuffer.use(TEXT_BUFFER_BINDING, GLYPH_TRANSFORM_BUFFER_BINDING);
+        if (styled) {
+            _textLayout->useStylePalette(STYLE_PALETTE_BUFFER_BINDING);
+        }
+        setUniforms();
+        // Font runs draw their own pages, so the UV scale follows the batch, not the layout.
+        const GlyphBitmapPage &bitmapPage = glyphBuffer->getBitmapPage();
+        s_fontSizeUniform->set(static_cast<float>(bitmapPage.glyphWidth),
+                               static_cast<float>(bitmapPage.glyphHeight));
+        s_charFromUniformUniform->set(glyphBuffer->getRange().first);
+        s_glyphCountUniform->set(static_cast<int>(glyphCount));
+        s_instanceBaseUniform->set(static_cast<int>(textBuffer.getBase()));
+        s_instanceCapacityUniform->set(static_cast<int>(textBuffer.getCapacity()));
+        if (copyCount > 0) {
+            _copyBuffer->use(COPY_BUFFER_BINDING);
         }
+        rendell::setDrawType(rendell::DrawMode::ArraysInstanced,
+                             rendell::PrimitiveTopology::TriangleStrip,
+                             glyphCount * std::max(copyCount, 1u));
+        rendell::submit();
     }
 }
 
+bool TextRenderer::drawSurface() {
+    const TextSurfaceKey key{_textLayout->getRevision(), _color, _backgroundColor};
+    if (key == _rejectedSurfaceKey) {
+        return false;
+    }
+
+    const TextSurface *surface = _surfaceCache->find(this, key);
+    if (!surface) {
+        TextSurface newSurface;
+        if (composeTextSurface(*_textLayout, key, _surfaceCache->getMaxBytes(), newSurface)) {
+            surface = _surfaceCache->insert(this, std::move(newSurface));
+        }
+        if (!surface) {
+            _rejectedSurfaceKey = key;
+            return false;
+        }
+    }
+
+    getSurfaceShaderProgram()->use();
+    s_vertexAssembly->use();
+    surface->texture->use(s_texturesUniform->getId(), TEXTURE_ARRAY_BLOCK);
+    s_matrixUniform->set(glm::value_ptr(_matrix));
+    s_surfaceRectUniform->set(surface->rect.x, surface->rect.y, surface->rect.z,
+                              surface->rect.w);
+    rendell::setDrawType(rendell::DrawMode::ArraysInstanced,
+                         rendell::PrimitiveTopology::TriangleStrip, 1);
+    rendell::submit();
+    return true;
+}
+
 bool TextRenderer::init() {
     if (!s_initialized) {
         s_initialized = initStaticRendererStuff();
@@ -208,11 +437,10 @@ bool TextRenderer::init() {
 }
 
 void TextRenderer::setUniforms() {
-    const glm::ivec2 fontSize = _textLayout->getFontSize();
-
     s_matrixUniform->set(glm::value_ptr(_matrix));
-    s_fontSizeUniform->set(static_cast<float>(fontSize.x), static_cast<float>(fontSize.y));
     s_textColorUniform->set(_color.r, _color.g, _color.b, _color.a);
+    const glm::vec2 instanceOrigin = _textLayout->getInstanceOrigin();
+    s_instanceOriginUniform->set(instanceOrigin.x, instanceOrigin.y);
     s_backgroundColorUniform->set(_backgroundColor.r, _backgroundColor.g, _backgroundColor.b,
                                   _backgroundColor.a);
 }
@@ -0,0 +1,75 @@
+#include <rendell_text/private/TextSurfaceCache.h>
+#include <shared_instance.h>
+
+namespace rendell_text {
+std::shared_ptr<TextSurfaceCache> TextSurfaceCache::getShared() {
+    return getSharedInstance<TextSurfaceCache>();
+}
+
+void TextSurfaceCache::setMaxBytes(size_t maxBytes) {
+    _maxBytes = maxBytes;
+    trimToBudget(_maxBytes);
+}
+
+size_t TextSurfaceCache::getMaxBytes() const {
+    return _maxBytes;
+}
+
+void TextSurfaceCache::trim() {
+    trimToBudget(0);
+}
+
+TextSurfaceCacheStats TextSurfaceCache::getStats() const {
+    return _stats;
+}
+
+const TextSurface *TextSurfaceCache::find(const TextRenderer *owner, const TextSurfaceKey &key) {
+    const auto it = _entryIndices.find(owner);
+    if (it == _entryIndices.end()) {
+        _stats.missCount++;
+        return nullptr;
+    }
+    if (it->second->surface.key != key) {
+        _stats.missCount++;
+        erase(owner);
+        return nullptr;
+    }
+
+    _entries.splice(_entries.begin(), _entries, it->second);
+    _stats.hitCount++;
+    return &it->second->surface;
+}
+
+const TextSurface *TextSurfaceCache::insert(const TextRenderer *owner, TextSurface &&surface) {
+    erase(owner);
+    if (surface.byteSize > _maxBytes) {
+        return nullptr;
+    }
+
+    _stats.surfaceCount++;
+    _stats.bytes += surface.byteSize;
+    _entries.push_front({owner, std::move(surface)});
+    _entryIndices[owner] = _entries.begin();
+    // The new surface is the most recent one and fits, so it survives the trim.
+    trimToBudget(_maxBytes);
+    return &_entries.front().surface;
+}
+
+void TextSurfaceCache::erase(const TextRenderer *owner) {
+    const auto it = _entryIndices.find(owner);
+    if (it == _entryIndices.end()) {
+        return;
+    }
+
+    _stats.surfaceCount--;
+    _stats.bytes -= it->second->surface.byteSize;
+    _entries.erase(it->second);
+    _entryIndices.erase(it);
+}
+
+void TextSurfaceCache::trimToBudget(size_t maxBytes) {
+    while (!_entries.empty() && _stats.bytes > maxBytes) {
+        erase(_entries.back().owner);
+    }
+}
+} // namespace rendell_text
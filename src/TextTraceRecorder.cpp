@@ -0,0 +1,282 @@
+#include "TextTraceRecorder.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <logging.h>
+#include <map>
+#include <mutex>
+#include <unicode.h>
+
+#define TRACE_FLUSH_SIZE (1 << 20)
+
+namespace rendell_text {
+struct TextTraceRecorder {
+    std::mutex mutex{};
+    std::ofstream stream{};
+    std::vector<uint8_t> buffer{};
+    std::map<const void *, uint64_t> objectIds{};
+    uint64_t lastObjectId{};
+    std::chrono::steady_clock::time_point lastStart{};
+};
+
+static std::atomic<bool> s_recording{false};
+static thread_local uint32_t s_callDepth = 0;
+
+static TextTraceRecorder &getRecorder() {
+    static TextTraceRecorder s_recorder;
+    return s_recorder;
+}
+
+static void appendVarint(std::vector<uint8_t> &data, uint64_t value) {
+    while (value >= 0x80) {
+        data.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    data.push_back(static_cast<uint8_t>(value));
+}
+
+// The recorder mutex has to be held.
+static uint64_t getObjectId(TextTraceRecorder &recorder, const void *object) {
+    if (!object) {
+        return 0;
+    }
+    const auto [it, inserted] = recorder.objectIds.try_emplace(object, 0);
+    if (inserted) {
+        it->second = ++recorder.lastObjectId;
+    }
+    return it->second;
+}
+
+static void flush(TextTraceRecorder &recorder) {
+    recorder.stream.write(reinterpret_cast<const char *>(recorder.buffer.data()),
+                          static_cast<std::streamsize>(recorder.buffer.size()));
+    recorder.buffer.clear();
+}
+
+void TextTraceArgumentWriter::writeVarint(uint64_t value) {
+    appendVarint(_data, value);
+}
+
+void TextTraceArgumentWriter::writeInt(int64_t value) {
+    // Zigzag, so small negative values stay short.
+    writeVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void TextTraceArgumentWriter::writeFloat(float value) {
+    uint8_t bytes[sizeof(float)];
+    std::memcpy(bytes, &value, sizeof(float));
+    _data.insert(_data.end(), bytes, bytes + sizeof(float));
+}
+
+void TextTraceArgumentWriter::writeText(std::wstring_view text) {
+    size_t codepointCount = 0;
+    for (size_t i = 0; i < text.length(); codepointCount++) {
+        next_codepoint(text, i);
+    }
+    writeVarint(codepointCount);
+    for (size_t i = 0; i < text.length();) {
+        writeVarint(next_codepoint(text, i));
+    }
+}
+
+void TextTraceArgumentWriter::writeText(std::u8string_view text) {
+    _decodedText.clear();
+    append_utf8(_decodedText, text);
+    writeText(std::wstring_view(_decodedText));
+}
+
+void TextTraceArgumentWriter::writeText(std::u32string_view text) {
+    writeVarint(text.length());
+    for (const char32_t codepoint : text) {
+        writeVarint(codepoint);
+    }
+}
+
+void TextTraceArgumentWriter::writePath(const std::filesystem::path &path) {
+    const std::u8string value = path.u8string();
+    writeVarint(value.length());
+    _data.insert(_data.end(), value.begin(), value.end());
+}
+
+void TextTraceArgumentWriter::writeObject(const void *object) {
+    TextTraceRecorder &recorder = getRecorder();
+    const std::lock_guard lock(recorder.mutex);
+    writeVarint(getObjectId(recorder, object));
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, size_t value) {
+    writer.writeVarint(value);
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, bool value) {
+    writer.writeVarint(value ? 1 : 0);
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, float value) {
+    writer.writeFloat(value);
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, WrapMode value) {
+    writer.writeVarint(static_cast<uint64_t>(value));
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, const glm::ivec2 &value) {
+    writer.writeInt(value.x);
+    writer.writeInt(value.y);
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, const glm::vec2 &value) {
+    writer.writeFloat(value.x);
+    writer.writeFloat(value.y);
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, const glm::vec4 &value) {
+    for (int i = 0; i < 4; i++) {
+        writer.writeFloat(value[i]);
+    }
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, const glm::mat4 &value) {
+    for (int i = 0; i < 4; i++) {
+        write_text_trace_argument(writer, value[i]);
+    }
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, const TextStyle &value) {
+    write_text_trace_argument(writer, value.color);
+    write_text_trace_argument(writer, value.backgroundColor);
+    writer.writeVarint((value.underline ? 1 : 0) | (value.strikethrough ? 2 : 0));
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, std::wstring_view value) {
+    writer.writeText(value);
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, std::u8string_view value) {
+    writer.writeText(value);
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, std::u32string_view value) {
+    writer.writeText(value);
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer,
+                               const std::filesystem::path &value) {
+    writer.writePath(value);
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer,
+                               const std::vector<std::filesystem::path> &value) {
+    writer.writeVarint(value.size());
+    for (const std::filesystem::path &path : value) {
+        writer.writePath(path);
+    }
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, const TextLayoutSharedPtr &value) {
+    writer.writeObject(value.get());
+}
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, std::span<const TextCopy> value) {
+    writer.writeVarint(value.size());
+    for (const TextCopy &copy : value) {
+        write_text_trace_argument(writer, copy.matrix);
+        write_text_trace_argument(writer, copy.color);
+    }
+}
+
+bool TextTraceScope::begin() {
+    s_callDepth++;
+    _recorded = s_callDepth == 1 && s_recording.load(std::memory_order_relaxed);
+    return _recorded;
+}
+
+TextTraceScope::~TextTraceScope() {
+    s_callDepth--;
+    if (!_recorded) {
+        return;
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    TextTraceRecorder &recorder = getRecorder();
+    const std::lock_guard lock(recorder.mutex);
+    // The trace was stopped during the call.
+    if (!recorder.stream.is_open()) {
+        return;
+    }
+
+    const std::vector<uint8_t> &arguments = getArgumentWriter().getData();
+    std::vector<uint8_t> &buffer = recorder.buffer;
+    appendVarint(buffer, static_cast<uint64_t>(_call));
+    appendVarint(buffer, getObjectId(recorder, _object));
+    // Calls of other threads may have started later but finished first.
+    const auto startDelta =
+        std::max(_start - recorder.lastStart, std::chrono::steady_clock::duration::zero());
+    const auto duration = end - _start;
+    appendVarint(buffer,
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(startDelta).count());
+    appendVarint(buffer, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    appendVarint(buffer, arguments.size());
+    buffer.insert(buffer.end(), arguments.begin(), arguments.end());
+    recorder.lastStart = std::max(recorder.lastStart, _start);
+
+    if (_call == TextTraceCall::LayoutDestroy || _call == TextTraceCall::RendererDestroy) {
+        // The address may be reused by a new object, which gets a new id.
+        recorder.objectIds.erase(_object);
+    }
+    if (buffer.size() >= TRACE_FLUSH_SIZE) {
+        flush(recorder);
+    }
+}
+
+TextTraceArgumentWriter &TextTraceScope::getArgumentWriter() {
+    static thread_local TextTraceArgumentWriter s_argumentWriter;
+    return s_argumentWriter;
+}
+
+bool startTextTrace([[maybe_unused]] const std::filesystem::path &tracePath) {
+#ifdef RENDELL_TEXT_TRACE
+    TextTraceRecorder &recorder = getRecorder();
+    const std::lock_guard lock(recorder.mutex);
+    if (recorder.stream.is_open()) {
+        RT_WARNING("A text trace is already being recorded");
+        return false;
+    }
+
+    recorder.stream.open(tracePath, std::ios::binary | std::ios::trunc);
+    if (!recorder.stream) {
+        RT_ERROR("Failed to open the text trace {}", tracePath.string());
+        recorder.stream.close();
+        return false;
+    }
+    recorder.buffer.clear();
+    appendVarint(recorder.buffer, TEXT_TRACE_MAGIC);
+    appendVarint(recorder.buffer, TEXT_TRACE_VERSION);
+    recorder.objectIds.clear();
+    recorder.lastObjectId = 0;
+    recorder.lastStart = std::chrono::steady_clock::now();
+    s_recording = true;
+    return true;
+#else
+    RT_WARNING("Text traces are recorded by builds with RENDELL_TEXT_ENABLE_TRACE only");
+    return false;
+#endif
+}
+
+void stopTextTrace() {
+    TextTraceRecorder &recorder = getRecorder();
+    const std::lock_guard lock(recorder.mutex);
+    if (!recorder.stream.is_open()) {
+        return;
+    }
+    s_recording = false;
+    flush(recorder);
+    recorder.stream.close();
+    recorder.objectIds.clear();
+}
+
+bool isTextTraceRecording() {
+    return s_recording;
+}
+} // namespace rendell_text
@@ -0,0 +1,93 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <glm/glm.hpp>
+#include <rendell_text/TextLayout.h>
+#include <rendell_text/TextRenderer.h>
+#include <rendell_text/TextStyle.h>
+#include <span>
+#include <string_view>
+#include <text_trace.h>
+#include <vector>
+
+namespace rendell_text {
+// Argument encoding of the trace records, read back by TextTraceReplay.cpp.
+class TextTraceArgumentWriter final {
+public:
+    void writeVarint(uint64_t value);
+    void writeInt(int64_t value);
+    void writeFloat(float value);
+    // Texts are stored as codepoints, whatever encoding they were passed in.
+    void writeText(std::wstring_view text);
+    void writeText(std::u8string_view text);
+    void writeText(std::u32string_view text);
+    void writePath(const std::filesystem::path &path);
+    void writeObject(const void *object);
+
+    void clear() { _data.clear(); }
+    const std::vector<uint8_t> &getData() const { return _data; }
+
+private:
+    std::vector<uint8_t> _data{};
+    std::wstring _decodedText{};
+};
+
+void write_text_trace_argument(TextTraceArgumentWriter &writer, size_t value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer, bool value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer, float value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer, WrapMode value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer, const glm::ivec2 &value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer, const glm::vec2 &value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer, const glm::vec4 &value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer, const glm::mat4 &value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer, const TextStyle &value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer, std::wstring_view value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer, std::u8string_view value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer, std::u32string_view value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer,
+                               const std::filesystem::path &value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer,
+                               const std::vector<std::filesystem::path> &value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer, const TextLayoutSharedPtr &value);
+void write_text_trace_argument(TextTraceArgumentWriter &writer, std::span<const TextCopy> value);
+
+// Records one call for as long as it is in scope. Only the outermost call of a thread is
+// recorded, the calls it makes into the library are part of its latency.
+class TextTraceScope final {
+public:
+    template <typename... Args>
+    TextTraceScope(TextTraceCall call, const void *object, const Args &...args) {
+        if (begin()) {
+            _call = call;
+            _object = object;
+            TextTraceArgumentWriter &writer = getArgumentWriter();
+            writer.clear();
+            (write_text_trace_argument(writer, args), ...);
+            _start = std::chrono::steady_clock::now();
+        }
+    }
+    ~TextTraceScope();
+
+    TextTraceScope(const TextTraceScope &) = delete;
+    TextTraceScope &operator=(const TextTraceScope &) = delete;
+
+private:
+    // Enters the call, returns true when it is recorded.
+    bool begin();
+    static TextTraceArgumentWriter &getArgumentWriter();
+
+    TextTraceCall _call{};
+    const void *_object{};
+    bool _recorded{};
+    std::chrono::steady_clock::time_point _start{};
+};
+} // namespace rendell_text
+
+#ifdef RENDELL_TEXT_TRACE
+#define RT_TRACE_CALL(call, ...)                                                                   \
+    const rendell_text::TextTraceScope rtTraceScope(rendell_text::TextTraceCall::call,             \
+                                                    this __VA_OPT__(, ) __VA_ARGS__)
+#else
+#define RT_TRACE_CALL(call, ...)
+#endif
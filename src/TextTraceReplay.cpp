@@ -0,0 +1,446 @@
+#include <chrono>
+#include <cstring>
+#include <logging.h>
+#include <map>
+#include <rendell_text/TextLayout.h>
+#include <rendell_text/TextRenderer.h>
+#include <rendell_text/TextTrace.h>
+#include <text_trace.h>
+#include <unicode.h>
+
+namespace rendell_text {
+// Reads the arguments written by TextTraceArgumentWriter.
+class TextTraceArgumentReader final {
+public:
+    TextTraceArgumentReader(std::span<const uint8_t> data) : _data(data) {}
+
+    bool readVarint(uint64_t &value) { return read_text_trace_varint(_data, _offset, value); }
+
+    bool readSize(size_t &value) {
+        uint64_t result{};
+        if (!readVarint(result)) {
+            return false;
+        }
+        value = static_cast<size_t>(result);
+        return true;
+    }
+
+    bool readInt(int &value) {
+        uint64_t result{};
+        if (!readVarint(result)) {
+            return false;
+        }
+        const int64_t magnitude = static_cast<int64_t>(result >> 1);
+        value = static_cast<int>(magnitude ^ -static_cast<int64_t>(result & 1));
+        return true;
+    }
+
+    bool readFloat(float &value) {
+        if (sizeof(float) > _data.size() - _offset) {
+            return false;
+        }
+        std::memcpy(&value, _data.data() + _offset, sizeof(float));
+        _offset += sizeof(float);
+        return true;
+    }
+
+    bool readVec2(glm::vec2 &value) { return readFloat(value.x) && readFloat(value.y); }
+
+    bool readIvec2(glm::ivec2 &value) { return readInt(value.x) && readInt(value.y); }
+
+    bool readVec4(glm::vec4 &value) {
+        for (int i = 0; i < 4; i++) {
+            if (!readFloat(value[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool readMat4(glm::mat4 &value) {
+        for (int i = 0; i < 4; i++) {
+            if (!readVec4(value[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The count is checked against the remaining bytes before anything is allocated, every
+    // codepoint takes at least one.
+    bool readText(std::u32string &codepoints, std::wstring &text) {
+        size_t count{};
+        if (!readSize(count) || count > _data.size() - _offset) {
+            return false;
+        }
+        codepoints.resize(count);
+        for (char32_t &codepoint : codepoints) {
+            uint64_t value{};
+            if (!readVarint(value)) {
+                return false;
+            }
+            codepoint = static_cast<char32_t>(value);
+        }
+        text.clear();
+        append_utf32(text, codepoints);
+        return true;
+    }
+
+    bool readPath(std::filesystem::path &path) {
+        size_t length{};
+        if (!readSize(length) || length > _data.size() - _offset) {
+            return false;
+        }
+        const char8_t *begin = reinterpret_cast<const char8_t *>(_data.data() + _offset);
+        path = std::u8string_view(begin, length);
+        _offset += length;
+        return true;
+    }
+
+private:
+    std::span<const uint8_t> _data;
+    size_t _offset{};
+};
+
+// Runs the recorded calls, with the objects of the trace mapped to new ones by their ids.
+class TextTraceReplayer final {
+public:
+    TextTraceReplayer(TextTraceReport &report, TextTraceReplayMode mode)
+        : _report(report)
+        , _mode(mode) {}
+
+    bool replay(const TextTraceRecord &record);
+
+private:
+    bool replayLayoutCall(const TextTraceRecord &record, TextTraceArgumentReader &reader);
+    bool replayRendererCall(const TextTraceRecord &record, TextTraceArgumentReader &reader);
+
+    const TextLayoutSharedPtr &getLayout(uint64_t objectId);
+    const TextRendererSharedPtr &getRenderer(uint64_t objectId);
+
+    // Only the call itself is measured, its arguments are decoded beforehand.
+    template <typename Call> void measure(TextTraceCall call, Call &&function) {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const auto end = std::chrono::steady_clock::now();
+        add_text_trace_sample(
+            _report, call,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    TextTraceReport &_report;
+    TextTraceReplayMode _mode{};
+    std::map<uint64_t, TextLayoutSharedPtr> _layouts{};
+    std::map<uint64_t, TextRendererSharedPtr> _renderers{};
+    std::u32string _codepoints{};
+    std::wstring _text{};
+    std::filesystem::path _path{};
+    std::vector<std::filesystem::path> _paths{};
+    std::vector<TextCopy> _copies{};
+    // Keeps the results of the queries alive.
+    size_t _resultSink{};
+};
+
+bool TextTraceReplayer::replay(const TextTraceRecord &record) {
+    if (_mode == TextTraceReplayMode::Headless &&
+        (record.call == TextTraceCall::LayoutUpdate || !is_text_trace_layout_call(record.call))) {
+        // These upload or draw. The layout queries of the trace still run the layout pass.
+        return true;
+    }
+    TextTraceArgumentReader reader(record.arguments);
+    return is_text_trace_layout_call(record.call) ? replayLayoutCall(record, reader)
+                                                  : replayRendererCall(record, reader);
+}
+
+bool TextTraceReplayer::replayLayoutCall(const TextTraceRecord &record,
+                                         TextTraceArgumentReader &reader) {
+    const TextTraceCall call = record.call;
+    if (call == TextTraceCall::LayoutDestroy) {
+        // A renderer holding the layout keeps it alive, as it did when the trace was recorded.
+        TextLayoutSharedPtr layout = std::move(_layouts[record.objectId]);
+        _layouts.erase(record.objectId);
+        measure(call, [&] { layout.reset(); });
+        return true;
+    }
+
+    TextLayout &layout = *getLayout(record.objectId);
+    size_t index{};
+    size_t count{};
+    switch (call) {
+    case TextTraceCall::LayoutUpdate:
+        measure(call, [&] { layout.update(); });
+        return true;
+    case TextTraceCall::LayoutSetFontPath:
+        if (!reader.readPath(_path)) {
+            return false;
+        }
+        measure(call, [&] { layout.setFontPath(_path); });
+        return true;
+    case TextTraceCall::LayoutSetText:
+        if (!reader.readText(_codepoints, _text)) {
+            return false;
+        }
+        measure(call, [&] { layout.setText(std::wstring_view(_text)); });
+        return true;
+    case TextTraceCall::LayoutSetFontSize: {
+        glm::ivec2 fontSize{};
+        if (!reader.readIvec2(fontSize)) {
+            return false;
+        }
+        measure(call, [&] { layout.setFontSize(fontSize); });
+        return true;
+    }
+    case TextTraceCall::LayoutSetFallbackFontPaths:
+        if (!reader.readSize(count) || count > record.arguments.size()) {
+            return false;
+        }
+        _paths.resize(count);
+        for (std::filesystem::path &path : _paths) {
+            if (!reader.readPath(path)) {
+                return false;
+            }
+        }
+        measure(call, [&] { layout.setFallbackFontPaths(_paths); });
+        return true;
+    case TextTraceCall::LayoutSetWrapWidth: {
+        float wrapWidth{};
+        if (!reader.readFloat(wrapWidth)) {
+            return false;
+        }
+        measure(call, [&] { layout.setWrapWidth(wrapWidth); });
+        return true;
+    }
+    case TextTraceCall::LayoutSetWrapMode:
+        if (!reader.readSize(index) || index > static_cast<size_t>(WrapMode::Character)) {
+            return false;
+        }
+        measure(call, [&] { layout.setWrapMode(static_cast<WrapMode>(index)); });
+        return true;
+    case TextTraceCall::LayoutSetScrollbackLimit:
+        if (!reader.readSize(index) || !reader.readSize(count)) {
+            return false;
+        }
+        measure(call, [&] { layout.setScrollbackLimit(index, count); });
+        return true;
+    case TextTraceCall::LayoutGetLineCount:
+        measure(call, [&] { _resultSink += layout.getLineCount(); });
+        return true;
+    case TextTraceCall::LayoutGetLineIndex:
+        if (!reader.readSize(index)) {
+            return false;
+        }
+        measure(call, [&] { _resultSink += layout.getLineIndex(index); });
+        return true;
+    case TextTraceCall::LayoutGetLineRange:
+        if (!reader.readSize(index)) {
+            return false;
+        }
+        measure(call, [&] { _resultSink += layout.getLineRange(index).second; });
+        return true;
+    case TextTraceCall::LayoutGetCharacterIndex: {
+        glm::vec2 point{};
+        if (!reader.readVec2(point)) {
+            return false;
+        }
+        measure(call, [&] { _resultSink += layout.getCharacterIndex(point); });
+        return true;
+    }
+    case TextTraceCall::LayoutGetCharacterRect:
+        if (!reader.readSize(index)) {
+            return false;
+        }
+        measure(call, [&] {
+            _resultSink += static_cast<size_t>(layout.getCharacterRect(index).size.x);
+        });
+        return true;
+    case TextTraceCall::LayoutGetCaretRect:
+        if (!reader.readSize(index)) {
+            return false;
+        }
+        measure(call, [&] {
+            _resultSink += static_cast<size_t>(layout.getCaretRect(index).position.x);
+        });
+        return true;
+    case TextTraceCall::LayoutEraseText:
+        if (!reader.readSize(index) || !reader.readSize(count)) {
+            return false;
+        }
+        measure(call, [&] { layout.eraseText(index, count); });
+        return true;
+    case TextTraceCall::LayoutInsertText:
+        if (!reader.readText(_codepoints, _text) || !reader.readSize(index)) {
+            return false;
+        }
+        measure(call, [&] { layout.insertText(std::wstring_view(_text), index); });
+        return true;
+    case TextTraceCall::LayoutAppendText:
+        if (!reader.readText(_codepoints, _text)) {
+            return false;
+        }
+        measure(call, [&] { layout.appendText(std::wstring_view(_text)); });
+        return true;
+    case TextTraceCall::LayoutSetTextStyle: {
+        TextStyle style{};
+        uint64_t decorations{};
+        if (!reader.readSize(index) || !reader.readSize(count) || !reader.readVec4(style.color) ||
+            !reader.readVec4(style.backgroundColor) || !reader.readVarint(decorations)) {
+            return false;
+        }
+        style.underline = (decorations & 1) != 0;
+        style.strikethrough = (decorations & 2) != 0;
+        measure(call, [&] { layout.setTextStyle(index, count, style); });
+        return true;
+    }
+    case TextTraceCall::LayoutClearTextStyle:
+        if (!reader.readSize(index) || !reader.readSize(count)) {
+            return false;
+        }
+        measure(call, [&] { layout.clearTextStyle(index, count); });
+        return true;
+    case TextTraceCall::LayoutClearTextStyles:
+        measure(call, [&] { layout.clearTextStyles(); });
+        return true;
+    case TextTraceCall::LayoutSetTextFont: {
+        glm::ivec2 fontSize{};
+        if (!reader.readSize(index) || !reader.readSize(count) || !reader.readPath(_path) ||
+            !reader.readIvec2(fontSize)) {
+            return false;
+        }
+        measure(call, [&] { layout.setTextFont(index, count, _path, fontSize); });
+        return true;
+    }
+    case TextTraceCall::LayoutClearTextFont:
+        if (!reader.readSize(index) || !reader.readSize(count)) {
+            return false;
+        }
+        measure(call, [&] { layout.clearTextFont(index, count); });
+        return true;
+    case TextTraceCall::LayoutClearTextFonts:
+        measure(call, [&] { layout.clearTextFonts(); });
+        return true;
+    case TextTraceCall::LayoutSetVisibleLines:
+        if (!reader.readSize(index) || !reader.readSize(count)) {
+            return false;
+        }
+        measure(call, [&] { layout.setVisibleLines(index, count); });
+        return true;
+    case TextTraceCall::LayoutClearVisibleLines:
+        measure(call, [&] { layout.clearVisibleLines(); });
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool TextTraceReplayer::replayRendererCall(const TextTraceRecord &record,
+                                           TextTraceArgumentReader &reader) {
+    const TextTraceCall call = record.call;
+    if (call == TextTraceCall::RendererDestroy) {
+        TextRendererSharedPtr renderer = std::move(_renderers[record.objectId]);
+        _renderers.erase(record.objectId);
+        measure(call, [&] { renderer.reset(); });
+        return true;
+    }
+
+    TextRenderer &renderer = *getRenderer(record.objectId);
+    switch (call) {
+    case TextTraceCall::RendererSetTextLayout: {
+        uint64_t layoutId{};
+        if (!reader.readVarint(layoutId)) {
+            return false;
+        }
+        const TextLayoutSharedPtr layout = layoutId == 0 ? nullptr : getLayout(layoutId);
+        measure(call, [&] { renderer.setTextLayout(layout); });
+        return true;
+    }
+    case TextTraceCall::RendererSetMatrix: {
+        glm::mat4 matrix{};
+        if (!reader.readMat4(matrix)) {
+            return false;
+        }
+        measure(call, [&] { renderer.setMatrix(matrix); });
+        return true;
+    }
+    case TextTraceCall::RendererSetColor:
+    case TextTraceCall::RendererSetBackgroundColor: {
+        glm::vec4 color{};
+        if (!reader.readVec4(color)) {
+            return false;
+        }
+        if (call == TextTraceCall::RendererSetColor) {
+            measure(call, [&] { renderer.setColor(color); });
+        } else {
+            measure(call, [&] { renderer.setBackgroundColor(color); });
+        }
+        return true;
+    }
+    case TextTraceCall::RendererSetCached: {
+        uint64_t cached{};
+        if (!reader.readVarint(cached)) {
+            return false;
+        }
+        measure(call, [&] { renderer.setCached(cached != 0); });
+        return true;
+    }
+    case TextTraceCall::RendererDraw:
+        measure(call, [&] { renderer.draw(); });
+        return true;
+    case TextTraceCall::RendererDrawCopies: {
+        size_t count{};
+        if (!reader.readSize(count) || count > record.arguments.size()) {
+            return false;
+        }
+        _copies.resize(count);
+        for (TextCopy &copy : _copies) {
+            if (!reader.readMat4(copy.matrix) || !reader.readVec4(copy.color)) {
+                return false;
+            }
+        }
+        measure(call, [&] { renderer.drawCopies(_copies); });
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+const TextLayoutSharedPtr &TextTraceReplayer::getLayout(uint64_t objectId) {
+    TextLayoutSharedPtr &layout = _layouts[objectId];
+    if (!layout) {
+        layout = makeTextLayout();
+    }
+    return layout;
+}
+
+const TextRendererSharedPtr &TextTraceReplayer::getRenderer(uint64_t objectId) {
+    TextRendererSharedPtr &renderer = _renderers[objectId];
+    if (!renderer) {
+        renderer = makeTextRenderer();
+    }
+    return renderer;
+}
+
+bool summarizeTextTrace(std::span<const uint8_t> trace, TextTraceReport &report) {
+    return summarize_text_trace(trace, report);
+}
+
+bool replayTextTrace(std::span<const uint8_t> trace, TextTraceReport &report,
+                     TextTraceReplayMode mode) {
+    size_t offset{};
+    if (!read_text_trace_header(trace, offset)) {
+        RT_ERROR("Not a text trace or a trace of another version");
+        return false;
+    }
+
+    TextTraceReplayer replayer(report, mode);
+    TextTraceRecord record;
+    while (offset < trace.size()) {
+        const size_t recordOffset = offset;
+        if (!read_text_trace_record(trace, offset, record) || !replayer.replay(record)) {
+            RT_ERROR("Text trace is corrupted at byte {}", recordOffset);
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace rendell_text
@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <bc4.h>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RT_BC4_SSE2
+#endif
+
+namespace rendell_text {
+// A fit places every pixel of a block at a position of a ramp of steps intervals from low to
+// high, or at one of the exact extremes of the six-value mode.
+static constexpr uint8_t POSITION_ZERO = 0xFE;
+static constexpr uint8_t POSITION_FULL = 0xFF;
+
+static int get_ramp_value(int position, int low, int high, int steps) {
+    return (low * steps + position * (high - low) + steps / 2) / steps;
+}
+
+#ifdef RT_BC4_SSE2
+static __m128i select_epi16(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Returns the squared error of the fit. The ramp values are divided by multiplying with the
+// reciprocal, which is exact for the numerators a block can produce.
+static uint32_t fit_block(const uint8_t *pixels, int low, int high, int steps, bool extremes,
+                          uint8_t *positions) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels));
+    const __m128i halves[2] = {_mm_unpacklo_epi8(bytes, zero), _mm_unpackhi_epi8(bytes, zero)};
+    const int range = high - low;
+    const __m128i reciprocal = _mm_set1_epi16(static_cast<short>(steps == 7 ? 9363 : 13108));
+
+    __m128i squaredErrors = zero;
+    __m128i positionHalves[2];
+    for (int h = 0; h < 2; h++) {
+        const __m128i pixel = halves[h];
+        const __m128i scaled = _mm_mullo_epi16(_mm_sub_epi16(pixel, _mm_set1_epi16(low)),
+                                               _mm_set1_epi16(static_cast<short>(2 * steps)));
+        // The position is the number of midpoints between ramp values the pixel reaches.
+        __m128i position = zero;
+        for (int k = 1; range > 0 && k <= steps; k++) {
+            const __m128i midpoint = _mm_set1_epi16(static_cast<short>((2 * k - 1) * range - 1));
+            position = _mm_sub_epi16(position, _mm_cmpgt_epi16(scaled, midpoint));
+        }
+
+        const __m128i numerator =
+            _mm_add_epi16(_mm_mullo_epi16(position, _mm_set1_epi16(static_cast<short>(range))),
+                          _mm_set1_epi16(static_cast<short>(low * steps + steps / 2)));
+        const __m128i value = _mm_mulhi_epu16(numerator, reciprocal);
+        const __m128i difference = _mm_sub_epi16(pixel, value);
+        __m128i error = _mm_max_epi16(difference, _mm_sub_epi16(zero, difference));
+        if (extremes) {
+            const __m128i fullError = _mm_sub_epi16(_mm_set1_epi16(255), pixel);
+            const __m128i useZero = _mm_cmpgt_epi16(error, pixel);
+            error = _mm_min_epi16(error, pixel);
+            position = select_epi16(useZero, _mm_set1_epi16(POSITION_ZERO), position);
+            const __m128i useFull = _mm_cmpgt_epi16(error, fullError);
+            error = _mm_min_epi16(error, fullError);
+            position = select_epi16(useFull, _mm_set1_epi16(POSITION_FULL), position);
+        }
+        squaredErrors = _mm_add_epi32(squaredErrors, _mm_madd_epi16(error, error));
+        positionHalves[h] = position;
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(positions),
+                     _mm_packus_epi16(positionHalves[0], positionHalves[1]));
+    squaredErrors = _mm_add_epi32(squaredErrors, _mm_srli_si128(squaredErrors, 8));
+    squaredErrors = _mm_add_epi32(squaredErrors, _mm_srli_si128(squaredErrors, 4));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(squaredErrors));
+}
+#else
+static uint32_t fit_block(const uint8_t *pixels, int low, int high, int steps, bool extremes,
+                          uint8_t *positions) {
+    const int range = high - low;
+    uint32_t squaredError = 0;
+    for (int i = 0; i < 16; i++) {
+        const int pixel = pixels[i];
+        const int scaled = (pixel - low) * 2 * steps;
+        int position = 0;
+        for (int k = 1; range > 0 && k <= steps; k++) {
+            position += scaled >= (2 * k - 1) * range ? 1 : 0;
+        }
+
+        int error = std::abs(pixel - get_ramp_value(position, low, high, steps));
+        if (extremes && pixel < error) {
+            error = pixel;
+            position = POSITION_ZERO;
+        }
+        if (extremes && 255 - pixel < error) {
+            error = 255 - pixel;
+            position = POSITION_FULL;
+        }
+        positions[i] = static_cast<uint8_t>(position);
+        squaredError += static_cast<uint32_t>(error * error);
+    }
+    return squaredError;
+}
+#endif
+
+static void write_block(uint8_t endpoint0, uint8_t endpoint1, const uint8_t *indices,
+                        uint8_t *dst) {
+    dst[0] = endpoint0;
+    dst[1] = endpoint1;
+    uint64_t indexBits = 0;
+    for (int i = 0; i < 16; i++) {
+        indexBits |= static_cast<uint64_t>(indices[i]) << (3 * i);
+    }
+    for (int i = 0; i < 6; i++) {
+        dst[2 + i] = static_cast<uint8_t>(indexBits >> (8 * i));
+    }
+}
+
+static void encode_block(const uint8_t *pixels, uint8_t *dst) {
+    int minimum = 255;
+    int maximum = 0;
+    int innerMinimum = 255;
+    int innerMaximum = 0;
+    for (int i = 0; i < 16; i++) {
+        const int pixel = pixels[i];
+        minimum = std::min(minimum, pixel);
+        maximum = std::max(maximum, pixel);
+        if (pixel != 0 && pixel != 255) {
+            innerMinimum = std::min(innerMinimum, pixel);
+            innerMaximum = std::max(innerMaximum, pixel);
+        }
+    }
+
+    uint8_t positions[16];
+    uint8_t indices[16];
+    const uint32_t error = fit_block(pixels, minimum, maximum, 7, false, positions);
+    // Antialiased edges mix empty and full coverage with a few values in between, which the
+    // six-value mode keeps exact.
+    if (error > 0 && innerMinimum <= innerMaximum) {
+        uint8_t extremePositions[16];
+        if (fit_block(pixels, innerMinimum, innerMaximum, 5, true, extremePositions) < error) {
+            for (int i = 0; i < 16; i++) {
+                const uint8_t position = extremePositions[i];
+                indices[i] = position == POSITION_ZERO   ? 6
+                             : position == POSITION_FULL ? 7
+                             : position == 0             ? 0
+                             : position == 5             ? 1
+                                                         : position + 1;
+            }
+            write_block(static_cast<uint8_t>(innerMinimum), static_cast<uint8_t>(innerMaximum),
+                        indices, dst);
+            return;
+        }
+    }
+
+    // The eight-value mode needs the larger endpoint first. A flat block has equal endpoints and
+    // reads index 1 in either mode.
+    for (int i = 0; i < 16; i++) {
+        const uint8_t position = positions[i];
+        indices[i] = position == 7 ? 0 : position == 0 ? 1 : 8 - position;
+    }
+    write_block(static_cast<uint8_t>(maximum), static_cast<uint8_t>(minimum), indices, dst);
+}
+
+size_t bc4_encoded_size(uint32_t width, uint32_t height) {
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * BC4_BLOCK_SIZE;
+}
+
+void encode_bc4(const uint8_t *pixels, uint32_t width, uint32_t height, uint8_t *dst) {
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    uint8_t block[16];
+    for (uint32_t blockY = 0; blockY < height; blockY += 4) {
+        for (uint32_t blockX = 0; blockX < width; blockX += 4) {
+            for (uint32_t y = 0; y < 4; y++) {
+                const uint8_t *row = pixels + std::min(blockY + y, height - 1) * width;
+                for (uint32_t x = 0; x < 4; x++) {
+                    block[y * 4 + x] = row[std::min(blockX + x, width - 1)];
+                }
+            }
+            encode_block(block, dst);
+            dst += BC4_BLOCK_SIZE;
+        }
+    }
+}
+
+void decode_bc4(const uint8_t *blocks, uint32_t width, uint32_t height, uint8_t *dst) {
+    for (uint32_t blockY = 0; blockY < height; blockY += 4) {
+        for (uint32_t blockX = 0; blockX < width; blockX += 4) {
+            const int endpoint0 = blocks[0];
+            const int endpoint1 = blocks[1];
+            int palette[8] = {endpoint0, endpoint1};
+            if (endpoint0 > endpoint1) {
+                for (int i = 2; i < 8; i++) {
+                    palette[i] = get_ramp_value(8 - i, endpoint1, endpoint0, 7);
+                }
+            } else {
+                for (int i = 2; i < 6; i++) {
+                    palette[i] = get_ramp_value(i - 1, endpoint0, endpoint1, 5);
+                }
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+
+            uint64_t indexBits = 0;
+            for (int i = 0; i < 6; i++) {
+                indexBits |= static_cast<uint64_t>(blocks[2 + i]) << (8 * i);
+            }
+            for (uint32_t y = 0; y < 4 && blockY + y < height; y++) {
+                for (uint32_t x = 0; x < 4 && blockX + x < width; x++) {
+                    const uint32_t index = (indexBits >> (3 * (y * 4 + x))) & 7;
+                    dst[(blockY + y) * width + blockX + x] = static_cast<uint8_t>(palette[index]);
+                }
+            }
+            blocks += BC4_BLOCK_SIZE;
+        }
+    }
+}
+} // namespace rendell_text
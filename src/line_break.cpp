@@ -0,0 +1,24 @@
+#include <line_break.h>
+#include <unicode.h>
+
+namespace rendell_text {
+void break_lines(const wchar_t *text, const float *penPositions, size_t length, float maxWidth,
+                 bool breakAtWords, std::vector<size_t> &lineStarts) {
+    size_t lineStart = 0;
+    // The position right after the last space of the line, 0 if there is none.
+    size_t wordStart = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] != L' ' && !is_trailing_unit(text[i])) {
+            while (i > lineStart &&
+                   penPositions[i] - (lineStart == 0 ? 0.0f : penPositions[lineStart - 1]) >
+                       maxWidth) {
+                lineStart = breakAtWords && wordStart > lineStart ? wordStart : i;
+                lineStarts.push_back(lineStart);
+            }
+        }
+        if (text[i] == L' ') {
+            wordStart = i + 1;
+        }
+    }
+}
+} // namespace rendell_text
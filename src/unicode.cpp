@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <unicode.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RT_UNICODE_SSE2
+#endif
+
+namespace rendell_text {
+static bool is_surrogate(char32_t codepoint) {
+    return codepoint >= 0xD800 && codepoint <= 0xDFFF;
+}
+
+size_t wide_length(char32_t codepoint) {
+    if constexpr (sizeof(wchar_t) == 2) {
+        return codepoint >= 0x10000 ? 2 : 1;
+    }
+    return 1;
+}
+
+size_t encode_wide(char32_t codepoint, wchar_t *dst) {
+    if constexpr (sizeof(wchar_t) == 2) {
+        if (codepoint >= 0x10000) {
+            codepoint -= 0x10000;
+            dst[0] = static_cast<wchar_t>(0xD800 + (codepoint >> 10));
+            dst[1] = static_cast<wchar_t>(0xDC00 + (codepoint & 0x3FF));
+            return 2;
+        }
+    }
+    dst[0] = static_cast<wchar_t>(codepoint);
+    return 1;
+}
+
+bool is_trailing_unit(wchar_t unit) {
+    if constexpr (sizeof(wchar_t) == 2) {
+        return unit >= 0xDC00 && unit <= 0xDFFF;
+    }
+    return false;
+}
+
+size_t common_prefix_length(std::wstring_view a, std::wstring_view b) {
+    const size_t length = std::min(a.size(), b.size());
+    size_t i = 0;
+#ifdef RT_UNICODE_SSE2
+    constexpr size_t unitsPerStep = 16 / sizeof(wchar_t);
+    while (i + unitsPerStep <= length) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a.data() + i));
+        const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b.data() + i));
+        const uint16_t equalBytes = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+        if (equalBytes != 0xFFFF) {
+            return i + std::countr_one(equalBytes) / sizeof(wchar_t);
+        }
+        i += unitsPerStep;
+    }
+#endif
+    while (i < length && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+size_t common_suffix_length(std::wstring_view a, std::wstring_view b) {
+    const size_t length = std::min(a.size(), b.size());
+    const wchar_t *aEnd = a.data() + a.size();
+    const wchar_t *bEnd = b.data() + b.size();
+    size_t i = 0;
+#ifdef RT_UNICODE_SSE2
+    constexpr size_t unitsPerStep = 16 / sizeof(wchar_t);
+    while (i + unitsPerStep <= length) {
+        const __m128i x =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(aEnd - i - unitsPerStep));
+        const __m128i y =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(bEnd - i - unitsPerStep));
+        const uint16_t equalBytes = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+        if (equalBytes != 0xFFFF) {
+            return i + std::countl_one(equalBytes) / sizeof(wchar_t);
+        }
+        i += unitsPerStep;
+    }
+#endif
+    while (i < length && *(aEnd - i - 1) == *(bEnd - i - 1)) {
+        i++;
+    }
+    return i;
+}
+
+char32_t next_codepoint(std::wstring_view text, size_t &index) {
+    const char32_t unit = static_cast<char32_t>(text[index++]);
+    if constexpr (sizeof(wchar_t) == 2) {
+        if (unit >= 0xD800 && unit <= 0xDBFF && index < text.size()) {
+            const char32_t low = static_cast<char32_t>(text[index]);
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                index++;
+                return 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+            }
+        }
+    }
+    if (unit > MAX_CODEPOINT || is_surrogate(unit)) {
+        return REPLACEMENT_CHARACTER;
+    }
+    return unit;
+}
+
+// Widens the leading run of ASCII bytes, 16 bytes per step when SSE2 is available.
+static size_t copy_ascii(const char8_t *src, const char8_t *end, wchar_t *dst) {
+    const char8_t *it = src;
+#ifdef RT_UNICODE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    while (end - it >= 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(it));
+        if (_mm_movemask_epi8(bytes) != 0) {
+            break;
+        }
+        const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+        const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+        __m128i *out = reinterpret_cast<__m128i *>(dst);
+        if constexpr (sizeof(wchar_t) == 2) {
+            _mm_storeu_si128(out, low);
+            _mm_storeu_si128(out + 1, high);
+        } else {
+            _mm_storeu_si128(out, _mm_unpacklo_epi16(low, zero));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(low, zero));
+            _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(high, zero));
+            _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(high, zero));
+        }
+        it += 16;
+        dst += 16;
+    }
+#endif
+    while (it < end && *it < 0x80) {
+        *dst++ = static_cast<wchar_t>(*it++);
+    }
+    return static_cast<size_t>(it - src);
+}
+
+// Every UTF-8 byte produces at most one wchar_t unit, so dst must hold src.size() units.
+static size_t decode_utf8(std::u8string_view src, wchar_t *dst) {
+    const char8_t *it = src.data();
+    const char8_t *const end = it + src.size();
+    wchar_t *out = dst;
+
+    while (it < end) {
+        const size_t asciiCount = copy_ascii(it, end, out);
+        it += asciiCount;
+        out += asciiCount;
+        if (it == end) {
+            break;
+        }
+
+        const uint8_t lead = static_cast<uint8_t>(*it);
+        char32_t codepoint;
+        size_t length;
+        char32_t minCodepoint;
+        if ((lead & 0xE0) == 0xC0) {
+            codepoint = lead & 0x1F;
+            length = 2;
+            minCodepoint = 0x80;
+        } else if ((lead & 0xF0) == 0xE0) {
+            codepoint = lead & 0x0F;
+            length = 3;
+            minCodepoint = 0x800;
+        } else if ((lead & 0xF8) == 0xF0) {
+            codepoint = lead & 0x07;
+            length = 4;
+            minCodepoint = 0x10000;
+        } else {
+            *out++ = static_cast<wchar_t>(REPLACEMENT_CHARACTER);
+            it++;
+            continue;
+        }
+
+        bool valid = static_cast<size_t>(end - it) >= length;
+        for (size_t i = 1; valid && i < length; i++) {
+            const uint8_t continuation = static_cast<uint8_t>(it[i]);
+            valid = (continuation & 0xC0) == 0x80;
+            codepoint = (codepoint << 6) | (continuation & 0x3F);
+        }
+        if (!valid || codepoint < minCodepoint || codepoint > MAX_CODEPOINT ||
+            is_surrogate(codepoint)) {
+            *out++ = static_cast<wchar_t>(REPLACEMENT_CHARACTER);
+            it++;
+            continue;
+        }
+
+        out += encode_wide(codepoint, out);
+        it += length;
+    }
+
+    return static_cast<size_t>(out - dst);
+}
+
+static size_t decode_utf32(std::u32string_view src, wchar_t *dst) {
+    wchar_t *out = dst;
+    for (char32_t codepoint : src) {
+        if (codepoint > MAX_CODEPOINT || is_surrogate(codepoint)) {
+            codepoint = REPLACEMENT_CHARACTER;
+        }
+        out += encode_wide(codepoint, out);
+    }
+    return static_cast<size_t>(out - dst);
+}
+
+void append_utf8(std::wstring &dst, std::u8string_view src) {
+    const size_t oldLength = dst.length();
+    dst.resize_and_overwrite(oldLength + src.size(), [&](wchar_t *data, size_t) {
+        return oldLength + decode_utf8(src, data + oldLength);
+    });
+}
+
+void append_utf32(std::wstring &dst, std::u32string_view src) {
+    const size_t oldLength = dst.length();
+    const size_t maxLength = src.size() * (sizeof(wchar_t) == 2 ? 2 : 1);
+    dst.resize_and_overwrite(oldLength + maxLength, [&](wchar_t *data, size_t) {
+        return oldLength + decode_utf32(src, data + oldLength);
+    });
+}
+
+void insert_utf8(std::wstring &dst, size_t index, std::u8string_view src) {
+    const size_t oldLength = dst.length();
+    append_utf8(dst, src);
+    std::rotate(dst.begin() + index, dst.begin() + oldLength, dst.end());
+}
+
+void insert_utf32(std::wstring &dst, size_t index, std::u32string_view src) {
+    const size_t oldLength = dst.length();
+    append_utf32(dst, src);
+    std::rotate(dst.begin() + index, dst.begin() + oldLength, dst.end());
+}
+} // namespace rendell_text
@@ -0,0 +1,104 @@
+// Checks that relayouts of a text as large as the previous one make no heap allocations. Every
+// global operator new is counted while the layouts are updated again, after a warm-up that
+// creates the glyph pages and text batches. Only the CPU side of the layout runs: glyph pages go
+// to the GPU on their first draw, so no rendell context is needed.
+//
+// Usage: check_layout_allocations <font>
+#include <rendell_text/TextLayout.h>
+
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+
+#define WARM_UP_PASS_COUNT 4
+#define CHECKED_PASS_COUNT 10
+
+static size_t s_allocationCount = 0;
+static bool s_countingAllocations = false;
+
+void *operator new(size_t size) {
+    if (s_countingAllocations) {
+        s_allocationCount++;
+    }
+    if (void *result = std::malloc(size > 0 ? size : 1)) {
+        return result;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+// Runs the pass alternately with both texts and returns the allocations of the checked passes.
+static size_t countAllocations(const std::function<void(size_t)> &pass) {
+    for (size_t i = 0; i < WARM_UP_PASS_COUNT; i++) {
+        pass(i);
+    }
+    s_allocationCount = 0;
+    s_countingAllocations = true;
+    for (size_t i = 0; i < CHECKED_PASS_COUNT; i++) {
+        pass(i);
+    }
+    s_countingAllocations = false;
+    return s_allocationCount;
+}
+
+static bool checkRelayout(const char *name, rendell_text::TextLayout &textLayout,
+                          const std::wstring &text, const std::wstring &otherText) {
+    const size_t allocationCount = countAllocations([&](size_t pass) {
+        textLayout.setText(std::wstring_view(pass % 2 == 0 ? text : otherText));
+        // Queries lay the text out without uploading it.
+        textLayout.getLineCount();
+    });
+    std::cout << name << ": " << allocationCount << " allocations\n";
+    return allocationCount == 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::cerr << "Usage: check_layout_allocations <font>\n";
+        return EXIT_FAILURE;
+    }
+
+    std::wstring text;
+    for (int i = 0; i < 200; i++) {
+        text += L"line of text number " + std::to_wstring(1000 + i) + L"\n";
+    }
+    // The same length with edits at both ends, so the shaped paragraphs change.
+    std::wstring otherText = text;
+    otherText[5] = L'X';
+    otherText[otherText.length() - 3] = L'Y';
+
+    bool result = true;
+    rendell_text::TextLayout textLayout;
+    textLayout.setFontPath(argv[1]);
+    textLayout.setFontSize(glm::ivec2(20, 20));
+    result &= checkRelayout("short label", textLayout, L"fps: 59.9", L"fps: 60.1");
+    result &= checkRelayout("long text", textLayout, text, otherText);
+
+    textLayout.setTextStyle(0, 10, rendell_text::TextStyle{{1, 0, 0, 1}, {0, 0, 1, 1}, true});
+    result &= checkRelayout("styled", textLayout, text, otherText);
+
+    rendell_text::TextLayout wrappedLayout;
+    wrappedLayout.setFontPath(argv[1]);
+    wrappedLayout.setFontSize(glm::ivec2(20, 20));
+    wrappedLayout.setWrapMode(rendell_text::WrapMode::Word);
+    wrappedLayout.setWrapWidth(120.0f);
+    result &= checkRelayout("wrapped", wrappedLayout, text, otherText);
+
+    const size_t reflowAllocationCount = countAllocations([&](size_t pass) {
+        wrappedLayout.setWrapWidth(pass % 2 == 0 ? 100.0f : 150.0f);
+        wrappedLayout.getLineCount();
+    });
+    std::cout << "reflow: " << reflowAllocationCount << " allocations\n";
+    result &= reflowAllocationCount == 0;
+
+    return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,77 @@
+// Checks that TextMeasurer breaks lines exactly where a TextLayout with word wrap at the same width
+// does, so a widget sized from a measurement shows the lines it was measured with. Every text is
+// measured and laid out at several widths and the line starts of both are compared. Only the CPU
+// side of the layout runs, no rendell context is needed.
+//
+// Usage: check_line_breaks <font>
+#include <rendell_text/TextLayout.h>
+#include <rendell_text/TextMeasurer.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static std::string toString(const std::vector<size_t> &lineStarts) {
+    std::string result;
+    for (size_t lineStart : lineStarts) {
+        result += (result.empty() ? "" : " ") + std::to_string(lineStart);
+    }
+    return result;
+}
+
+static bool checkLineBreaks(const char *name, rendell_text::TextLayout &textLayout,
+                            const rendell_text::TextMeasurer &textMeasurer,
+                            const std::wstring &text, float maxWidth) {
+    textLayout.setText(std::wstring_view(text));
+    textLayout.setWrapWidth(maxWidth);
+    std::vector<size_t> layoutLineStarts;
+    for (size_t i = 0; i < textLayout.getLineCount(); i++) {
+        layoutLineStarts.push_back(textLayout.getLineRange(i).first);
+    }
+
+    const std::vector<size_t> measuredLineStarts = textMeasurer.measure(text, maxWidth).lineStarts;
+    if (measuredLineStarts != layoutLineStarts) {
+        std::cout << name << " at " << maxWidth << ": measured {" << toString(measuredLineStarts)
+                  << "}, laid out {" << toString(layoutLineStarts) << "}\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        std::cerr << "Usage: check_line_breaks <font>\n";
+        return EXIT_FAILURE;
+    }
+
+    const glm::ivec2 fontSize(20, 20);
+    rendell_text::TextMeasurer textMeasurer;
+    textMeasurer.setFontPath(argv[1]);
+    textMeasurer.setFontSize(fontSize);
+    rendell_text::TextLayout textLayout;
+    textLayout.setFontPath(argv[1]);
+    textLayout.setFontSize(fontSize);
+    textLayout.setWrapMode(rendell_text::WrapMode::Word);
+
+    bool result = true;
+    // The space after "bb" hangs past the edge, so "bb" stays on the first line.
+    result &= checkLineBreaks("hanging space", textLayout, textMeasurer, L"aa bb cc",
+                              textMeasurer.measureWidth(L"aa bb"));
+
+    const std::vector<std::pair<const char *, std::wstring>> texts{
+        {"words", L"the quick brown fox jumps over the lazy dog"},
+        {"runs of spaces", L"wide    gaps   between  words     and trailing   "},
+        {"long word", L"a supercalifragilisticexpialidocious word"},
+        {"paragraphs", L"first paragraph of text\n\nthird one after an empty one\n"},
+        {"surrogate pairs", L"emoji \U0001F600\U0001F600\U0001F600 in between words"},
+    };
+    for (const auto &[name, text] : texts) {
+        for (float maxWidth = 10.0f; maxWidth <= 400.0f; maxWidth += 7.0f) {
+            result &= checkLineBreaks(name, textLayout, textMeasurer, text, maxWidth);
+        }
+    }
+
+    std::cout << (result ? "line breaks match\n" : "line breaks differ\n");
+    return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,176 @@
+// Host tool of rendell_text_embed_font: rasterizes a font at one size with FreeType and writes a
+// header defining a rendell_text::EmbeddedFont, so the target binary never rasterizes it.
+//
+// Usage: font_atlas_baker <font-file> <name> <width> <height> <charset> <output-header>
+// The charset is a comma separated list of codepoints and inclusive ranges, e.g. 0x20-0x7E,0xB0.
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct BakedGlyph {
+    uint32_t character{};
+    uint32_t width{};
+    uint32_t height{};
+    int bearingX{};
+    int bearingY{};
+    uint32_t advance{};
+    size_t pixelOffset{};
+};
+
+static bool parseCharset(const std::string &charset, std::vector<uint32_t> &result) {
+    std::stringstream stream(charset);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        try {
+            const size_t dash = item.find('-', 1);
+            const uint32_t first = std::stoul(item.substr(0, dash), nullptr, 0);
+            const uint32_t last =
+                dash == std::string::npos ? first : std::stoul(item.substr(dash + 1), nullptr, 0);
+            for (uint32_t character = first; character <= last; character++) {
+                result.push_back(character);
+            }
+        } catch (const std::exception &) {
+            std::cerr << "Invalid charset item '" << item << "'\n";
+            return false;
+        }
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return true;
+}
+
+static std::string makeVariableName(const std::string &name) {
+    std::string result = "embedded_font_";
+    for (const char c : name) {
+        result += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+    return result;
+}
+
+static std::string escapeString(const std::string &value) {
+    std::string result;
+    for (const char c : value) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 7) {
+        std::cerr << "Usage: font_atlas_baker <font-file> <name> <width> <height> <charset> "
+                     "<output-header>\n";
+        return 1;
+    }
+
+    const std::string fontPath = argv[1];
+    const std::string name = argv[2];
+    const uint32_t width = std::stoul(argv[3]);
+    const uint32_t height = std::stoul(argv[4]);
+    std::vector<uint32_t> charset;
+    if (!parseCharset(argv[5], charset)) {
+        return 1;
+    }
+
+    FT_Library freetype;
+    FT_Face face;
+    if (FT_Init_FreeType(&freetype)) {
+        std::cerr << "Could not init FreeType Library\n";
+        return 1;
+    }
+    if (FT_New_Face(freetype, fontPath.c_str(), 0, &face)) {
+        std::cerr << "Failed to create font face " << fontPath << "\n";
+        return 1;
+    }
+    FT_Set_Pixel_Sizes(face, width, height);
+
+    // The same calls as FontRaster, so the baked glyphs match the ones rasterized at runtime.
+    std::vector<BakedGlyph> glyphs;
+    std::vector<uint8_t> pixels;
+    for (const uint32_t character : charset) {
+        if (FT_Get_Char_Index(face, character) == 0) {
+            continue;
+        }
+        if (FT_Load_Char(face, character, FT_LOAD_RENDER)) {
+            std::cerr << "Failed to load glyph " << character << ", skipping it\n";
+            continue;
+        }
+
+        const FT_GlyphSlot slot = face->glyph;
+        const FT_Bitmap &bitmap = slot->bitmap;
+        glyphs.push_back({character, bitmap.width, bitmap.rows, slot->bitmap_left,
+                          slot->bitmap_top, static_cast<uint32_t>(slot->advance.x),
+                          pixels.size()});
+        for (uint32_t row = 0; row < bitmap.rows; row++) {
+            const uint8_t *src = bitmap.buffer + static_cast<ptrdiff_t>(row) * bitmap.pitch;
+            pixels.insert(pixels.end(), src, src + bitmap.width);
+        }
+    }
+
+    if (glyphs.empty()) {
+        std::cerr << "None of the charset is in " << fontPath << "\n";
+        return 1;
+    }
+
+    const int lineHeight = static_cast<int>(face->size->metrics.height >> 6);
+    const int ascender = static_cast<int>(face->size->metrics.ascender >> 6);
+    const int descender = static_cast<int>(face->size->metrics.descender >> 6);
+    FT_Done_Face(face);
+    FT_Done_FreeType(freetype);
+
+    const std::string variableName = makeVariableName(name);
+    std::ofstream output(argv[6], std::ios::binary);
+    if (!output) {
+        std::cerr << "Failed to open " << argv[6] << "\n";
+        return 1;
+    }
+
+    output << "#pragma once\n#include <rendell_text/EmbeddedFont.h>\n\n";
+    output << "// Generated by font_atlas_baker from " << fontPath << ", do not edit.\n\n";
+
+    output << "static const rendell_text::EmbeddedGlyph " << variableName << "_glyphs[] = {\n";
+    for (const BakedGlyph &glyph : glyphs) {
+        output << "    {" << glyph.character << ", " << glyph.width << ", " << glyph.height << ", "
+               << glyph.bearingX << ", " << glyph.bearingY << ", " << glyph.advance << ", "
+               << glyph.pixelOffset << "},\n";
+    }
+    output << "};\n\n";
+
+    // One extra byte keeps the array non-empty when every glyph is blank.
+    output << "static const uint8_t " << variableName << "_pixels[] = {";
+    for (size_t i = 0; i < pixels.size(); i++) {
+        output << (i % 24 == 0 ? "\n    " : " ") << static_cast<uint32_t>(pixels[i]) << ",";
+    }
+    output << "\n    0,\n};\n\n";
+
+    output << "static const rendell_text::EmbeddedFont " << variableName << "{\n"
+           << "    \"" << escapeString(name) << "\",\n"
+           << "    " << width << ",\n"
+           << "    " << height << ",\n"
+           << "    " << lineHeight << ",\n"
+           << "    " << ascender << ",\n"
+           << "    " << descender << ",\n"
+           << "    " << variableName << "_glyphs,\n"
+           << "    " << glyphs.size() << ",\n"
+           << "    " << variableName << "_pixels,\n"
+           << "    " << pixels.size() << ",\n"
+           << "};\n";
+
+    std::cout << "Baked " << glyphs.size() << " glyphs of " << fontPath << " at " << width << "x"
+              << height << " as " << variableName << "\n";
+    return 0;
+}
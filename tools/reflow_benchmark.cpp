@@ -0,0 +1,115 @@
+// Measures what a window resize drag costs a large word-wrapped document: the wrap width steps
+// through a range of widths like a drag does, and every step lays the text out again. The drag
+// runs twice, once filling the instances of the whole text and once with visible lines that keep
+// the middle of the document on screen, as an editor does. Only the CPU side of the layout runs,
+// no rendell context is needed. Build it with optimizations.
+//
+// Usage: reflow_benchmark <font> [document size in KiB, 1024 by default]
+#include <rendell_text/TextLayout.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define DEFAULT_DOCUMENT_KIB 1024
+#define DRAG_MIN_WIDTH 400.0f
+#define DRAG_MAX_WIDTH 1200.0f
+#define DRAG_STEP 4.0f
+#define FRAME_BUDGET_MS 16.6
+#define VISIBLE_LINE_COUNT 80
+
+using Clock = std::chrono::steady_clock;
+
+static double getMilliseconds(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Paragraphs of prose-like words, the text of a document that is mostly wrapped lines.
+static std::wstring makeDocument(size_t length) {
+    static const wchar_t *const s_words[] = {
+        L"the",    L"layout", L"of",   L"a",         L"paragraph", L"wraps",  L"at",
+        L"word",   L"breaks", L"when", L"window",    L"is",        L"resized", L"text",
+        L"renderer", L"glyph", L"line", L"character", L"width",    L"and",    L"with",
+    };
+    std::wstring result;
+    result.reserve(length);
+    size_t word = 0;
+    size_t paragraphLength = 0;
+    while (result.length() < length) {
+        result += s_words[(word * 7 + word / 5) % std::size(s_words)];
+        paragraphLength++;
+        word++;
+        result += paragraphLength % 80 == 0 ? L'\n' : L' ';
+    }
+    result.resize(length);
+    return result;
+}
+
+// Narrowing and widening again, as a drag back and forth does. Returns the time of every step.
+static std::vector<double> dragWidth(const std::function<void(float)> &step) {
+    std::vector<double> result;
+    for (float width = DRAG_MAX_WIDTH - DRAG_STEP; width >= DRAG_MIN_WIDTH; width -= DRAG_STEP) {
+        const Clock::time_point start = Clock::now();
+        step(width);
+        result.push_back(getMilliseconds(start));
+    }
+    for (float width = DRAG_MIN_WIDTH + DRAG_STEP; width <= DRAG_MAX_WIDTH; width += DRAG_STEP) {
+        const Clock::time_point start = Clock::now();
+        step(width);
+        result.push_back(getMilliseconds(start));
+    }
+    return result;
+}
+
+static void report(const char *name, std::vector<double> stepTimes) {
+    std::sort(stepTimes.begin(), stepTimes.end());
+    const double medianTime = stepTimes[stepTimes.size() / 2];
+    const double p95Time = stepTimes[stepTimes.size() * 95 / 100];
+    const size_t overBudgetCount = static_cast<size_t>(
+        stepTimes.end() - std::upper_bound(stepTimes.begin(), stepTimes.end(), FRAME_BUDGET_MS));
+    std::cout << name << ", " << stepTimes.size() << " steps: median " << medianTime
+              << " ms, p95 " << p95Time << " ms, max " << stepTimes.back() << " ms, "
+              << overBudgetCount << " over " << FRAME_BUDGET_MS << " ms\n";
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2 && argc != 3) {
+        std::cerr << "Usage: reflow_benchmark <font> [document size in KiB]\n";
+        return EXIT_FAILURE;
+    }
+    const size_t documentKiB =
+        argc == 3 ? std::strtoul(argv[2], nullptr, 10) : DEFAULT_DOCUMENT_KIB;
+    const std::wstring document = makeDocument(documentKiB * 1024);
+
+    rendell_text::TextLayout textLayout;
+    textLayout.setFontPath(argv[1]);
+    textLayout.setFontSize(glm::ivec2(16, 16));
+    textLayout.setWrapMode(rendell_text::WrapMode::Word);
+    textLayout.setWrapWidth(DRAG_MAX_WIDTH);
+
+    const Clock::time_point start = Clock::now();
+    textLayout.setText(std::wstring_view(document));
+    const size_t lineCount = textLayout.getLineCount();
+    std::cout << document.length() << " units, " << lineCount << " lines, first layout "
+              << getMilliseconds(start) << " ms\n";
+
+    report("whole text", dragWidth([&](float width) {
+               textLayout.setWrapWidth(width);
+               textLayout.getLineCount();
+           }));
+
+    // The line of the anchor character moves with every width, the visible lines follow it.
+    const size_t anchorCharacter = document.length() / 2;
+    textLayout.setVisibleLines(textLayout.getLineIndex(anchorCharacter), VISIBLE_LINE_COUNT);
+    report("visible lines", dragWidth([&](float width) {
+               textLayout.setWrapWidth(width);
+               textLayout.setVisibleLines(textLayout.getLineIndex(anchorCharacter),
+                                          VISIBLE_LINE_COUNT);
+               textLayout.getLineCount();
+           }));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+// Prints the per-call latency histograms of text traces recorded with rendell_text::startTextTrace.
+// By default it prints the latencies the trace recorded. With --replay it runs the layout calls
+// of the trace again with the library it was built with and prints the measured latencies
+// instead, so two library versions can be compared on the same trace. The replay is headless,
+// update and the renderer calls are skipped and no rendell context is needed.
+//
+// Usage: text_trace_report [--replay] <trace> [<trace>...]
+#include <rendell_text/TextTrace.h>
+#include <text_trace.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define HISTOGRAM_BAR_WIDTH 40
+
+static std::string formatDuration(double nanoseconds) {
+    if (nanoseconds < 1e3) {
+        return std::format("{:.0f} ns", nanoseconds);
+    }
+    if (nanoseconds < 1e6) {
+        return std::format("{:.2f} us", nanoseconds / 1e3);
+    }
+    if (nanoseconds < 1e9) {
+        return std::format("{:.2f} ms", nanoseconds / 1e6);
+    }
+    return std::format("{:.2f} s", nanoseconds / 1e9);
+}
+
+// Upper bound of the bucket the quantile falls into.
+static double getQuantile(const rendell_text::TextTraceCallStats &stats, double quantile) {
+    const uint64_t rank = static_cast<uint64_t>(quantile * static_cast<double>(stats.count - 1));
+    uint64_t count = 0;
+    for (size_t i = 0; i < stats.histogram.size(); i++) {
+        count += stats.histogram[i];
+        if (count > rank) {
+            return static_cast<double>(uint64_t{1} << i);
+        }
+    }
+    return static_cast<double>(stats.maxNanoseconds);
+}
+
+static void printHistogram(const rendell_text::TextTraceCallStats &stats) {
+    const auto first = std::find_if(stats.histogram.begin(), stats.histogram.end(),
+                                    [](uint64_t count) { return count > 0; });
+    const auto last = std::find_if(stats.histogram.rbegin(), stats.histogram.rend(),
+                                   [](uint64_t count) { return count > 0; });
+    const uint64_t maxCount = *std::max_element(stats.histogram.begin(), stats.histogram.end());
+    for (auto it = first; it != last.base(); it++) {
+        const size_t bucket = static_cast<size_t>(it - stats.histogram.begin());
+        const size_t barWidth = static_cast<size_t>((*it * HISTOGRAM_BAR_WIDTH + maxCount - 1) /
+                                                    maxCount);
+        std::cout << std::format("    < {:>10} {:<{}} {}\n",
+                                 formatDuration(static_cast<double>(uint64_t{1} << bucket)),
+                                 std::string(barWidth, '#'), HISTOGRAM_BAR_WIDTH, *it);
+    }
+}
+
+static bool printReport(const char *tracePath, bool replay) {
+    std::ifstream stream(tracePath, std::ios::binary);
+    if (!stream) {
+        std::cerr << "Failed to open " << tracePath << "\n";
+        return false;
+    }
+    const std::vector<uint8_t> trace{std::istreambuf_iterator<char>(stream),
+                                     std::istreambuf_iterator<char>()};
+
+    rendell_text::TextTraceReport report;
+    const bool read =
+        replay ? rendell_text::replayTextTrace(trace, report,
+                                               rendell_text::TextTraceReplayMode::Headless)
+               : rendell_text::summarize_text_trace(trace, report);
+    if (!read) {
+        std::cerr << tracePath << " is not a text trace of this version or is corrupted\n";
+        return false;
+    }
+
+    std::cout << tracePath << "\n";
+    std::cout << std::format("  {:<36} {:>8} {:>10} {:>10} {:>10} {:>10}\n", "call", "count",
+                             "mean", "p50 <", "p99 <", "max");
+    for (const rendell_text::TextTraceCallStats &stats : report.calls) {
+        if (stats.count == 0) {
+            continue;
+        }
+        const double mean =
+            static_cast<double>(stats.totalNanoseconds) / static_cast<double>(stats.count);
+        std::cout << std::format("  {:<36} {:>8} {:>10} {:>10} {:>10} {:>10}\n", stats.name,
+                                 stats.count, formatDuration(mean),
+                                 formatDuration(getQuantile(stats, 0.5)),
+                                 formatDuration(getQuantile(stats, 0.99)),
+                                 formatDuration(static_cast<double>(stats.maxNanoseconds)));
+        printHistogram(stats);
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int firstTrace = 1;
+    const bool replay = argc > 1 && std::string_view(argv[1]) == "--replay";
+    if (replay) {
+        firstTrace++;
+    }
+    if (argc <= firstTrace) {
+        std::cerr << "Usage: text_trace_report [--replay] <trace> [<trace>...]\n";
+        return 1;
+    }
+
+    bool succeeded = true;
+    for (int i = firstTrace; i < argc; i++) {
+        succeeded = printReport(argv[i], replay) && succeeded;
+    }
+    return succeeded ? 0 : 1;
+}